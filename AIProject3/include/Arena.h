@@ -0,0 +1,230 @@
+// Arena.h - Will Cassella
+#pragma once
+
+#include <new>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+
+namespace ml
+{
+	/* A non-owning view of a contiguous array. */
+	template <typename T>
+	struct Span
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		Span() = default;
+
+		Span(T* data, std::size_t size)
+			: _data(data),
+			_size(size)
+		{
+		}
+
+		template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+		Span(const Span<U>& other)
+			: _data(other.data()),
+			_size(other.size())
+		{
+		}
+
+		template <typename U, typename AllocT>
+		Span(std::vector<U, AllocT>& vec)
+			: _data(vec.data()),
+			_size(vec.size())
+		{
+		}
+
+		template <typename U, typename AllocT>
+		Span(const std::vector<U, AllocT>& vec)
+			: _data(vec.data()),
+			_size(vec.size())
+		{
+		}
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		T* data() const
+		{
+			return _data;
+		}
+
+		std::size_t size() const
+		{
+			return _size;
+		}
+
+		bool empty() const
+		{
+			return _size == 0;
+		}
+
+		T* begin() const
+		{
+			return _data;
+		}
+
+		T* end() const
+		{
+			return _data + _size;
+		}
+
+		T& operator[](std::size_t index) const
+		{
+			assert(index < _size);
+			return _data[index];
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		T* _data = nullptr;
+		std::size_t _size = 0;
+	};
+
+	/**
+	 * \brief A monotonic allocator. Allocations are carved out of large blocks and are never freed individually;
+	 * instead everything is released at once when the arena is reset or destroyed.
+	 * Only trivially destructible objects may be created in an arena, since their destructors are never run.
+	 */
+	class Arena
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		explicit Arena(std::size_t blockSize = 64 * 1024)
+			: _block_size(blockSize)
+		{
+		}
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Allocates uninitialized memory with the given size and alignment. */
+		void* allocate(std::size_t size, std::size_t alignment)
+		{
+			auto offset = (_offset + alignment - 1) & ~(alignment - 1);
+
+			if (_current == _blocks.size() || offset + size > _blocks[_current].size)
+			{
+				next_block(size + alignment);
+				offset = (_offset + alignment - 1) & ~(alignment - 1);
+			}
+
+			_offset = offset + size;
+			return _blocks[_current].data.get() + offset;
+		}
+
+		/* Constructs an object in this arena. */
+		template <typename T, typename ... ArgTs>
+		T* create(ArgTs&& ... args)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+			return new (allocate(sizeof(T), alignof(T))) T(std::forward<ArgTs>(args)...);
+		}
+
+		/* Allocates an array of 'count' value-initialized elements in this arena. */
+		template <typename T>
+		Span<T> create_array(std::size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+			auto* result = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				new (result + i) T();
+			}
+
+			return Span<T>{ result, count };
+		}
+
+		/* Allocates a copy of the given elements in this arena. */
+		template <typename T>
+		Span<T> copy_array(const T* source, std::size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+			auto* result = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				new (result + i) T(source[i]);
+			}
+
+			return Span<T>{ result, count };
+		}
+
+		/* Releases everything allocated from this arena at once. The blocks are kept around to be reused by future allocations. */
+		void reset()
+		{
+			_current = 0;
+			_offset = 0;
+		}
+
+		/* Returns the total number of bytes reserved by this arena. */
+		std::size_t capacity() const
+		{
+			std::size_t result = 0;
+			for (const auto& block : _blocks)
+			{
+				result += block.size;
+			}
+
+			return result;
+		}
+
+	private:
+
+		void next_block(std::size_t minSize)
+		{
+			const auto next = _current < _blocks.size() ? _current + 1 : _current;
+			_offset = 0;
+
+			// Look for an existing block (from before the last reset) that's big enough
+			for (auto i = next; i < _blocks.size(); ++i)
+			{
+				if (_blocks[i].size >= minSize)
+				{
+					std::swap(_blocks[i], _blocks[next]);
+					_current = next;
+					return;
+				}
+			}
+
+			// Otherwise allocate a new one
+			Block block;
+			block.size = minSize > _block_size ? minSize : _block_size;
+			block.data.reset(new unsigned char[block.size]);
+
+			_blocks.insert(_blocks.begin() + next, std::move(block));
+			_current = next;
+		}
+
+		struct Block
+		{
+			std::unique_ptr<unsigned char[]> data;
+			std::size_t size = 0;
+		};
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::size_t _block_size;
+		std::vector<Block> _blocks;
+		std::size_t _current = 0;
+		std::size_t _offset = 0;
+	};
+}
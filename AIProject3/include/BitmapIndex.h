@@ -0,0 +1,135 @@
+// BitmapIndex.h - Will Cassella
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "DataSet.h"
+#include "Arena.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ml
+{
+	/**
+	 * \brief A bitmap of the instances of a dataset with each value of each attribute, and with each class.
+	 * Bit 'i' of a bitmap is set if instance 'i' is a member of it. Subsets of the dataset may be represented
+	 * with bitmaps as well, so the number of instances of a subset with a value (and class) is an AND and a popcount per 64 instances.
+	 */
+	class BitmapIndex
+	{
+	public:
+
+		using Word = std::uint64_t;
+		static constexpr std::size_t BITS_PER_WORD = 64;
+
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/* Builds the bitmaps for the instances currently in the given dataset. */
+		explicit BitmapIndex(const DataSet& dataset);
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the number of words in each bitmap. */
+		std::size_t num_words() const
+		{
+			return _num_words;
+		}
+
+		/* Returns the bitmap of the instances with the given value for the given attribute. */
+		const Word* value_bitmap(Attribute::Index attribIndex, Attribute::ValueIndex value) const
+		{
+			return &_bitmaps[(_attribute_offsets[attribIndex] + value) * _num_words];
+		}
+
+		/* Returns the bitmap of the instances in the given class. */
+		const Word* class_bitmap(ClassIndex classIndex) const
+		{
+			return &_bitmaps[(_class_offset + classIndex) * _num_words];
+		}
+
+		/* Fills 'out' (which must have 'num_words()' words) with the bitmap of the instances at the given indices. */
+		void make_subset(Span<const std::size_t> indices, Word* out) const;
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::size_t _num_words;
+
+		/* The index of the bitmap for the first value of each attribute. */
+		std::vector<std::size_t> _attribute_offsets;
+
+		/* The index of the bitmap for the first class. */
+		std::size_t _class_offset;
+
+		std::vector<Word> _bitmaps;
+	};
+
+	/* Returns the number of bits set in the given word. */
+	inline std::size_t popcount(const BitmapIndex::Word word)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		return static_cast<std::size_t>(__popcnt64(word));
+#elif defined(__GNUC__)
+		return static_cast<std::size_t>(__builtin_popcountll(word));
+#else
+		std::size_t result = 0;
+		for (auto bits = word; bits != 0; bits &= bits - 1)
+		{
+			++result;
+		}
+		return result;
+#endif
+	}
+
+	/* Returns the number of bits set in the given bitmap. */
+	inline std::size_t count(const BitmapIndex::Word* a, const std::size_t numWords)
+	{
+		std::size_t result = 0;
+		for (std::size_t i = 0; i < numWords; ++i)
+		{
+			result += popcount(a[i]);
+		}
+
+		return result;
+	}
+
+	/* Returns the number of bits set in both of the given bitmaps. */
+	inline std::size_t count_and(const BitmapIndex::Word* a, const BitmapIndex::Word* b, const std::size_t numWords)
+	{
+		std::size_t result = 0;
+		for (std::size_t i = 0; i < numWords; ++i)
+		{
+			result += popcount(a[i] & b[i]);
+		}
+
+		return result;
+	}
+
+	/* Returns the number of bits set in all three of the given bitmaps. */
+	inline std::size_t count_and(const BitmapIndex::Word* a, const BitmapIndex::Word* b, const BitmapIndex::Word* c, const std::size_t numWords)
+	{
+		std::size_t result = 0;
+		for (std::size_t i = 0; i < numWords; ++i)
+		{
+			result += popcount(a[i] & b[i] & c[i]);
+		}
+
+		return result;
+	}
+
+	/* Writes the intersection of the given bitmaps to 'out'. */
+	inline void intersect(const BitmapIndex::Word* a, const BitmapIndex::Word* b, BitmapIndex::Word* out, const std::size_t numWords)
+	{
+		for (std::size_t i = 0; i < numWords; ++i)
+		{
+			out[i] = a[i] & b[i];
+		}
+	}
+}
@@ -0,0 +1,87 @@
+// BoundedQueue.h - Will Cassella
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace ml
+{
+	/**
+	 * \brief A first-in first-out queue between threads, which holds at most a fixed number of items.
+	 * Producers block while it's full, so a fast stage can only get so far ahead of the slow stage after it.
+	 */
+	template <typename T>
+	class BoundedQueue
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/* Creates an empty queue that holds up to 'capacity' items (at least one). */
+		explicit BoundedQueue(std::size_t capacity)
+			: _capacity(capacity == 0 ? 1 : capacity)
+		{
+		}
+
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Adds an item to the back of the queue, waiting until there's room for it. Returns false (dropping the item) if the queue was closed. */
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_not_full.wait(lock, [this]() { return _closed || _items.size() < _capacity; });
+
+			if (_closed)
+			{
+				return false;
+			}
+
+			_items.push_back(std::move(item));
+			_not_empty.notify_one();
+			return true;
+		}
+
+		/* Takes the item at the front of the queue, waiting until there is one. Returns false once the queue is closed and empty. */
+		bool pop(T& out)
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_not_empty.wait(lock, [this]() { return _closed || !_items.empty(); });
+
+			if (_items.empty())
+			{
+				return false;
+			}
+
+			out = std::move(_items.front());
+			_items.pop_front();
+			_not_full.notify_one();
+			return true;
+		}
+
+		/* Stops the queue taking any more items, the items already in it may still be popped. */
+		void close()
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_closed = true;
+			_not_full.notify_all();
+			_not_empty.notify_all();
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::size_t _capacity;
+		std::mutex _mutex;
+		std::condition_variable _not_full;
+		std::condition_variable _not_empty;
+		std::deque<T> _items;
+		bool _closed = false;
+	};
+}
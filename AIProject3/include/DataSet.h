@@ -2,13 +2,18 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <string>
 #include <iostream>
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include "PackedColumn.h"
 
 namespace ml
 {
 	struct DataSet;
+	class BitmapIndex;
 	using ClassIndex = std::size_t;
 
 	/* Represents an attribute, including its name and domain of values. */
@@ -70,6 +75,12 @@ namespace ml
 				return std::rand() % domain.size();
 			}
 
+			// If this attribute's bins were learned from the data
+			if (_learned_bins)
+			{
+				return bin_index(std::strtof(value.c_str(), nullptr));
+			}
+
 			// If this attribute has been discretized
 			if (_discretized_segment_size > 0)
 			{
@@ -101,6 +112,50 @@ namespace ml
 			return iter - domain.begin();
 		}
 
+		/* Returns whether the named value may be passed to 'value_index' (it's in the domain, an unknown, or this attribute is discretized). */
+		bool has_value(const std::string& value) const
+		{
+			if (domain.empty() || value == "?" || is_discretized())
+			{
+				return true;
+			}
+
+			return std::find(domain.begin(), domain.end(), value) != domain.end();
+		}
+
+		/* Returns whether this attribute's values are numbers, which are put into bins. */
+		bool is_discretized() const
+		{
+			return _discretized_segment_size > 0 || _learned_bins;
+		}
+
+		/**
+		 * \brief Replaces the bins of this discretized attribute with ones learned from the data.
+		 * \param edges The edges between each pair of bins, in increasing order (see 'learn_bin_edges').
+		 * \param min The smallest value, which names the first bin.
+		 */
+		void set_bin_edges(std::vector<float> edges, float min)
+		{
+			assert(is_discretized());
+			_bin_edges = std::move(edges);
+			_learned_bins = true;
+
+			// Each bin is named after the smallest value that goes in it, same as the equal width bins
+			domain.clear();
+			domain.push_back(std::to_string(min));
+			for (auto edge : _bin_edges)
+			{
+				domain.push_back(std::to_string(edge));
+			}
+		}
+
+		/* Returns the index of the bin the given number goes in, for an attribute whose bins were learned from the data. */
+		ValueIndex bin_index(float value) const
+		{
+			assert(_learned_bins);
+			return std::upper_bound(_bin_edges.begin(), _bin_edges.end(), value) - _bin_edges.begin();
+		}
+
 		/* Retuns the value name for the indexed value on this attribute.  */
 		const std::string& value_name(ValueIndex valueIndex) const
 		{
@@ -117,14 +172,21 @@ namespace ml
 		/* The domain of values it may take on. */
 		std::vector<std::string> domain;
 
-		/* The values for this attribute for all values in the dataset. */
-		std::vector<ValueIndex> instance_values;
+		/* The values for this attribute for all instances in the dataset, packed into as few bits as the domain needs. */
+		PackedColumn instance_values;
+
+		/* If this attribute is numeric (see 'is_discretized'), the number for each instance in the dataset before it was put into a bin, NaN where unknown. */
+		std::vector<float> instance_numbers;
 
 	private:
 
 		float _discretized_segment_size = 0;
 		float _discretized_min = 0.f;
 		float _discretized_max = 0.f;
+
+		/* The edges between the bins, if they were learned from the data rather than being equal width. */
+		std::vector<float> _bin_edges;
+		bool _learned_bins = false;
 	};
 
 	/* Represents an instance of a value in the dataset. */
@@ -147,6 +209,15 @@ namespace ml
 		/* Prints this instance with names instead of numbers. */
 		void print() const;
 
+		/* Prints this instance with names instead of numbers to the given stream. */
+		void print(std::ostream& out) const;
+
+		/* Returns the index of this instance in its dataset. */
+		std::size_t index() const
+		{
+			return _index;
+		}
+
 		/**
 		 * \brief Returns the real class index for this index, used to verify classification.
 		 */
@@ -159,6 +230,13 @@ namespace ml
 		 */
 		Attribute::ValueIndex get_attrib(Attribute::Index attribIndex) const;
 
+		/**
+		 * \brief Returns the number for a numeric attribute of this instance, before it was put into a bin.
+		 * \param attribIndex The attribute to get the number for, which must be numeric (see 'Attribute::is_discretized').
+		 * \return The number, or NaN if it's unknown.
+		 */
+		float get_number(Attribute::Index attribIndex) const;
+
 		//////////////////
 		///   Fields   ///
 	private:
@@ -214,6 +292,12 @@ namespace ml
 			return _attributes[attribIndex];
 		}
 
+		/* Returns the attribute in this dataset with the given index, for setting it up while loading. */
+		Attribute& get_attribute(std::size_t attribIndex)
+		{
+			return _attributes[attribIndex];
+		}
+
 		/**
 		 * \brief Returns the class index for the named class.
 		 * \param className The name of the class to get the index for.
@@ -251,12 +335,37 @@ namespace ml
 		 * \param attributes The index of the attribute values for each attribute.
 		 */
 		void add_instance(ClassIndex classIndex, const std::vector<Attribute::ValueIndex>& attributes)
+		{
+			add_instance(classIndex, attributes, nullptr);
+		}
+
+		/**
+		 * \brief Adds an instance of the given class with the given attribute values to this database.
+		 * \param classIndex The index of the class this instance falls under.
+		 * \param attributes The index of the attribute values for each attribute.
+		 * \param numbers The number for each attribute, only used for numeric attributes. If null, their numbers are unknown.
+		 */
+		void add_instance(ClassIndex classIndex, const std::vector<Attribute::ValueIndex>& attributes, const float* numbers)
 		{
 			_instance_classes.push_back(classIndex);
+			_bitmap_index.reset();
 
 			for (std::size_t attribIndex = 0; attribIndex < _attributes.size(); ++attribIndex)
 			{
-				_attributes[attribIndex].instance_values.push_back(attributes[attribIndex]);
+				auto& attrib = _attributes[attribIndex];
+
+				// The domain is settled by the time the first instance is added (including any learned bins), so size the column's values for it
+				if (attrib.instance_values.empty())
+				{
+					attrib.instance_values = PackedColumn{ attrib.domain.size() };
+				}
+
+				attrib.instance_values.push_back(attributes[attribIndex]);
+
+				if (attrib.is_discretized())
+				{
+					attrib.instance_numbers.push_back(numbers ? numbers[attribIndex] : std::numeric_limits<float>::quiet_NaN());
+				}
 			}
 		}
 
@@ -265,19 +374,35 @@ namespace ml
 		 */
 		void finalize()
 		{
-			for (std::size_t i = 0; i < _attributes.size();)
+			_bitmap_index.reset();
+			remove_ignored_attributes();
+
+			for (auto& attrib : _attributes)
 			{
-				if (_attributes[i].domain.empty())
-				{
-					_attributes.erase(_attributes.begin() + i);
-				}
-				else
-				{
-					++i;
-				}
+				attrib.instance_values.shrink_to_fit();
 			}
 		}
 
+		/* Removes the attributes that are to be ignored (those with an empty domain). */
+		void remove_ignored_attributes()
+		{
+			_attributes.erase(
+				std::remove_if(_attributes.begin(), _attributes.end(), [](const Attribute& attrib) { return attrib.domain.empty(); }),
+				_attributes.end());
+		}
+
+		/**
+		 * \brief Builds a bitmap index over the instances currently in this dataset, for algorithms to count with instead of iterating instances.
+		 * Adding an instance drops the index, so this should be called once all instances have been added.
+		 */
+		void build_bitmap_index();
+
+		/* Returns the bitmap index for this dataset, or null if one hasn't been built. */
+		const BitmapIndex* bitmap_index() const
+		{
+			return _bitmap_index.get();
+		}
+
 		//////////////////
 		///   Fields   ///
 	private:
@@ -285,13 +410,19 @@ namespace ml
 		std::vector<std::string> _classes;
 		std::vector<Attribute> _attributes;
 		std::vector<ClassIndex> _instance_classes;
+		std::shared_ptr<const BitmapIndex> _bitmap_index;
 	};
 
 	inline void Instance::print() const
+	{
+		print(std::cout);
+	}
+
+	inline void Instance::print(std::ostream& out) const
 	{
 		for (Attribute::Index i = 0; i < _dataset->num_attributes(); ++i)
 		{
-			std::cout << ", " << _dataset->get_attribute(i).value_name(get_attrib(i));
+			out << ", " << _dataset->get_attribute(i).value_name(get_attrib(i));
 		}
 	}
 
@@ -304,4 +435,9 @@ namespace ml
 	{
 		return _dataset->get_attribute(attribIndex).instance_values[_index];
 	}
+
+	inline float Instance::get_number(Attribute::Index attribIndex) const
+	{
+		return _dataset->get_attribute(attribIndex).instance_numbers[_index];
+	}
 }
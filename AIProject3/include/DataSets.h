@@ -1,33 +1,66 @@
 // DataSets.h - Will Cassella
 #pragma once
 
+#include <string>
+#include <vector>
 #include "DataSet.h"
+#include "Discretization.h"
 
 namespace ml
 {
+	/* The number of classes and attributes of a dataset, once its ignored attributes have been removed. */
+	template <std::size_t NumClasses, std::size_t NumAttributes>
+	struct Schema
+	{
+		static constexpr std::size_t num_classes = NumClasses;
+		static constexpr std::size_t num_attributes = NumAttributes;
+
+		/* Returns whether the given dataset has this schema. */
+		static bool matches(const DataSet& dataset)
+		{
+			return dataset.num_classes() == NumClasses && dataset.num_attributes() == NumAttributes;
+		}
+	};
+
+	/* The schemas of the bundled datasets, for instantiating code specialized on them. */
+	using BreastCancerSchema = Schema<2, 9>;
+	using GlassSchema = Schema<7, 9>;
+	using HouseVotesSchema = Schema<2, 16>;
+	using IrisSchema = Schema<3, 4>;
+	using SoybeanSchema = Schema<4, 35>;
+
 	/**
 	 * \brief Loads the breast cancer data set.
 	 * \return
 	 */
-	DataSet load_breast_cancer_data();
+	DataSet load_breast_cancer_data(Discretization discretization = Discretization::EqualWidth);
 
 	/**
 	 * \brief Loads the glass data set.
 	 */
-	DataSet load_glass_data();
+	DataSet load_glass_data(Discretization discretization = Discretization::EqualWidth);
 
 	/**
 	 * \brief Loads the houes votes data set.
 	 */
-	DataSet load_house_votes_data();
+	DataSet load_house_votes_data(Discretization discretization = Discretization::EqualWidth);
 
 	/**
 	 * \brief Loads the Iris data set.
 	 */
-	DataSet load_iris_data();
+	DataSet load_iris_data(Discretization discretization = Discretization::EqualWidth);
 
 	/**
 	 * \brief Loads the soybean data set.
 	 */
-	DataSet load_soybean_data();
+	DataSet load_soybean_data(Discretization discretization = Discretization::EqualWidth);
+
+	/* A function that loads one of the bundled datasets, with the given way of discretizing its numeric attributes. */
+	using DataSetLoader = DataSet(*)(Discretization);
+
+	/* Returns the names of the bundled datasets, in the order they're usually run. */
+	const std::vector<std::string>& data_set_names();
+
+	/* Returns the loader for the named bundled dataset, or null if there isn't one by that name. */
+	DataSetLoader find_data_set_loader(const std::string& name);
 }
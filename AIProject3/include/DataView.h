@@ -0,0 +1,220 @@
+// DataView.h - Will Cassella
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include "DataSet.h"
+#include "Arena.h"
+
+namespace ml
+{
+	/**
+	 * \brief A subset of the instances of a dataset, given by a span of their indices. Views don't own the indices, so any number of them
+	 * (such as the training and test sets of every fold) may be slices of a single array, and copying or slicing one copies nothing.
+	 */
+	class DataView
+	{
+		/////////////////
+		///   Types   ///
+	public:
+
+		/* Iterates over the instances of a view. */
+		class Iterator
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Instance;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const Instance*;
+			using reference = Instance;
+
+			Iterator(const DataSet* dataset, const std::size_t* index)
+				: _dataset(dataset),
+				_index(index)
+			{
+			}
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			Instance operator*() const
+			{
+				return _dataset->get_instance(*_index);
+			}
+
+			Iterator& operator++()
+			{
+				++_index;
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				auto result = *this;
+				++_index;
+				return result;
+			}
+
+			bool operator==(const Iterator& other) const
+			{
+				return _index == other._index;
+			}
+
+			bool operator!=(const Iterator& other) const
+			{
+				return _index != other._index;
+			}
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			const DataSet* _dataset;
+			const std::size_t* _index;
+		};
+
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		DataView() = default;
+
+		/* Views the instances of the dataset at the given indices, which must outlive the view. */
+		DataView(const DataSet& dataset, Span<const std::size_t> indices)
+			: _dataset(&dataset),
+			_indices(indices)
+		{
+		}
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the dataset this is a view of. */
+		const DataSet& dataset() const
+		{
+			return *_dataset;
+		}
+
+		/* Returns the indices of the instances in this view. */
+		Span<const std::size_t> indices() const
+		{
+			return _indices;
+		}
+
+		/* Returns the number of instances in this view. */
+		std::size_t size() const
+		{
+			return _indices.size();
+		}
+
+		/* Returns whether this view has no instances. */
+		bool empty() const
+		{
+			return _indices.empty();
+		}
+
+		/* Returns the indexed instance of this view (not of the dataset). */
+		Instance operator[](std::size_t index) const
+		{
+			return _dataset->get_instance(_indices[index]);
+		}
+
+		/* Returns a view of 'count' of this view's instances, starting at 'offset'. */
+		DataView slice(std::size_t offset, std::size_t count) const
+		{
+			return DataView{ *_dataset, Span<const std::size_t>{ _indices.data() + offset, count } };
+		}
+
+		Iterator begin() const
+		{
+			return Iterator{ _dataset, _indices.begin() };
+		}
+
+		Iterator end() const
+		{
+			return Iterator{ _dataset, _indices.end() };
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		const DataSet* _dataset = nullptr;
+		Span<const std::size_t> _indices;
+	};
+
+	/**
+	 * \brief The instance indices of a dataset shuffled into cross validation folds, so that the training and test sets of every fold are views of it.
+	 * The shuffled indices are stored twice back to back, so the training set of each fold (every other fold, starting after it and wrapping around)
+	 * is a contiguous slice just like its test set. Every instance is in exactly one test set, the folds differ in size by at most one.
+	 */
+	class Folds
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		Folds() = default;
+
+		/**
+		 * \brief Shuffles the instances of the dataset into folds with 'std::random_shuffle'.
+		 * \param dataset The dataset to split.
+		 * \param numFolds The number of folds to split it into.
+		 * \param stratified Whether each fold should have about the same proportion of each class as the whole dataset.
+		 */
+		Folds(const DataSet& dataset, std::size_t numFolds, bool stratified);
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the number of folds. */
+		std::size_t num_folds() const
+		{
+			return _starts.size() - 1;
+		}
+
+		/* Returns the set of instances to test on for the indexed fold. */
+		DataView test_set(std::size_t fold) const
+		{
+			return DataView{ *_dataset, Span<const std::size_t>{ _indices.data() + _starts[fold], _starts[fold + 1] - _starts[fold] } };
+		}
+
+		/* Returns the set of instances to train on for the indexed fold, which is every instance not in its test set. */
+		DataView training_set(std::size_t fold) const
+		{
+			const auto numInstances = _starts.back();
+			const auto testSize = _starts[fold + 1] - _starts[fold];
+			return DataView{ *_dataset, Span<const std::size_t>{ _indices.data() + _starts[fold + 1], numInstances - testSize } };
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		const DataSet* _dataset = nullptr;
+
+		/* The shuffled indices, twice over. */
+		std::vector<std::size_t> _indices;
+
+		/* The position in the indices where each fold's test set starts, followed by the number of instances. */
+		std::vector<std::size_t> _starts;
+	};
+
+	/* Fills the given array with the index of every instance in the dataset, in order, and returns a view of them. */
+	inline DataView view_all(const DataSet& dataset, std::vector<std::size_t>& indices)
+	{
+		indices.resize(dataset.num_instances());
+		for (std::size_t i = 0; i < indices.size(); ++i)
+		{
+			indices[i] = i;
+		}
+
+		return DataView{ dataset, indices };
+	}
+}
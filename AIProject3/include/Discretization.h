@@ -0,0 +1,112 @@
+// Discretization.h - Will Cassella
+#pragma once
+
+#include <string>
+#include <vector>
+#include "DataSet.h"
+
+namespace ml
+{
+	/* How the bins of discretized attributes are chosen. */
+	enum class Discretization
+	{
+		/* Equal width bins over the range given for the attribute, values outside of it are clamped. */
+		EqualWidth,
+
+		/* Bins with about the same number of instances in each, learned from the data. */
+		Quantile,
+
+		/**
+		 * \brief Bins split where they best separate the classes, from among finer quantiles learned from the data.
+		 * These are learned from the classes of every instance loaded, so they mustn't be used to evaluate on instances from the same dataset.
+		 */
+		Entropy
+	};
+
+	/**
+	 * \brief A summary of a stream of values, which estimates their quantiles in a single pass with bounded memory.
+	 * Values are kept in levels of buffers, where each value in level 'i' stands for 2^i of the values inserted. When a level fills up,
+	 * it's sorted and every other value is promoted to the next level. Until the first level fills up, the quantiles are exact.
+	 */
+	class QuantileSketch
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/* Creates an empty sketch, whose levels each hold up to 'capacity' values. */
+		explicit QuantileSketch(std::size_t capacity = 256);
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Adds a value to the sketch. */
+		void insert(float value);
+
+		/* Returns the number of values inserted. */
+		std::size_t count() const
+		{
+			return _count;
+		}
+
+		/* Returns the smallest value inserted. */
+		float min() const
+		{
+			return _min;
+		}
+
+		/* Returns the largest value inserted. */
+		float max() const
+		{
+			return _max;
+		}
+
+		/**
+		 * \brief Estimates the values that split the stream into equally sized parts.
+		 * \param numParts The number of parts to split the stream into.
+		 * \return The 'numParts - 1' values between the parts, in increasing order.
+		 */
+		std::vector<float> quantiles(std::size_t numParts) const;
+
+	private:
+
+		void compact(std::size_t level);
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::size_t _capacity;
+		std::size_t _count = 0;
+		float _min = 0.f;
+		float _max = 0.f;
+		std::vector<std::vector<float>> _levels;
+
+		/* Alternates which half of the values are promoted, so the estimates don't drift in one direction. */
+		std::vector<bool> _promote_odd;
+	};
+
+	/**
+	 * \brief Learns the edges between the bins of a numeric attribute from a sketch of its known values.
+	 * \param sketch The sketch every known value of the attribute was inserted into.
+	 * \param values The value of instance 'i' is at 'values[i * stride]', NaN if unknown. Only read for 'Entropy', which makes a second pass to count the classes in each candidate bin.
+	 * \param stride The distance between the values of consecutive instances.
+	 * \param classes The class of each instance, only read for 'Entropy'.
+	 * \param numClasses The number of classes.
+	 * \param numBins The largest number of bins to make, there may be fewer if the values don't have that many distinct quantiles.
+	 * \param discretization How to choose the bins, 'Quantile' or 'Entropy'.
+	 * \return The edges between each pair of bins in increasing order, a value goes into the bin after the last edge not greater than it.
+	 */
+	std::vector<float> learn_bin_edges(
+		const QuantileSketch& sketch,
+		const float* values,
+		std::size_t stride,
+		const std::vector<ClassIndex>& classes,
+		std::size_t numClasses,
+		std::size_t numBins,
+		Discretization discretization);
+
+	/* Parses a discretization name ("width", "quantile", "entropy"), returns false if it wasn't recognized. */
+	bool parse_discretization(const std::string& name, Discretization& out);
+}
@@ -0,0 +1,196 @@
+// Experiment.h - Will Cassella
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <iosfwd>
+#include <functional>
+#include "DataSet.h"
+#include "DataView.h"
+#include "Results.h"
+#include "KNearestNeighbor.h"
+#include "KNearestNeighborSweep.h"
+
+namespace ml
+{
+	/* An algorithm is just a function with the following signature: */
+	using IAlgorithm = std::size_t(const DataSet& database, DataView trainingSet, DataView testSet, FoldResult& result);
+
+	/* A dataset, along with the name to report it as. */
+	using NamedDataSet = std::pair<std::string, DataSet>;
+
+	/* The settings of an experiment. */
+	struct ExperimentOptions
+	{
+		/* The names of the algorithms to run on each dataset, see 'algorithm_names'. */
+		std::vector<std::string> algorithms{ "knn", "id3", "hoeffding" };
+
+		/* The number of neighbors for the nearest neighbor algorithm. */
+		unsigned int k = k_nearest_neighbor::DEFAULT_K;
+
+		/* The number of cross validation folds. */
+		std::size_t num_folds = 10;
+
+		/* Whether each fold should have about the same proportion of each class as the whole dataset. */
+		bool stratified = false;
+
+		/* The number of threads to run folds on, zero for one per hardware thread. */
+		std::size_t num_threads = 0;
+
+		/* If not zero, folds are run on this many forked worker processes instead of threads (see 'run_worker_processes'). */
+		std::size_t num_processes = 0;
+
+		/* The number of datasets 'run_pipelined_experiment' may load ahead of the one being evaluated. */
+		std::size_t pipeline_depth = 1;
+	};
+
+	/* The outcome of a single (dataset, algorithm) run of an experiment. */
+	struct RunSummary
+	{
+		/* The name of the dataset. */
+		std::string dataset;
+
+		/* The name the algorithm is selected by (see 'algorithm_names'). */
+		std::string algorithm;
+
+		/* The name the algorithm is reported as. */
+		std::string display_name;
+
+		/* The percentage of instances classified correctly, over all folds. */
+		double accuracy = 0;
+
+		/* The total time taken by the folds, in seconds. */
+		double seconds = 0;
+
+		/* The time taken by the slowest fold, in seconds. */
+		double slowest_fold_seconds = 0;
+
+		/* The number of instances tested on, over all folds. */
+		std::size_t num_instances = 0;
+	};
+
+	/* Returns the names of the algorithms an experiment may run. */
+	const std::vector<std::string>& algorithm_names();
+
+	/**
+	 * \brief Runs every selected algorithm on every dataset with cross validation.
+	 * Each (dataset, algorithm, fold) is a separate job, and all of them are scheduled on a single thread pool (or pool of worker processes), largest first.
+	 * Once everything has finished, the report for each (dataset, algorithm) run is written in order, followed by a table of the accuracy and time taken by each.
+	 * \param datasets The datasets to run on.
+	 * \param options The algorithms to run, and how to run them.
+	 * \param out The stream to write the reports to.
+	 * \param profileOut If profiling is compiled in and this is not null, a profiling report for the loading done beforehand (labelled "load") and one for each
+	 * run (labelled "<dataset>/<algorithm>") are written to it. The runs are then evaluated one at a time (on threads only), so their totals aren't mixed.
+	 * \param summaries If not null, the outcome of each run is appended to it, in the order they're reported.
+	 * \return False if an algorithm name wasn't recognized, nothing is run in that case.
+	 */
+	bool run_experiment(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		std::ostream& out,
+		Verbosity verbosity,
+		ReportFormat format,
+		std::ostream* profileOut,
+		std::vector<RunSummary>* summaries = nullptr);
+
+	/**
+	 * \brief Runs every selected algorithm on every dataset like 'run_experiment', but loads the datasets on a background thread as it goes.
+	 * Each dataset is evaluated as soon as it has been loaded and its folds shuffled, while the datasets after it are loaded, so the time
+	 * taken approaches the larger of the total load time and the total evaluation time rather than their sum. Folds are run on threads only.
+	 * \param datasetNames The names of the datasets to run on, in order.
+	 * \param load Loads the named dataset, on the background thread.
+	 * \param options The algorithms to run, and how to run them. At most 'pipeline_depth' datasets are loaded ahead.
+	 * \param out The stream to write the reports to, each dataset's reports are written once it has finished.
+	 * \param profileOut If profiling is compiled in and this is not null, a profiling report for each run (labelled "<dataset>/<algorithm>") is written to it,
+	 * evaluating the runs one at a time. Loading carries on alongside them, so each report's "load" phase is whatever loading overlapped its run.
+	 * \param loaded If not null, each dataset is moved into it once it has been evaluated, otherwise they're freed as they finish.
+	 * \return False if an algorithm name wasn't recognized, nothing is run in that case.
+	 */
+	bool run_pipelined_experiment(
+		const std::vector<std::string>& datasetNames,
+		const std::function<DataSet(const std::string& name)>& load,
+		const ExperimentOptions& options,
+		std::ostream& out,
+		Verbosity verbosity,
+		ReportFormat format,
+		std::ostream* profileOut,
+		std::vector<NamedDataSet>* loaded);
+
+	/**
+	 * \brief Evaluates nearest neighbor with every (k, q) combination in the grid on every dataset, with cross validation.
+	 * Each (dataset, fold) is a separate job on a thread pool, and classifies the fold once for the whole grid (see 'k_nearest_neighbor::sweep').
+	 * The accuracy of each combination over all folds is written as a table with a row for each 'k' and a column for each 'q'.
+	 * \param datasets The datasets to run on.
+	 * \param options The number of folds and threads to run with, the algorithms and 'k' are ignored.
+	 * \param grid The values of 'k' and 'q' to evaluate.
+	 * \param out The stream to write the results to.
+	 * \return False if the grid is empty, nothing is run in that case.
+	 */
+	bool run_sweep(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		const k_nearest_neighbor::SweepGrid& grid,
+		std::ostream& out,
+		ReportFormat format);
+
+	/**
+	 * \brief Compares 'k' nearest neighbor over the whole training set with nearest neighbor over the condensed training set on every dataset,
+	 * with cross validation. Reports how much the training set shrank, the change in accuracy, and the time taken per query by each.
+	 * The folds are run one at a time, and each is condensed on 'num_threads' threads.
+	 * \param datasets The datasets to run on.
+	 * \param options The number of folds and threads, and 'k', to run with. The algorithms are ignored.
+	 * \param out The stream to write the results to.
+	 */
+	void run_condensation(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		std::ostream& out,
+		ReportFormat format);
+
+	/**
+	 * \brief Compares 'k' nearest neighbor over every attribute with 'k' nearest neighbor over the attributes chosen on each training set,
+	 * with cross validation. Reports how many attributes were chosen (and how often each was), the change in accuracy, and the time taken per query by each.
+	 * The folds are run one at a time, and the candidate attributes of each are scored on 'num_threads' threads.
+	 * \param datasets The datasets to run on.
+	 * \param options The number of folds and threads, and 'k', to run with. The algorithms are ignored.
+	 * \param direction The direction to search for attributes in.
+	 * \param out The stream to write the results to.
+	 */
+	void run_selection(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		k_nearest_neighbor::SelectionOptions::Direction direction,
+		std::ostream& out,
+		ReportFormat format);
+
+	/**
+	 * \brief Measures a prediction cache in front of nearest neighbor and ID3 models trained on each whole dataset, by classifying
+	 * every instance of the dataset several times over (as repeated traffic would), with and without the cache.
+	 * Reports the time per query of each, and the cache's hit rate.
+	 * \param datasets The datasets to run on.
+	 * \param cacheCapacity The number of predictions the cache holds.
+	 * \param out The stream to write the results to.
+	 */
+	void run_cache_replay(
+		const std::vector<NamedDataSet>& datasets,
+		std::size_t cacheCapacity,
+		std::ostream& out,
+		ReportFormat format);
+
+	/**
+	 * \brief Measures how the time to classify a single instance with nearest neighbor scales with the number of threads its training rows
+	 * are split between, training on each dataset's instances repeated up to the given number of rows. Reports the time per query with
+	 * each number of threads (doubling up to 'num_threads'), and whether the predictions were the same with every number of threads.
+	 * \param datasets The datasets to run on.
+	 * \param options The number of threads and 'k' to run with. The folds and algorithms are ignored.
+	 * \param numRows The number of training rows.
+	 * \param out The stream to write the results to.
+	 */
+	void run_shard_scaling(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		std::size_t numRows,
+		std::ostream& out,
+		ReportFormat format);
+}
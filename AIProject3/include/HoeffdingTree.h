@@ -0,0 +1,141 @@
+// HoeffdingTree.h - Will Cassella
+#pragma once
+
+#include <vector>
+#include "DataSet.h"
+#include "DataView.h"
+
+namespace ml
+{
+	struct FoldResult;
+
+	namespace id3_rep
+	{
+		/**
+		 * \brief Settings for growing a Hoeffding tree.
+		 * The defaults suit the small bundled datasets, long streams should use a much smaller 'delta' and larger 'grace_period'.
+		 */
+		struct HoeffdingOptions
+		{
+			/* The probability of choosing the wrong split attribute, for the Hoeffding bound. */
+			float delta = 0.2f;
+
+			/* When the best two attributes are closer than this, split on the best one anyway. */
+			float tie_threshold = 0.3f;
+
+			/* The number of instances a leaf must see between attempts to split it. */
+			std::size_t grace_period = 3;
+
+			/* The maximum number of leaves that may be learning, growth stops when this is reached. Bounds the memory used. */
+			std::size_t max_leaves = 1024;
+		};
+
+		/**
+		 * \brief A decision tree learned in a single pass over a stream of instances (also known as VFDT).
+		 * Each leaf keeps (attribute, value, class) counts, and is split on the attribute with the best
+		 * information gain once the Hoeffding bound shows it's better than the runner up.
+		 */
+		class HoeffdingTree
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			explicit HoeffdingTree(const DataSet& schema, HoeffdingOptions options = {});
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			/* Learns from a single instance of the stream. */
+			void learn(ClassIndex classIndex, const Attribute::ValueIndex* values);
+
+			/* Learns from a single instance of the schema dataset. */
+			void learn(Instance instance);
+
+			/* Classifies the given attribute values. */
+			ClassIndex classify(const Attribute::ValueIndex* values) const;
+
+			/* Classifies an instance of the schema dataset. */
+			ClassIndex classify(Instance instance) const;
+
+			/* Returns the number of nodes in the tree. */
+			std::size_t num_nodes() const
+			{
+				return _nodes.size();
+			}
+
+		private:
+
+			static constexpr std::size_t NO_STATS = static_cast<std::size_t>(-1);
+
+			struct Node
+			{
+				/* The class predicted at this node if it has no statistics (or children). */
+				ClassIndex class_index = 0;
+
+				/* The attribute the children are split by, unused by leaves. */
+				Attribute::Index split_attribute = 0;
+
+				/* The index of the first child in the node array, the children are contiguous. Zero for leaves. */
+				std::size_t first_child = 0;
+
+				/* The index of this leaf's statistics, or NO_STATS if it's an inner node. */
+				std::size_t stats = NO_STATS;
+			};
+
+			/* The sufficient statistics kept by a learning leaf. */
+			struct LeafStats
+			{
+				/* The number of instances seen in each class. */
+				std::vector<std::size_t> class_counts;
+
+				/* The number of instances seen with each (attribute, value, class), each attribute starts at its offset. */
+				std::vector<std::size_t> value_class_counts;
+
+				/* The attributes this leaf may still split on. */
+				std::vector<Attribute::Index> attributes;
+
+				/* The number of instances seen, and as of the last split attempt. */
+				std::size_t seen = 0;
+				std::size_t seen_at_last_attempt = 0;
+			};
+
+			/* Returns the index of the leaf the given values fall into. */
+			std::size_t find_leaf(const Attribute::ValueIndex* values) const;
+
+			/* Creates learning statistics for a leaf, reusing freed ones if possible. */
+			std::size_t create_stats(std::vector<Attribute::Index> attributes);
+
+			/* Splits the leaf if the Hoeffding bound allows it. */
+			void attempt_split(std::size_t nodeIndex);
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			const DataSet* _schema;
+			HoeffdingOptions _options;
+			std::size_t _num_classes;
+
+			/* Where the counts for each attribute start in 'LeafStats::value_class_counts'. */
+			std::vector<std::size_t> _attribute_offsets;
+			std::size_t _stats_size = 0;
+
+			std::vector<Node> _nodes;
+			std::vector<LeafStats> _stats;
+			std::vector<std::size_t> _free_stats;
+			std::size_t _num_learning_leaves = 0;
+		};
+
+		/**
+		 * \brief Trains a Hoeffding tree with a single pass over the training set, and tests it against the test set.
+		 * \param dataset The dataset being run on.
+		 * \param trainingSet The stream of training instances.
+		 * \param testSet The set to calculate the accuracy of the tree on.
+		 * \param result The fold result to record each classification into.
+		 * \return The number of correctly classified instances in the test set.
+		 */
+		std::size_t hoeffding_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result);
+	}
+}
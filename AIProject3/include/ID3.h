@@ -2,21 +2,99 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <string>
+#include <iosfwd>
+#include <utility>
+#include "DataSet.h"
+#include "DataView.h"
 
 namespace ml
 {
-	struct DataSet;
-	struct Instance;
+	struct FoldResult;
+	class Model;
 
 	namespace id3_rep
 	{
+		/* The settings of a random forest. */
+		struct ForestOptions
+		{
+			/* The number of trees in the forest. */
+			std::size_t num_trees = 32;
+
+			/* The number of attributes, picked at random, that each node chooses the best split from. Zero for the square root of the number of attributes (rounded up). */
+			std::size_t num_candidates = 0;
+
+			/* The number of threads to grow the trees on, zero for one per hardware thread. */
+			std::size_t num_threads = 0;
+		};
+
+		/**
+		 * \brief Calculates the entropy of a set from the number of its instances in each class.
+		 * \param classCounts The number of instances in each class.
+		 * \param numClasses The number of classes.
+		 * \return The entropy of the set, and its most common class.
+		 */
+		std::pair<float, ClassIndex> entropy_from_counts(const std::size_t* classCounts, std::size_t numClasses);
+
+		/**
+		 * \brief Calculates the information gain of splitting a set on an attribute, from the number of its instances with each value in each class.
+		 * \param valueClassCounts The number of instances with each value in each class, indexed by 'value * numClasses + class'.
+		 * \param domainSize The size of the domain of the attribute.
+		 * \param numClasses The number of classes.
+		 * \param currentEntropy The entropy of the whole set.
+		 * \return The information gain of splitting the set on the attribute.
+		 */
+		float information_gain_from_counts(const std::size_t* valueClassCounts, std::size_t domainSize, std::size_t numClasses, float currentEntropy);
+
+		/**
+		 * \brief Builds an ID3 tree with reduced error pruning, which may be used to classify instances later.
+		 * \param dataset The dataset to build the tree with.
+		 * \param trainingSet The training set to build the tree from, 20% is set aside for pruning.
+		 * \return The trained model.
+		 */
+		std::unique_ptr<Model> train(const DataSet& dataset, DataView trainingSet);
+
+		/**
+		 * \brief Grows a random forest of unpruned ID3 trees in parallel, which may be used to classify instances later.
+		 * Each tree is grown from a bootstrap sample of the training set, and each node splits on the best of a random subset of the attributes. The samples are kept as
+		 * the distinct instance indices and how many times each was drawn, so the trees share the dataset's columns rather than copying instances.
+		 * \param dataset The dataset to build the trees with.
+		 * \param trainingSet The set to draw the bootstrap samples from.
+		 * \param options The size of the forest, and how to grow it.
+		 * \return The trained model, which classifies by majority vote of the trees.
+		 */
+		std::unique_ptr<Model> train_forest(const DataSet& dataset, DataView trainingSet, const ForestOptions& options = ForestOptions{});
+
+		/**
+		 * \brief Writes a trained ID3 tree out as a standalone C++ header, which classifies with nested switches over the attribute values instead of walking the tree.
+		 * The generated 'classify' function takes the value index of each attribute, and returns the class index, same as 'Model::classify'.
+		 * \param model A model returned by 'train'.
+		 * \param dataset The dataset the model was trained on, used to name the classes and annotate the attribute values.
+		 * \param name The name of the namespace to put the generated code in.
+		 * \param out The stream to write the header to.
+		 * \return False if the model was not returned by 'train'.
+		 */
+		bool export_cpp(const Model& model, const DataSet& dataset, const std::string& name, std::ostream& out);
+
 		/**
 		 * \brief Runs the ID3 with reduceed error pruning algorithm.
 		 * \param dataset The dataset to run ID3 on.
 		 * \param trainingSet The training set to build the ID3 tree.
 		 * \param testSet The set to calculate the accuracy of the ID3 tree on.
+		 * \param result The fold result to record each classification into.
 		 * \return The number of correctly inferred classes in the test set, this should be divided by the test set size to produce the percentage.
 		 */
-		std::size_t algorithm(const DataSet& dataset, const std::vector<Instance>& trainingSet, const std::vector<Instance>& testSet);
+		std::size_t algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result);
+
+		/**
+		 * \brief Runs the random forest algorithm, with the default options on a single thread.
+		 * \param dataset The dataset to run the algorithm on.
+		 * \param trainingSet The set to grow the forest from.
+		 * \param testSet The set to calculate the accuracy of the forest on, classified as a single batch.
+		 * \param result The fold result to record each classification into.
+		 * \return The number of correctly inferred classes in the test set.
+		 */
+		std::size_t forest_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result);
 	}
 }
@@ -0,0 +1,79 @@
+// Inference.h - Will Cassella
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "DataView.h"
+#include "Model.h"
+#include "KNearestNeighbor.h"
+
+namespace ml
+{
+	/**
+	 * \brief A trained model, which may be shared between any number of threads. Models never change once trained and don't refer
+	 * back to the dataset they were trained on, so they may classify from many threads at once without locking, and outlive the dataset.
+	 */
+	using ModelHandle = std::shared_ptr<const Model>;
+
+	/* The kinds of model that may be trained. */
+	enum class ModelKind
+	{
+		/* K nearest neighbor with the value difference metric, "knn". */
+		NearestNeighbor,
+
+		/* 1 nearest neighbor over an edited and condensed training set, "cnn". */
+		CondensedNearestNeighbor,
+
+		/* K nearest neighbor over the attributes chosen by forward selection, "sfs". */
+		ForwardSelectedNearestNeighbor,
+
+		/* K nearest neighbor over the attributes chosen by backward elimination, "sbs". */
+		BackwardSelectedNearestNeighbor,
+
+		/* K nearest neighbor with each query split between threads, "sharded". */
+		ShardedNearestNeighbor,
+
+		/* A pruned ID3 decision tree, "id3". */
+		ID3,
+
+		/* A forest of ID3 trees grown on bootstrap samples, "forest". */
+		Forest
+	};
+
+	/* Settings for training a model. */
+	struct TrainOptions
+	{
+		ModelKind kind = ModelKind::NearestNeighbor;
+
+		/* The number of neighbors that vote on the class of an instance, for the nearest neighbor models other than "cnn". */
+		unsigned int k = k_nearest_neighbor::DEFAULT_K;
+
+		/* The number of threads to train on (and for "sharded", to split each query between), zero for one per hardware thread. */
+		std::size_t num_threads = 0;
+	};
+
+	/* Parses the name of a kind of model ("knn", "cnn", "sfs", "sbs", "sharded", "id3" or "forest"), returns false if it isn't one. */
+	bool parse_model_kind(const std::string& name, ModelKind& out);
+
+	/**
+	 * \brief Trains a model of the given kind.
+	 * \param dataset The dataset the training set is from.
+	 * \param trainingSet The set to train the model with.
+	 * \param options The kind of model, and its settings.
+	 * \return The trained model.
+	 */
+	ModelHandle train_model(const DataSet& dataset, DataView trainingSet, const TrainOptions& options = TrainOptions{});
+
+	/**
+	 * \brief Parses the comma-separated attribute values of an instance, written the same way as the dataset files (without the class or any ignored columns),
+	 * into the value index of each attribute as taken by 'Model::classify'. Unknown values ("?") aren't accepted, since the datasets fill those in at random,
+	 * and the values of numeric attributes must be numbers.
+	 * \param schema The dataset the model was trained on.
+	 * \param line The values to parse.
+	 * \param values Set to the value index of each attribute.
+	 * \param error Set to what was wrong with the values, if they couldn't be parsed.
+	 * \return False if the values are malformed, or any is unknown or not in its attribute's domain.
+	 */
+	bool parse_instance(const DataSet& schema, const std::string& line, std::vector<Attribute::ValueIndex>& values, std::string& error);
+}
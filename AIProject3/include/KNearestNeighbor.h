@@ -1,22 +1,190 @@
 // KNearestNeighbor.h - Will Cassella
 #pragma once
 
+#include <string>
 #include <vector>
+#include <memory>
+#include "DataView.h"
 
 namespace ml
 {
 	struct Instance;
 	struct DataSet;
+	struct FoldResult;
+	class Model;
 
 	namespace k_nearest_neighbor
 	{
+		/* The number of neighbors that vote on the class of an instance, unless otherwise specified. */
+		constexpr unsigned int DEFAULT_K = 9;
+
+		/**
+		 * \brief Trains a K nearest neighbor model, which may be used to classify instances later.
+		 * \param dataset The dataset the training set is from.
+		 * \param trainingSet The set to train the model with.
+		 * \param k The number of neighbors that vote on the class of an instance.
+		 * \return The trained model.
+		 */
+		std::unique_ptr<Model> train(const DataSet& dataset, DataView trainingSet, unsigned int k = DEFAULT_K);
+
 		/**
 		 * \brief Runs the k nearest neighbor algorithm.
 		 * \param dataset The dataset to run the algorithm on.
 		 * \param trainingSet The set to train the K nearest neighbor data with.
 		 * \param testSet The set to test the accuracy of the algorithm against.
+		 * \param result The fold result to record each classification into.
+		 * \return The number of correctly inferred classes in the test set.
+		 */
+		std::size_t algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result);
+
+		/**
+		 * \brief Runs the k nearest neighbor algorithm with the given number of neighbors.
+		 * \param k The number of neighbors that vote on the class of each instance.
+		 */
+		std::size_t algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, unsigned int k, FoldResult& result);
+
+		/**
+		 * \brief Runs leave-one-out cross validation of the k nearest neighbor algorithm over the whole dataset, with 'q' = 1.
+		 * Rather than retraining for each instance, the value/class counts are taken once and adjusted for each held out instance,
+		 * and the neighbors of every instance come from a single tiled pass over the (symmetric) pairs of instances.
+		 * The results are the same as retraining on every other instance and classifying the held out one.
+		 * \param dataset The dataset to run the algorithm on, every instance is classified once.
+		 * \param k The number of neighbors that vote on the class of each instance.
+		 * \param result The fold result to record each classification into.
+		 * \return The number of correctly inferred classes.
+		 */
+		std::size_t leave_one_out(const DataSet& dataset, unsigned int k, FoldResult& result);
+
+		/**
+		 * \brief Runs the k nearest neighbor algorithm with a heterogeneous distance, which uses the numbers of numeric attributes directly
+		 * rather than their bins. Categorical attributes are compared by the value difference metric, and numeric attributes by their difference
+		 * divided by four standard deviations (over the training set). Unknown training numbers are filled in with the mean, and an unknown
+		 * query number is ignored (it would be equally far from every training instance).
+		 * \param dataset The dataset to run the algorithm on.
+		 * \param trainingSet The set to train with.
+		 * \param testSet The set to test the accuracy of the algorithm against.
+		 * \param k The number of neighbors that vote on the class of each instance.
+		 * \param result The fold result to record each classification into.
 		 * \return The number of correctly inferred classes in the test set.
 		 */
-		std::size_t algorithm(const DataSet& dataset, const std::vector<Instance>& trainingSet, const std::vector<Instance>& testSet);
+		std::size_t heterogeneous_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, unsigned int k, FoldResult& result);
+
+		/* Options for reducing a training set to the prototypes a nearest neighbor model keeps. */
+		struct CondenseOptions
+		{
+			/* Whether to first drop each instance its 'edit_k' nearest neighbors misclassify (Wilson editing), to remove noise. */
+			bool edit = true;
+
+			/* The number of neighbors that vote on each instance when editing. */
+			unsigned int edit_k = 3;
+
+			/* Whether to then keep only the instances needed to classify the rest correctly by their nearest neighbor (Hart's condensing). */
+			bool condense = true;
+
+			/* The number of threads to compare instances on, or one for each hardware thread if zero. */
+			std::size_t num_threads = 0;
+		};
+
+		/**
+		 * \brief Reduces the training set to a smaller set of prototypes, comparing instances by the value difference metric (with 'q' = 1)
+		 * over the training set. If editing would drop every instance, condensing starts from the whole training set instead.
+		 * The result is the same however many threads are used.
+		 * \param dataset The dataset the training set is from.
+		 * \param trainingSet The set to reduce.
+		 * \param options Which steps to run, and how.
+		 * \return The indices (into the dataset) of the prototypes, in the order they appear in the training set.
+		 */
+		std::vector<std::size_t> condense(const DataSet& dataset, DataView trainingSet, const CondenseOptions& options = CondenseOptions{});
+
+		/**
+		 * \brief Trains a nearest neighbor model on the prototypes the training set condenses to. Condensing only keeps enough prototypes
+		 * for each training instance's single nearest one to be of its class, so the model classifies by the single nearest prototype
+		 * (with more voting, the few prototypes left would mostly outvote each other). The value difference metric is still taken over the whole training set.
+		 * \param numPrototypes If not null, set to the number of prototypes the model keeps.
+		 */
+		std::unique_ptr<Model> train_condensed(
+			const DataSet& dataset,
+			DataView trainingSet,
+			const CondenseOptions& options = CondenseOptions{},
+			std::size_t* numPrototypes = nullptr);
+
+		/**
+		 * \brief Runs the nearest neighbor algorithm over the condensed training set, with the default condensing options on a single thread.
+		 */
+		std::size_t condensed_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result);
+
+		/* Options for choosing which attributes a nearest neighbor model compares instances by. */
+		struct SelectionOptions
+		{
+			enum class Direction
+			{
+				/* Start with no attributes, and add whichever helps most until none help. */
+				Forward,
+
+				/* Start with every attribute, and remove whichever hurts least until they all hurt. */
+				Backward
+			};
+
+			Direction direction = Direction::Forward;
+
+			/* The number of neighbors that vote on each instance when evaluating a set of attributes. */
+			unsigned int k = DEFAULT_K;
+
+			/* The number of threads to evaluate candidate attributes on, or one for each hardware thread if zero. */
+			std::size_t num_threads = 0;
+		};
+
+		/* Parses a selection direction name ("forward", "backward"), returns false if it wasn't recognized. */
+		bool parse_selection_direction(const std::string& name, SelectionOptions::Direction& out);
+
+		/**
+		 * \brief Chooses the attributes to compare instances by, by greedily adding or removing one at a time. Each set of attributes is
+		 * scored by the leave-one-out accuracy of 'k' nearest neighbor (with 'q' = 1) over the training set. The squared distance between
+		 * every pair of training instances is stored, so each candidate is scored by adding or subtracting a single attribute's contribution
+		 * (a table lookup). Once an attribute is chosen the sums are recomputed over the chosen attributes, so rounding doesn't build up from step to step.
+		 * The candidates of each step (and the recomputed sums) are computed in parallel.
+		 * The result is the same however many threads are used. The stored sums take the square of the training set size in memory.
+		 * \param dataset The dataset the training set is from.
+		 * \param trainingSet The set to choose the attributes with.
+		 * \param options Which direction to search in, and how to score the attributes.
+		 * \return The chosen attributes in ascending order, there's always at least one.
+		 */
+		std::vector<std::size_t> select_attributes(const DataSet& dataset, DataView trainingSet, const SelectionOptions& options = SelectionOptions{});
+
+		/**
+		 * \brief Trains a K nearest neighbor model that only compares instances by the attributes chosen by 'select_attributes'.
+		 * \param attributes If not null, set to the chosen attributes.
+		 */
+		std::unique_ptr<Model> train_selected(
+			const DataSet& dataset,
+			DataView trainingSet,
+			const SelectionOptions& options = SelectionOptions{},
+			std::vector<std::size_t>* attributes = nullptr);
+
+		/**
+		 * \brief Runs the k nearest neighbor algorithm over the attributes chosen on the training set, on a single thread.
+		 * \param direction The direction to search for attributes in.
+		 * \param k The number of neighbors that vote on the class of each instance, both when choosing the attributes and when classifying.
+		 */
+		std::size_t selected_algorithm(
+			const DataSet& dataset,
+			DataView trainingSet,
+			DataView testSet,
+			SelectionOptions::Direction direction,
+			unsigned int k,
+			FoldResult& result);
+
+		/**
+		 * \brief Trains a K nearest neighbor model (with 'q' = 1) that splits its training rows between threads, for training sets large enough
+		 * that a single query is worth spreading out. Each thread finds the 'k' nearest rows of its own share, and those are merged.
+		 * Rows at the same distance are taken in training order, so predictions don't depend on the number of threads; they may differ
+		 * from those of 'train' only where rows tie.
+		 * \param dataset The dataset the training set is from.
+		 * \param trainingSet The set to train the model with.
+		 * \param k The number of neighbors that vote on the class of an instance.
+		 * \param numThreads The number of threads each query is split between (including the calling thread), or zero for one per core.
+		 * \return The trained model.
+		 */
+		std::unique_ptr<Model> train_sharded(const DataSet& dataset, DataView trainingSet, unsigned int k = DEFAULT_K, std::size_t numThreads = 0);
 	}
 }
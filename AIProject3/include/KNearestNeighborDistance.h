@@ -0,0 +1,155 @@
+// KNearestNeighborDistance.h - Will Cassella
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include "DataSet.h"
+#include "DataView.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		/**
+		 * \brief Returns the squared value difference metric (with 'q' = 1) over the training set between every pair of values of the given attribute.
+		 * The difference between values 'x' and 'y' is at 'x * domain size + y'.
+		 */
+		inline std::vector<float> squared_value_differences(const DataSet& dataset, DataView trainingSet, Attribute::Index attribIndex)
+		{
+			const auto numClasses = dataset.num_classes();
+			const auto domainSize = dataset.get_attribute(attribIndex).domain.size();
+
+			// Count up the instances with each value in each class
+			std::vector<float> conditionalProbabilities(domainSize * numClasses, 0.f);
+			std::vector<std::size_t> valueCounts(domainSize, 0);
+			for (auto instance : trainingSet)
+			{
+				valueCounts[instance.get_attrib(attribIndex)] += 1;
+				conditionalProbabilities[instance.get_attrib(attribIndex) * numClasses + instance.get_class()] += 1.f;
+			}
+
+			for (std::size_t value = 0; value < domainSize; ++value)
+			{
+				for (ClassIndex classIndex = 0; valueCounts[value] != 0 && classIndex < numClasses; ++classIndex)
+				{
+					conditionalProbabilities[value * numClasses + classIndex] /= valueCounts[value];
+				}
+			}
+
+			// The squared difference between every pair of values
+			std::vector<float> result;
+			result.reserve(domainSize * domainSize);
+			for (std::size_t x = 0; x < domainSize; ++x)
+			{
+				for (std::size_t y = 0; y < domainSize; ++y)
+				{
+					float difference = 0;
+					for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+					{
+						difference += std::abs(conditionalProbabilities[x * numClasses + classIndex] - conditionalProbabilities[y * numClasses + classIndex]);
+					}
+
+					result.push_back(difference * difference);
+				}
+			}
+
+			return result;
+		}
+
+		/**
+		 * \brief The squared value difference metric (with 'q' = 1) between every pair of values of each attribute, and the values of each
+		 * training instance, so the distance between two training instances is a table lookup per attribute.
+		 * Distances are left squared, since only their order matters.
+		 */
+		class DistanceTable
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			DistanceTable(const DataSet& dataset, DataView trainingSet)
+				: _num_attributes(dataset.num_attributes())
+			{
+				_table_offsets.resize(_num_attributes);
+				_domain_sizes.resize(_num_attributes);
+
+				for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+				{
+					const auto differences = squared_value_differences(dataset, trainingSet, attribIndex);
+					_table_offsets[attribIndex] = _squared_differences.size();
+					_domain_sizes[attribIndex] = dataset.get_attribute(attribIndex).domain.size();
+					_squared_differences.insert(_squared_differences.end(), differences.begin(), differences.end());
+				}
+
+				// Copy the training set
+				_values.reserve(trainingSet.size() * _num_attributes);
+				_classes.reserve(trainingSet.size());
+				for (auto instance : trainingSet)
+				{
+					for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+					{
+						_values.push_back(instance.get_attrib(attribIndex));
+					}
+
+					_classes.push_back(instance.get_class());
+				}
+			}
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			/* Returns the number of training instances. */
+			std::size_t size() const
+			{
+				return _classes.size();
+			}
+
+			/* Returns the number of attributes. */
+			std::size_t num_attributes() const
+			{
+				return _num_attributes;
+			}
+
+			/* Returns the class of the indexed training instance. */
+			ClassIndex get_class(std::size_t row) const
+			{
+				return _classes[row];
+			}
+
+			/* Returns what the given attribute adds to the squared distance between two training instances. */
+			float contribution(Attribute::Index attribIndex, std::size_t a, std::size_t b) const
+			{
+				const auto aValue = _values[a * _num_attributes + attribIndex];
+				const auto bValue = _values[b * _num_attributes + attribIndex];
+				return _squared_differences[_table_offsets[attribIndex] + aValue * _domain_sizes[attribIndex] + bValue];
+			}
+
+			/* Returns the squared distance between two training instances. */
+			float distance(std::size_t a, std::size_t b) const
+			{
+				const auto* aValues = &_values[a * _num_attributes];
+				const auto* bValues = &_values[b * _num_attributes];
+
+				float result = 0;
+				for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+				{
+					result += _squared_differences[_table_offsets[attribIndex] + aValues[attribIndex] * _domain_sizes[attribIndex] + bValues[attribIndex]];
+				}
+
+				return result;
+			}
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			std::size_t _num_attributes;
+			std::vector<std::size_t> _table_offsets;
+			std::vector<std::size_t> _domain_sizes;
+			std::vector<float> _squared_differences;
+			std::vector<Attribute::ValueIndex> _values;
+			std::vector<ClassIndex> _classes;
+		};
+	}
+}
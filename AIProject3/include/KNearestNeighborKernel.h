@@ -0,0 +1,213 @@
+// KNearestNeighborKernel.h - Will Cassella
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "DataSet.h"
+#include "DataView.h"
+#include "Neighbors.h"
+#include "Profiler.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		/* A K nearest neighbor classifier, trained on a fixed training set. */
+		class Kernel
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			virtual ~Kernel() = default;
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			/* Classifies the given instance. Kernels keep per-query scratch space, so this may not be called from multiple threads at once. */
+			virtual ClassIndex classify(Instance instance) = 0;
+		};
+
+		/* Returns 'x' to the power of 'Q', by repeated multiplication. */
+		template <int Q>
+		double power(const double x)
+		{
+			static_assert(Q >= 1, "The VDM exponent must be positive");
+
+			double result = x;
+			for (int i = 1; i < Q; ++i)
+			{
+				result *= x;
+			}
+
+			return result;
+		}
+
+		/**
+		 * \brief A K nearest neighbor kernel specialized on the dataset's schema, 'q' and 'k', so every loop over classes and attributes has a
+		 * constant trip count, and no memory is allocated per query. Produces the same distances (and so classifications) as the generic path.
+		 * Each (attribute, value) pair is given a single code, so the value difference against the query is a single table lookup per attribute.
+		 */
+		template <std::size_t NumClasses, std::size_t NumAttributes, int Q, unsigned int K>
+		class SpecializedKernel final : public Kernel
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			SpecializedKernel(const DataSet& dataset, DataView trainingSet)
+			{
+				assert(dataset.num_classes() == NumClasses && dataset.num_attributes() == NumAttributes);
+				ML_PROFILE_SCOPE(CPCacheBuild);
+
+				// Lay each attribute's values out back to back
+				std::size_t numCodes = 0;
+				for (Attribute::Index attribIndex = 0; attribIndex < NumAttributes; ++attribIndex)
+				{
+					_offsets[attribIndex] = static_cast<Code>(numCodes);
+					_domain_sizes[attribIndex] = static_cast<Code>(dataset.get_attribute(attribIndex).domain.size());
+					numCodes += _domain_sizes[attribIndex];
+				}
+
+				// Count the instances with each code in each class, and encode the training set
+				_conditional_probabilities.assign(numCodes * NumClasses, 0.f);
+				std::vector<std::size_t> codeCounts(numCodes, 0);
+				_rows.reserve(trainingSet.size());
+				_classes.reserve(trainingSet.size());
+
+				for (auto instance : trainingSet)
+				{
+					const auto classIndex = instance.get_class();
+					Row row;
+
+					for (Attribute::Index attribIndex = 0; attribIndex < NumAttributes; ++attribIndex)
+					{
+						const auto code = _offsets[attribIndex] + static_cast<Code>(instance.get_attrib(attribIndex));
+						row[attribIndex] = code;
+						codeCounts[code] += 1;
+						_conditional_probabilities[code * NumClasses + classIndex] += 1.f;
+					}
+
+					_rows.push_back(row);
+					_classes.push_back(classIndex);
+				}
+
+				// Divide to get the probability
+				for (std::size_t code = 0; code < numCodes; ++code)
+				{
+					if (codeCounts[code] == 0)
+					{
+						continue;
+					}
+
+					for (ClassIndex classIndex = 0; classIndex < NumClasses; ++classIndex)
+					{
+						_conditional_probabilities[code * NumClasses + classIndex] /= codeCounts[code];
+					}
+				}
+
+				_squared_differences.assign(numCodes, 0.0);
+				_distances.resize(_rows.size());
+			}
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			ClassIndex classify(const Instance instance) override
+			{
+				ML_PROFILE_SCOPE(Classify);
+				ML_PROFILE_COUNT(DistanceEvaluations, _rows.size());
+
+				// Compute the squared VDM between the instance's value and every value of each attribute
+				for (Attribute::Index attribIndex = 0; attribIndex < NumAttributes; ++attribIndex)
+				{
+					const auto offset = _offsets[attribIndex];
+					const float* query = &_conditional_probabilities[(offset + instance.get_attrib(attribIndex)) * NumClasses];
+
+					for (Code value = 0; value < _domain_sizes[attribIndex]; ++value)
+					{
+						const float* other = &_conditional_probabilities[(offset + value) * NumClasses];
+
+						float difference = 0;
+						for (ClassIndex classIndex = 0; classIndex < NumClasses; ++classIndex)
+						{
+							difference += std::abs(query[classIndex] - other[classIndex]);
+						}
+
+						// Rounded through float between each step, to match the generic path exactly
+						const double vdm = static_cast<float>(power<Q>(difference));
+						_squared_differences[offset + value] = vdm * vdm;
+					}
+				}
+
+				// Compute the distance to each row
+				for (std::size_t i = 0; i < _rows.size(); ++i)
+				{
+					const auto& row = _rows[i];
+					float distance = 0;
+
+					for (Attribute::Index attribIndex = 0; attribIndex < NumAttributes; ++attribIndex)
+					{
+						distance = static_cast<float>(distance + _squared_differences[row[attribIndex]]);
+					}
+
+					_distances[i] = std::sqrt(distance);
+				}
+
+				// Find the nearest neighbors, and vote on them
+				ML_PROFILE_SCOPE(TopK);
+				std::array<Neighbor, K> nearestNeighbors;
+				std::size_t numNeighbors = 0;
+
+				for (std::size_t i = 0; i < _rows.size(); ++i)
+				{
+					insert_if_closer(
+						Span<Neighbor>{ nearestNeighbors.data(), K },
+						numNeighbors,
+						std::make_pair(_distances[i], _classes[i]));
+				}
+
+				std::array<std::size_t, NumClasses> classCounts;
+				return most_common_class(
+					Span<const Neighbor>{ nearestNeighbors.data(), numNeighbors },
+					Span<std::size_t>{ classCounts.data(), NumClasses });
+			}
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			/* An (attribute, value) pair, the attribute's offset plus the value index. */
+			using Code = std::uint32_t;
+			using Row = std::array<Code, NumAttributes>;
+
+			std::array<Code, NumAttributes> _offsets;
+			std::array<Code, NumAttributes> _domain_sizes;
+
+			/* The conditional probability of each class given each code, at 'code * NumClasses + class'. */
+			std::vector<float> _conditional_probabilities;
+
+			/* The training set, encoded. */
+			std::vector<Row> _rows;
+			std::vector<ClassIndex> _classes;
+
+			/* Scratch space for each query, the squared VDM of each code against the query's value. */
+			std::vector<double> _squared_differences;
+
+			/* Scratch space for each query, the distance to each row. */
+			std::vector<float> _distances;
+		};
+
+		/**
+		 * \brief Creates a kernel specialized for the dataset's schema and the given 'q' and 'k', if one has been instantiated.
+		 * Only the schemas of the bundled datasets are, anything else should fall back to the generic implementation.
+		 * \return The kernel, or null if there isn't one for this configuration.
+		 */
+		std::unique_ptr<Kernel> make_specialized_kernel(const DataSet& dataset, DataView trainingSet, int q, unsigned int k);
+	}
+}
@@ -0,0 +1,61 @@
+// KNearestNeighborSweep.h - Will Cassella
+#pragma once
+
+#include <vector>
+#include "DataSet.h"
+#include "DataView.h"
+#include "Results.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		/* The values of 'k' and 'q' to evaluate every combination of in a sweep. */
+		struct SweepGrid
+		{
+			///////////////////
+			///   Methods   ///
+		public:
+
+			/* Returns the number of (k, q) combinations. */
+			std::size_t num_cells() const
+			{
+				return ks.size() * qs.size();
+			}
+
+			/* Returns the index of the result for the given (k, q) combination. */
+			std::size_t cell(std::size_t kIndex, std::size_t qIndex) const
+			{
+				return qIndex * ks.size() + kIndex;
+			}
+
+			//////////////////
+			///   Fields   ///
+		public:
+
+			/* The numbers of neighbors that vote. */
+			std::vector<unsigned int> ks;
+
+			/* The exponents of the value difference metric. */
+			std::vector<int> qs;
+		};
+
+		/**
+		 * \brief Classifies the test set with every (k, q) combination in the grid, at about the cost of a single one.
+		 * The (value, class) counts are shared by every 'q', the distances for every 'q' are computed in a single pass over the training set,
+		 * and each query's neighbors are sorted once up to the largest 'k', so the vote for each 'k' is over a prefix of them.
+		 * Ties in distance go to the later training instance, as they mostly do in 'algorithm'.
+		 * \param dataset The dataset to run the algorithm on.
+		 * \param trainingSet The set to train with.
+		 * \param testSet The set to classify.
+		 * \param grid The values of 'k' and 'q' to classify with.
+		 * \param results The confusion matrix for each cell of the grid (see 'SweepGrid::cell'), each classification is recorded into them.
+		 */
+		void sweep(
+			const DataSet& dataset,
+			DataView trainingSet,
+			DataView testSet,
+			const SweepGrid& grid,
+			std::vector<ConfusionMatrix>& results);
+	}
+}
@@ -0,0 +1,58 @@
+// Model.h - Will Cassella
+#pragma once
+
+#include "DataSet.h"
+
+namespace ml
+{
+	/**
+	 * \brief A trained classifier. Unlike the algorithms, which train and test in one call, a model may be kept around
+	 * and used to classify instances that aren't part of any dataset, given as the value index of each attribute.
+	 * Models don't change once trained, so classifying must be safe from any number of threads at once, without locking.
+	 */
+	class Model
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		virtual ~Model() = default;
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the number of attributes each instance classified by this model has. */
+		virtual std::size_t num_attributes() const = 0;
+
+		/* Classifies a single instance, given as the value index of each of its attributes. */
+		virtual ClassIndex classify(const Attribute::ValueIndex* values) const = 0;
+
+		/**
+		 * \brief Classifies a batch of instances.
+		 * \param values The value indices of each instance, the values of instance 'i' start at 'i * num_attributes()'.
+		 * \param count The number of instances in the batch.
+		 * \param out The array to write the class of each instance to.
+		 */
+		virtual void classify_batch(const Attribute::ValueIndex* values, std::size_t count, ClassIndex* out) const
+		{
+			const auto numAttributes = num_attributes();
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				out[i] = classify(values + i * numAttributes);
+			}
+		}
+
+		/* Classifies an instance of a dataset with the same attributes this model was trained on. */
+		ClassIndex classify(Instance instance) const
+		{
+			std::vector<Attribute::ValueIndex> values(num_attributes());
+			for (Attribute::Index i = 0; i < values.size(); ++i)
+			{
+				values[i] = instance.get_attrib(i);
+			}
+
+			return classify(values.data());
+		}
+	};
+}
@@ -0,0 +1,92 @@
+// Neighbors.h - Will Cassella
+#pragma once
+
+#include <utility>
+#include <algorithm>
+#include "DataSet.h"
+#include "Arena.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		/* A candidate neighbor, the distance to it and its class. */
+		using Neighbor = std::pair<float, ClassIndex>;
+
+		/**
+		 * \brief Inserts the candidate into the (fixed capacity) array of nearest neighbors if it's closer than any of them.
+		 * \param nearestNeighbors The array of nearest neighbors, its size is the value of 'k'.
+		 * \param numNeighbors The number of elements of the array currently in use.
+		 * \param candidate The neighbor to try inserting.
+		 */
+		inline void insert_if_closer(
+			Span<Neighbor> nearestNeighbors,
+			std::size_t& numNeighbors,
+			const Neighbor candidate)
+		{
+			// If we don't already have k neighbors
+			if (numNeighbors < nearestNeighbors.size())
+			{
+				// Just add it
+				nearestNeighbors[numNeighbors++] = candidate;
+				return;
+			}
+
+			// Find the nearest neighbor that this one is closer than
+			auto beaten = nearestNeighbors.end();
+			for (auto iter = nearestNeighbors.begin(); iter < nearestNeighbors.end(); ++iter)
+			{
+				// Don't bother if this one is further
+				if (candidate.first > iter->first)
+				{
+					continue;
+				}
+
+				// If we haven't beaten one yet, or the one we've beaten is closer than this one (want to push out the furthest ones)
+				if (beaten == nearestNeighbors.end() || beaten->first < iter->first)
+				{
+					beaten = iter;
+				}
+			}
+
+			// If the candidate beat one of the current nearest neighbors
+			if (beaten != nearestNeighbors.end())
+			{
+				*beaten = candidate;
+			}
+		}
+
+		/**
+		 * \brief Returns the most common class among the given neighbors, ties go to the lowest class index.
+		 * \param nearestNeighbors The neighbors to vote.
+		 * \param classCounts Scratch space with an element for each class.
+		 */
+		inline ClassIndex most_common_class(
+			Span<const Neighbor> nearestNeighbors,
+			Span<std::size_t> classCounts)
+		{
+			std::fill(classCounts.begin(), classCounts.end(), 0);
+
+			// Count up all the classes
+			for (auto neighbor : nearestNeighbors)
+			{
+				classCounts[neighbor.second] += 1;
+			}
+
+			// Figure out which one has the most occurrences
+			ClassIndex classIndex = 0;
+			std::size_t occurrences = 0;
+
+			for (ClassIndex i = 0; i < classCounts.size(); ++i)
+			{
+				if (classCounts[i] > occurrences)
+				{
+					classIndex = i;
+					occurrences = classCounts[i];
+				}
+			}
+
+			return classIndex;
+		}
+	}
+}
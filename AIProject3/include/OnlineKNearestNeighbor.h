@@ -0,0 +1,136 @@
+// OnlineKNearestNeighbor.h - Will Cassella
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "DataSet.h"
+
+namespace ml
+{
+	struct FoldResult;
+
+	namespace k_nearest_neighbor
+	{
+		/**
+		 * \brief A K nearest neighbor model that training instances may be added to and removed from at any time.
+		 * The (value, class) counts, conditional probabilities and value difference tables for each attribute are
+		 * updated incrementally: an update only refreshes the row and column of each attribute's table for the instance's value, so it costs
+		 * O(attributes * domain size * classes) however many instances the model holds, rather than a retrain.
+		 */
+		class OnlineModel
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			/**
+			 * \brief Creates an empty model.
+			 * \param schema The dataset the classes and attributes of instances are taken from.
+			 * \param windowSize If not zero, the model only keeps this many instances, expiring the oldest first.
+			 * \param q The exponent of the value difference metric.
+			 */
+			explicit OnlineModel(const DataSet& schema, std::size_t windowSize = 0, int q = 1);
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			using InstanceId = std::uint64_t;
+
+			/* Returns the number of training instances currently in the model. */
+			std::size_t size() const
+			{
+				return _classes.size();
+			}
+
+			/**
+			 * \brief Adds a training instance to the model, expiring the oldest instance if the window is full.
+			 * \param classIndex The class of the instance.
+			 * \param values The value index of each attribute of the instance.
+			 * \return An id that may be used to remove the instance later.
+			 */
+			InstanceId insert(ClassIndex classIndex, const Attribute::ValueIndex* values);
+
+			/* Adds a training instance from the schema dataset to the model. */
+			InstanceId insert(Instance instance);
+
+			/* Removes the identified training instance from the model. Returns false if it isn't in the model (or has already expired). */
+			bool remove(InstanceId id);
+
+			/* Changes the size of the sliding window, expiring the oldest instances if there are now too many. Zero means unbounded. */
+			void set_window_size(std::size_t windowSize);
+
+			/**
+			 * \brief Classifies the given attribute values against the instances currently in the model.
+			 * \param values The value index of each attribute.
+			 * \param k The number of neighbors to vote.
+			 */
+			ClassIndex classify(const Attribute::ValueIndex* values, unsigned int k) const;
+
+			/* Classifies an instance from the schema dataset. */
+			ClassIndex classify(Instance instance, unsigned int k) const;
+
+		private:
+
+			/* Adds 'delta' to the counts for the given instance, and refreshes the affected tables. */
+			void update_counts(ClassIndex classIndex, const Attribute::ValueIndex* values, int delta);
+
+			/* Removes the instance in the given storage slot. */
+			void remove_slot(std::size_t slot);
+
+			/* Counts and derived tables for a single attribute. */
+			struct AttributeStats
+			{
+				std::size_t domain_size = 0;
+
+				/* N(a, x): the number of instances with each value. */
+				std::vector<std::size_t> value_counts;
+
+				/* N(a, x, c): the number of instances with each value in each class, indexed by 'value * numClasses + class'. */
+				std::vector<std::size_t> value_class_counts;
+
+				/* P(c | a = x), indexed the same way as 'value_class_counts'. */
+				std::vector<float> conditional_probabilities;
+
+				/* The value difference metric between each pair of values, indexed by 'x * domainSize + y'. */
+				std::vector<float> value_differences;
+			};
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			std::size_t _num_classes;
+			std::size_t _num_attributes;
+			std::size_t _window_size;
+			int _q;
+			std::vector<AttributeStats> _attributes;
+
+			/* Storage for the instances in the model, the values for slot 'i' start at 'i * numAttributes'. */
+			std::vector<Attribute::ValueIndex> _values;
+			std::vector<ClassIndex> _classes;
+			std::vector<InstanceId> _ids;
+
+			/* Maps instance ids to their storage slot. */
+			std::unordered_map<InstanceId, std::size_t> _slots;
+
+			/* Ids in the order they were inserted, for expiring from the window. May contain ids that were already removed. */
+			std::deque<InstanceId> _insertion_order;
+			InstanceId _next_id = 0;
+
+			const DataSet* _schema;
+		};
+
+		/**
+		 * \brief Evaluates the online model prequentially: each instance of the stream is classified before it's inserted as training data.
+		 * \param dataset The dataset the stream instances come from.
+		 * \param stream The instances, in the order they arrive.
+		 * \param windowSize The size of the sliding window, or zero for unbounded.
+		 * \param result The fold result to record each classification into.
+		 * \return The number of correctly classified instances.
+		 */
+		std::size_t online_algorithm(const DataSet& dataset, const std::vector<Instance>& stream, std::size_t windowSize, FoldResult& result);
+	}
+}
@@ -0,0 +1,165 @@
+// PackedColumn.h - Will Cassella
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+namespace ml
+{
+	/**
+	 * \brief The values of one attribute for every instance of a dataset, each packed into as few bits as the attribute's domain needs
+	 * (one for a binary attribute, four for up to sixteen values). Values are laid end to end, so one may straddle two words.
+	 * There's always a spare word after the last value, so reading one never has to check whether the next word exists.
+	 */
+	class PackedColumn
+	{
+	public:
+
+		using Word = std::uint64_t;
+		static constexpr unsigned int BITS_PER_WORD = 64;
+
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		PackedColumn()
+			: PackedColumn(2)
+		{
+		}
+
+		/* Creates an empty column for values below 'domainSize'. */
+		explicit PackedColumn(std::size_t domainSize)
+			: _bits(bits_for(domainSize)),
+			_mask(_bits == BITS_PER_WORD ? ~Word{ 0 } : (Word{ 1 } << _bits) - 1),
+			_words(2, 0)
+		{
+		}
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the number of bits needed to hold every value below 'domainSize', at least one. */
+		static unsigned int bits_for(std::size_t domainSize)
+		{
+			unsigned int bits = 1;
+			while (bits < BITS_PER_WORD && (Word{ 1 } << bits) < domainSize)
+			{
+				bits += 1;
+			}
+
+			return bits;
+		}
+
+		/* Returns the number of values in this column. */
+		std::size_t size() const
+		{
+			return _size;
+		}
+
+		/* Returns whether this column has no values. */
+		bool empty() const
+		{
+			return _size == 0;
+		}
+
+		/* Returns the number of bits each value is packed into. */
+		unsigned int bits() const
+		{
+			return _bits;
+		}
+
+		/* Returns the number of bytes allocated for the values. */
+		std::size_t memory_size() const
+		{
+			return _words.capacity() * sizeof(Word);
+		}
+
+		/* Adds a value to the end of this column, which must be below the domain size the column was created with. */
+		void push_back(std::size_t value)
+		{
+			assert(value <= _mask);
+			const auto bit = _size * _bits;
+			const auto word = bit / BITS_PER_WORD;
+			const auto offset = bit % BITS_PER_WORD;
+
+			if (word + 2 > _words.size())
+			{
+				_words.resize(word + 2, 0);
+			}
+
+			_words[word] |= static_cast<Word>(value) << offset;
+			if (offset + _bits > BITS_PER_WORD)
+			{
+				_words[word + 1] |= static_cast<Word>(value) >> (BITS_PER_WORD - offset);
+			}
+
+			_size += 1;
+		}
+
+		/* Frees any space allocated past the last value. */
+		void shrink_to_fit()
+		{
+			_words.shrink_to_fit();
+		}
+
+		/* Returns the indexed value. */
+		std::size_t operator[](std::size_t index) const
+		{
+			assert(index < _size);
+			const auto bit = index * _bits;
+			const auto word = bit / BITS_PER_WORD;
+			return extract(_words[word], _words[word + 1], bit % BITS_PER_WORD);
+		}
+
+		/**
+		 * \brief Unpacks a run of values, which is cheaper than indexing each of them since each word is only loaded once.
+		 * \param first The index of the first value to unpack.
+		 * \param count The number of values to unpack.
+		 * \param out The array to write the values to.
+		 */
+		void decode(std::size_t first, std::size_t count, std::size_t* out) const
+		{
+			assert(first + count <= _size);
+			const auto bit = first * _bits;
+			auto word = bit / BITS_PER_WORD;
+			auto offset = static_cast<unsigned int>(bit % BITS_PER_WORD);
+			auto current = _words[word];
+			auto next = _words[word + 1];
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				// Only move on to the next word once a value starts in it, so the word after the last value is never read
+				if (offset >= BITS_PER_WORD)
+				{
+					offset -= BITS_PER_WORD;
+					word += 1;
+					current = next;
+					next = _words[word + 1];
+				}
+
+				out[i] = extract(current, next, offset);
+				offset += _bits;
+			}
+		}
+
+	private:
+
+		/* Returns the value starting at 'offset' in 'low', which continues into 'high' if it doesn't fit. */
+		std::size_t extract(Word low, Word high, std::size_t offset) const
+		{
+			// The high word is shifted in two steps, since shifting by the whole word size (when 'offset' is zero) is undefined
+			return static_cast<std::size_t>(((low >> offset) | ((high << 1) << (BITS_PER_WORD - 1 - offset))) & _mask);
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		unsigned int _bits;
+		Word _mask;
+		std::size_t _size = 0;
+		std::vector<Word> _words;
+	};
+}
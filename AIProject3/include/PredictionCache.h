@@ -0,0 +1,190 @@
+// PredictionCache.h - Will Cassella
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <iosfwd>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "Model.h"
+
+namespace ml
+{
+	/* Counts of what a prediction cache has done since it was created. */
+	struct PredictionCacheStats
+	{
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+
+		/* The number of entries that were replaced by newer ones while still valid. */
+		std::uint64_t evictions = 0;
+
+		/* The number of times the cache was invalidated. */
+		std::uint64_t invalidations = 0;
+
+		/* Returns the fraction of lookups that were hits, or zero if there were none. */
+		double hit_rate() const
+		{
+			const auto lookups = hits + misses;
+			return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+		}
+	};
+
+	/* Writes the given stats as a single line. */
+	std::ostream& operator<<(std::ostream& out, const PredictionCacheStats& stats);
+
+	/**
+	 * \brief A fixed size map from the attribute values of an instance to its predicted class, which may be used from any number of threads.
+	 * The value of each attribute is packed into as few bits as its domain needs, so a key is usually a word or two, and the hash of the
+	 * packed key picks a shard (each with its own lock) and a set of four entries within it. When every entry of a set is taken, the one after
+	 * the most recently used is replaced. Invalidating the cache just bumps its generation, entries from older generations are treated as empty.
+	 * A lookup costs tens of nanoseconds, so it only pays off in front of models that take longer than that (nearest neighbor, not a tree walk).
+	 */
+	class PredictionCache
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/**
+		 * \brief Creates an empty cache.
+		 * \param schema The dataset the instances looked up have the attributes of.
+		 * \param capacity The largest number of entries held, rounded up so each shard has a power of two sets.
+		 */
+		PredictionCache(const DataSet& schema, std::size_t capacity);
+
+		PredictionCache(const PredictionCache&) = delete;
+		PredictionCache& operator=(const PredictionCache&) = delete;
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the largest number of entries held. */
+		std::size_t capacity() const
+		{
+			return NUM_SHARDS * _sets_per_shard * WAYS;
+		}
+
+		/* Returns the current generation, which should be passed to 'insert' for predictions made after this was called. */
+		std::uint64_t generation() const
+		{
+			return _generation.load();
+		}
+
+		/* Looks up the predicted class of the given attribute values, returns false if it isn't cached. */
+		bool find(const Attribute::ValueIndex* values, ClassIndex& out);
+
+		/**
+		 * \brief Caches the predicted class of the given attribute values.
+		 * \param generation The generation the prediction was made in, if the cache has been invalidated since it isn't cached.
+		 */
+		void insert(const Attribute::ValueIndex* values, ClassIndex classIndex, std::uint64_t generation);
+
+		/* Drops every entry, for when the model the predictions came from is replaced. */
+		void invalidate();
+
+		/* Returns the counts of hits, misses and evictions so far. */
+		PredictionCacheStats stats() const;
+
+	private:
+
+		static constexpr std::size_t NUM_SHARDS = 16;
+		static constexpr std::size_t WAYS = 4;
+
+		struct Shard
+		{
+			mutable std::mutex mutex;
+
+			/* The generation of each entry (zero if it was never filled), the entries of set 's' start at 's * WAYS'. */
+			std::vector<std::uint64_t> generations;
+			std::vector<ClassIndex> classes;
+
+			/* The packed key of each entry, the key of entry 'e' starts at 'e * _key_words'. */
+			std::vector<std::uint64_t> keys;
+
+			/* The way of each set that was used most recently. */
+			std::vector<std::uint8_t> most_recent;
+
+			PredictionCacheStats stats;
+		};
+
+		/* Packs the given values into 'key', returns false if any of them is outside its attribute's domain (so can't be cached). */
+		bool pack(const Attribute::ValueIndex* values, std::uint64_t* key) const;
+
+		/* Returns the hash of a packed key. */
+		std::uint64_t hash(const std::uint64_t* key) const;
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::vector<std::size_t> _domain_sizes;
+		std::vector<unsigned int> _bits;
+		std::size_t _key_words;
+		std::size_t _sets_per_shard;
+		std::atomic<std::uint64_t> _generation{ 1 };
+		std::atomic<std::uint64_t> _invalidations{ 0 };
+
+		/* The number of lookups with values that couldn't be packed, which are counted as misses. */
+		std::atomic<std::uint64_t> _uncacheable{ 0 };
+		std::array<Shard, NUM_SHARDS> _shards;
+	};
+
+	/**
+	 * \brief A model that answers from a prediction cache, and only asks the model behind it about attribute values it hasn't seen.
+	 * The model behind it may be replaced while other threads are classifying, which invalidates the cache.
+	 */
+	class CachedModel final : public Model
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/**
+		 * \brief Puts a cache in front of the given model.
+		 * \param model The model to classify instances that aren't cached with.
+		 * \param schema The dataset the model was trained on.
+		 * \param capacity The largest number of predictions cached.
+		 */
+		CachedModel(std::shared_ptr<const Model> model, const DataSet& schema, std::size_t capacity);
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		using Model::classify;
+
+		std::size_t num_attributes() const override
+		{
+			return _num_attributes;
+		}
+
+		ClassIndex classify(const Attribute::ValueIndex* values) const override;
+
+		/* Answers what it can from the cache, and classifies the rest together with a single batch on the model behind it. */
+		void classify_batch(const Attribute::ValueIndex* values, std::size_t count, ClassIndex* out) const override;
+
+		/* Replaces the model behind the cache (such as after retraining), and invalidates the cache. */
+		void retrain(std::shared_ptr<const Model> model);
+
+		/* Returns the counts of hits, misses and evictions so far. */
+		PredictionCacheStats stats() const
+		{
+			return _cache.stats();
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::size_t _num_attributes;
+
+		/* Only accessed with 'std::atomic_load' and 'std::atomic_store', so it may be replaced while classifying. */
+		std::shared_ptr<const Model> _model;
+
+		mutable PredictionCache _cache;
+	};
+}
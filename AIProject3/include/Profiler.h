@@ -0,0 +1,105 @@
+// Profiler.h - Will Cassella
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+
+/* Define ML_ENABLE_PROFILING as 1 to build in the instrumentation, otherwise all profiling macros compile to nothing. */
+#ifndef ML_ENABLE_PROFILING
+#define ML_ENABLE_PROFILING 0
+#endif
+
+/* Hardware performance counters are only available through 'perf_event_open' on Linux. */
+#if ML_ENABLE_PROFILING && defined(__linux__)
+#define ML_ENABLE_PERF_EVENTS 1
+#else
+#define ML_ENABLE_PERF_EVENTS 0
+#endif
+
+namespace ml
+{
+	namespace profiler
+	{
+		/* The phases of a run that are timed. */
+		enum class Phase
+		{
+			Load,
+			CPCacheBuild,
+			Classify,
+			TopK,
+			ID3Recurse,
+			SplitEvaluation,
+			Prune,
+			Condense,
+			Select,
+			NUM_PHASES
+		};
+
+		/* The events that are counted. */
+		enum class Counter
+		{
+			NodesBuilt,
+			DistanceEvaluations,
+			Allocations,
+			BytesAllocated,
+			NUM_COUNTERS
+		};
+
+		/* Returns the name used for the given phase in reports. */
+		const char* phase_name(Phase phase);
+
+		/* Returns the name used for the given counter in reports. */
+		const char* counter_name(Counter counter);
+
+#if ML_ENABLE_PROFILING
+
+		/* Adds to the given counter for the calling thread. */
+		void add(Counter counter, std::uint64_t amount);
+
+		/* Turns on sampling of cycles, cache misses and branch misses for each phase (Linux only). Returns whether they're available. */
+		bool enable_hardware_counters();
+
+		/* Writes a JSON object with the totals of all phases and counters across all threads, labelled with the given name. */
+		void write_report(std::ostream& out, const char* label);
+
+		/* Resets all phases and counters to zero. Counts another thread adds while this runs may or may not survive it, so it's only exact while no other threads are being profiled. */
+		void reset();
+
+		/* Times the enclosing scope as the given phase. Every timer counts as a call, but of nested timers for the same phase only the outermost adds to its time (so recursion isn't counted twice). */
+		class ScopedTimer
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			explicit ScopedTimer(Phase phase);
+			~ScopedTimer();
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			Phase _phase;
+			bool _outermost;
+			bool _hardware = false;
+			std::uint64_t _start_ns = 0;
+			std::uint64_t _start_hw[3] = {};
+		};
+
+#endif
+	}
+}
+
+#define ML_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ML_PROFILE_CONCAT(a, b) ML_PROFILE_CONCAT_IMPL(a, b)
+
+#if ML_ENABLE_PROFILING
+#define ML_PROFILE_SCOPE(phase) ::ml::profiler::ScopedTimer ML_PROFILE_CONCAT(_ml_profile_timer_, __LINE__){ ::ml::profiler::Phase::phase }
+#define ML_PROFILE_COUNT(counter, amount) ::ml::profiler::add(::ml::profiler::Counter::counter, static_cast<std::uint64_t>(amount))
+#else
+#define ML_PROFILE_SCOPE(phase) static_cast<void>(0)
+#define ML_PROFILE_COUNT(counter, amount) static_cast<void>(0)
+#endif
@@ -0,0 +1,53 @@
+// Regression.h - Will Cassella
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "Experiment.h"
+
+namespace ml
+{
+	/* The settings of a regression check. */
+	struct RegressionOptions
+	{
+		/* The path of the history file, each check appends a line of JSON to it. */
+		std::string history_path = "results/history.json";
+
+		/* The directory holding the '.result.txt' file of each dataset, whose average accuracies are the expected ones. */
+		std::string results_dir = "results";
+
+		/* The seed given to 'std::srand' before each repetition, so every check shuffles the same folds. */
+		unsigned int seed = 1;
+
+		/* The number of times to run the experiment, the fastest time of each run is the one kept. */
+		std::size_t repetitions = 10;
+
+		/* How far (as a fraction) throughput may fall below, or peak memory may rise above, the recent history before the check fails. */
+		double threshold = 0.25;
+
+		/* The number of recent passing checks whose median throughput and memory are compared against. */
+		std::size_t history_window = 5;
+
+		/* The smallest difference in accuracy (in percent) that fails the check, regardless of how much the expected accuracy varied between folds. */
+		double accuracy_tolerance = 2.5;
+	};
+
+	/**
+	 * \brief Runs every selected algorithm on every dataset with a fixed seed, and checks them against their expected accuracy and recent performance.
+	 * The expected accuracy of a run comes from its dataset's results file if it has one for the algorithm, and otherwise from the last passing check.
+	 * Throughput (instances cross validated per second) and the peak resident memory of the process are compared against the median of the recent
+	 * passing checks with the same number of folds and threads. The outcome is appended to the history file either way, along with the profiling
+	 * counters if profiling is compiled in.
+	 * \param datasets The datasets to run on.
+	 * \param options The algorithms to run, and how to run them.
+	 * \param regression What to check against, and how strictly.
+	 * \param out The stream to write the table of checks to.
+	 * \return True if every check passed, false if any failed (or an algorithm name wasn't recognized).
+	 */
+	bool run_regression(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		const RegressionOptions& regression,
+		std::ostream& out);
+}
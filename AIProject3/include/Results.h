@@ -0,0 +1,263 @@
+// Results.h - Will Cassella
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include "DataSet.h"
+
+namespace ml
+{
+	/* How much detail a ResultSink reports. */
+	enum class Verbosity
+	{
+		/* Nothing is written, results are only counted. */
+		None,
+
+		/* Only the average accuracy and total confusion matrix of each algorithm run. */
+		Summary,
+
+		/* The summary, plus the accuracy of each fold. */
+		Folds,
+
+		/* Everything, including every classified instance. */
+		Instances
+	};
+
+	/* The format a ResultSink writes its report in. */
+	enum class ReportFormat
+	{
+		Text,
+		CSV,
+		JSON
+	};
+
+	/* Counts of (actual class, predicted class) pairs. */
+	struct ConfusionMatrix
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		ConfusionMatrix() = default;
+
+		explicit ConfusionMatrix(std::size_t numClasses)
+			: _num_classes(numClasses)
+		{
+			_counts.assign(numClasses * numClasses, 0);
+		}
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the number of classes this matrix was created for. */
+		std::size_t num_classes() const
+		{
+			return _num_classes;
+		}
+
+		/* Records a single classification. */
+		void record(ClassIndex actual, ClassIndex predicted)
+		{
+			_counts[actual * _num_classes + predicted] += 1;
+		}
+
+		/* Records the given number of the same classification. */
+		void record(ClassIndex actual, ClassIndex predicted, std::size_t count)
+		{
+			_counts[actual * _num_classes + predicted] += count;
+		}
+
+		/* Returns the number of instances of the 'actual' class that were classified as 'predicted'. */
+		std::size_t count(ClassIndex actual, ClassIndex predicted) const
+		{
+			return _counts[actual * _num_classes + predicted];
+		}
+
+		/* Returns the number of correct classifications (the trace of the matrix). */
+		std::size_t num_correct() const
+		{
+			std::size_t result = 0;
+			for (ClassIndex i = 0; i < _num_classes; ++i)
+			{
+				result += count(i, i);
+			}
+
+			return result;
+		}
+
+		/* Returns the total number of classifications recorded. */
+		std::size_t num_total() const
+		{
+			std::size_t result = 0;
+			for (auto count : _counts)
+			{
+				result += count;
+			}
+
+			return result;
+		}
+
+		/* Returns the proportion of correct classifications (ranges between 0-1). */
+		float accuracy() const
+		{
+			const auto total = num_total();
+			return total == 0 ? 0.f : static_cast<float>(num_correct()) / total;
+		}
+
+		/* Adds the counts from the given matrix into this one. */
+		void merge(const ConfusionMatrix& other)
+		{
+			if (_counts.empty())
+			{
+				*this = other;
+				return;
+			}
+
+			assert(other._num_classes == _num_classes);
+			for (std::size_t i = 0; i < _counts.size(); ++i)
+			{
+				_counts[i] += other._counts[i];
+			}
+		}
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::size_t _num_classes = 0;
+		std::vector<std::size_t> _counts;
+	};
+
+	/**
+	 * \brief Collects the results of a single fold.
+	 * Each fold is only ever touched by the thread running it, so recording needs no locking.
+	 * Instance output is buffered in memory until the owning ResultSink writes its report.
+	 */
+	struct FoldResult
+	{
+		friend class ResultSink;
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/**
+		 * \brief Records the classification of an instance.
+		 * \param instance The instance that was classified.
+		 * \param predicted The class the algorithm assigned to the instance.
+		 */
+		void record(Instance instance, ClassIndex predicted);
+
+		/* Returns the confusion matrix for this fold. */
+		const ConfusionMatrix& confusion() const
+		{
+			return _confusion;
+		}
+
+		/* Appends everything recorded to 'out' as bytes, so it can be sent to another process running the same program. */
+		void serialize(std::string& out) const;
+
+		/**
+		 * \brief Replaces everything recorded with what was serialized by another fold result for the same dataset.
+		 * \param data The bytes written by 'serialize'.
+		 * \param size The number of bytes.
+		 * \return False if there weren't enough bytes, nothing is changed in that case.
+		 */
+		bool deserialize(const char* data, std::size_t size);
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		const DataSet* _dataset = nullptr;
+		Verbosity _verbosity = Verbosity::None;
+		ReportFormat _format = ReportFormat::Text;
+		ConfusionMatrix _confusion;
+		std::ostringstream _instance_log;
+		bool _first_instance = true;
+	};
+
+	/* Gathers the results of algorithm runs, and writes a report of them in the selected format. */
+	class ResultSink
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/**
+		 * \param out The stream to write reports to.
+		 * \param writeCsvHeader Whether to write the CSV header before the first report, false if the reports follow another sink's.
+		 */
+		ResultSink(std::ostream& out, Verbosity verbosity, ReportFormat format, bool writeCsvHeader = true);
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the verbosity of this sink. */
+		Verbosity verbosity() const
+		{
+			return _verbosity;
+		}
+
+		/**
+		 * \brief Starts collecting the results of an algorithm run.
+		 * \param dataset The dataset the algorithm is being run on.
+		 * \param datasetName The name to report for the dataset.
+		 * \param algorithmName The name to report for the algorithm.
+		 * \param numFolds The number of folds that will be recorded.
+		 */
+		void begin(const DataSet& dataset, std::string datasetName, std::string algorithmName, std::size_t numFolds);
+
+		/**
+		 * \brief Returns the result collector for the indexed fold of the current run.
+		 * Different folds may safely be recorded into from different threads at the same time.
+		 */
+		FoldResult& fold(std::size_t foldIndex)
+		{
+			return _folds[foldIndex];
+		}
+
+		/**
+		 * \brief Aggregates the folds of the current run, and writes the report for it.
+		 * \return The confusion matrix of all folds combined.
+		 */
+		ConfusionMatrix end();
+
+	private:
+
+		void write_text(const ConfusionMatrix& total, float averageAccuracy);
+
+		void write_csv(const ConfusionMatrix& total, float averageAccuracy);
+
+		void write_json(const ConfusionMatrix& total, float averageAccuracy);
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::ostream* _out;
+		Verbosity _verbosity;
+		ReportFormat _format;
+		bool _wrote_csv_header = false;
+
+		const DataSet* _dataset = nullptr;
+		std::string _dataset_name;
+		std::string _algorithm_name;
+		std::vector<FoldResult> _folds;
+	};
+
+	/* Parses a verbosity name ("none", "summary", "folds", "instances"), returns false if it wasn't recognized. */
+	bool parse_verbosity(const std::string& name, Verbosity& out);
+
+	/* Parses a report format name ("text", "csv", "json"), returns false if it wasn't recognized. */
+	bool parse_report_format(const std::string& name, ReportFormat& out);
+
+	/* Writes the given string as a quoted JSON string. */
+	void write_json_string(std::ostream& out, const std::string& str);
+
+	/* Writes the given string as a CSV field, quoted (with any quotes doubled) if it contains a comma, quote or line break. */
+	void write_csv_field(std::ostream& out, const std::string& str);
+}
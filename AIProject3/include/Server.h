@@ -0,0 +1,125 @@
+// Server.h - Will Cassella
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+#include <iosfwd>
+#include <condition_variable>
+#include "DataSet.h"
+
+namespace ml
+{
+	class Model;
+
+	namespace server
+	{
+		/* Settings for serving a model. */
+		struct ServerOptions
+		{
+			/* The largest number of requests classified together. */
+			std::size_t max_batch_size = 64;
+
+			/* How long the first request of a batch may wait for more requests to join it. */
+			std::chrono::microseconds max_batch_delay{ 200 };
+
+			/* The number of predictions to cache in front of the model, or zero for none. */
+			std::size_t cache_capacity = 0;
+		};
+
+		/* Latency percentiles of the requests served so far, in microseconds. */
+		struct LatencyStats
+		{
+			std::size_t num_requests = 0;
+			std::size_t num_batches = 0;
+			double p50 = 0;
+			double p90 = 0;
+			double p99 = 0;
+			double max = 0;
+		};
+
+		/* Writes the given stats as a single line. */
+		std::ostream& operator<<(std::ostream& out, const LatencyStats& stats);
+
+		/**
+		 * \brief Collects classification requests from any number of threads, and classifies them together in batches.
+		 * A batch is classified as soon as it's full, or once its first request has waited for the maximum delay.
+		 */
+		class MicroBatcher
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			MicroBatcher(const Model& model, ServerOptions options);
+			~MicroBatcher();
+
+			MicroBatcher(const MicroBatcher&) = delete;
+			MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			/* Queues the given attribute values to be classified, the future is fulfilled once its batch has been classified. */
+			std::future<ClassIndex> submit(std::vector<Attribute::ValueIndex> values);
+
+			/* Returns the latency percentiles of all requests completed so far. */
+			LatencyStats latency() const;
+
+		private:
+
+			using Clock = std::chrono::steady_clock;
+
+			struct Request
+			{
+				std::vector<Attribute::ValueIndex> values;
+				std::promise<ClassIndex> result;
+				Clock::time_point submitted;
+			};
+
+			void run();
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			const Model* _model;
+			ServerOptions _options;
+
+			std::mutex _mutex;
+			std::condition_variable _condition;
+			std::deque<Request> _queue;
+			bool _stopping = false;
+
+			mutable std::mutex _stats_mutex;
+			std::vector<double> _latencies;
+			std::size_t _num_batches = 0;
+
+			std::thread _thread;
+		};
+
+		/**
+		 * \brief Serves the model with a line protocol over the given streams until the input ends or a "quit" line is read.
+		 * Each request line is the comma-separated attribute values of an instance, written the same way as the dataset files
+		 * (without the class or any ignored columns). Each is answered in order with the name of its class, or a line starting
+		 * with "error:". A "stats" line is answered with the latency percentiles so far.
+		 * Requests are read ahead while earlier ones are being classified, so pipelined requests are batched together.
+		 * \param schema The dataset the model was trained on, used to parse values and name classes.
+		 * \param batcher The batcher to classify requests with.
+		 */
+		void serve_stream(const DataSet& schema, MicroBatcher& batcher, std::istream& in, std::ostream& out);
+
+		/**
+		 * \brief Serves the model with the same line protocol to every client that connects to a Unix domain socket at the given path.
+		 * Each client is served on its own thread, and requests from all clients are batched together. Runs until a client sends "shutdown".
+		 * Each client's socket is closed as soon as it disconnects, and its thread is joined before the next client is accepted.
+		 * \return False if the socket could not be created (or this platform doesn't support them), or accepting clients failed.
+		 */
+		bool serve_unix_socket(const DataSet& schema, MicroBatcher& batcher, const char* path);
+	}
+}
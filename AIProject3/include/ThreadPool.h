@@ -0,0 +1,73 @@
+// ThreadPool.h - Will Cassella
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace ml
+{
+	/**
+	 * \brief A fixed set of worker threads pulling jobs from a single shared queue.
+	 * Since idle workers take the next job as soon as they finish, unevenly sized jobs are balanced across the workers
+	 * (submitting the largest jobs first keeps the last ones from straggling).
+	 */
+	class ThreadPool
+	{
+		////////////////////////
+		///   Constructors   ///
+	public:
+
+		/* Starts the given number of workers, or one for each hardware thread if zero. */
+		explicit ThreadPool(std::size_t numThreads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		///////////////////
+		///   Methods   ///
+	public:
+
+		/* Returns the number of worker threads. */
+		std::size_t num_threads() const
+		{
+			return _threads.size();
+		}
+
+		/* Queues the given job, jobs are started in the order they were submitted. */
+		void submit(std::function<void()> job);
+
+		/* Blocks until every submitted job has finished. */
+		void wait();
+
+		/**
+		 * \brief Runs 'job(i)' for every 'i' below 'count', on the workers and the calling thread, and blocks until they've all finished.
+		 * Unlike 'wait' this only waits for these calls, so it may be used from several threads at once.
+		 * Must not be called from one of this pool's workers.
+		 */
+		void run_batch(std::size_t count, const std::function<void(std::size_t i)>& job);
+
+	private:
+
+		void run();
+
+		//////////////////
+		///   Fields   ///
+	private:
+
+		std::mutex _mutex;
+		std::condition_variable _job_available;
+		std::condition_variable _jobs_done;
+		std::deque<std::function<void()>> _jobs;
+		std::size_t _num_running = 0;
+		bool _stopping = false;
+
+		std::vector<std::thread> _threads;
+	};
+}
@@ -0,0 +1,29 @@
+// WorkerProcesses.h - Will Cassella
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace ml
+{
+	/* Returns whether 'run_worker_processes' is supported on this platform (it needs 'fork'). */
+	bool worker_processes_supported();
+
+	/**
+	 * \brief Runs jobs on forked worker processes, which pull them in order from a queue in memory shared with this (the coordinator) process.
+	 * Everything the jobs read (such as the datasets) should be set up before calling this, since the workers see the coordinator's memory
+	 * as it was when they were forked. Its pages are shared copy-on-write, so nothing is copied as long as the workers only read it.
+	 * Each worker sends the result of each job back over its own pipe. This must not be called while other threads are running.
+	 * \param numWorkers The number of worker processes to fork.
+	 * \param numJobs The number of jobs, which are identified by their index.
+	 * \param runJob Called in a worker process to run the indexed job, returns the bytes to send back to the coordinator.
+	 * \param onResult Called in the coordinator with the index of each job that finished, and the bytes its worker sent back.
+	 * \return Whether each job finished, if a worker died (or processes aren't supported) the jobs it didn't finish are left for the caller to run.
+	 */
+	std::vector<bool> run_worker_processes(
+		std::size_t numWorkers,
+		std::size_t numJobs,
+		const std::function<std::string(std::size_t job)>& runJob,
+		const std::function<void(std::size_t job, const std::string& result)>& onResult);
+}
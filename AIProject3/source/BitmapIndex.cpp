@@ -0,0 +1,66 @@
+// BitmapIndex.cpp - Will Cassella
+
+#include <algorithm>
+#include "../include/BitmapIndex.h"
+#include "../include/DataSet.h"
+
+namespace ml
+{
+	BitmapIndex::BitmapIndex(const DataSet& dataset)
+		: _num_words((dataset.num_instances() + BITS_PER_WORD - 1) / BITS_PER_WORD)
+	{
+		// Give each (attribute, value) pair and each class a bitmap
+		std::size_t numBitmaps = 0;
+		_attribute_offsets.reserve(dataset.num_attributes());
+
+		for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+		{
+			_attribute_offsets.push_back(numBitmaps);
+			numBitmaps += dataset.get_attribute(attribIndex).domain.size();
+		}
+
+		_class_offset = numBitmaps;
+		numBitmaps += dataset.num_classes();
+
+		_bitmaps.assign(numBitmaps * _num_words, 0);
+
+		// Set the bit for each instance in its bitmaps, unpacking each attribute's values a word's worth of instances at a time
+		std::vector<Attribute::ValueIndex> values(BITS_PER_WORD);
+		for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+		{
+			const auto& column = dataset.get_attribute(attribIndex).instance_values;
+			auto* bitmaps = &_bitmaps[_attribute_offsets[attribIndex] * _num_words];
+
+			for (std::size_t word = 0; word < _num_words; ++word)
+			{
+				const auto count = std::min(std::size_t{ BITS_PER_WORD }, dataset.num_instances() - word * BITS_PER_WORD);
+				column.decode(word * BITS_PER_WORD, count, values.data());
+
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					bitmaps[values[i] * _num_words + word] |= Word{ 1 } << i;
+				}
+			}
+		}
+
+		for (std::size_t i = 0; i < dataset.num_instances(); ++i)
+		{
+			_bitmaps[(_class_offset + dataset.get_instance(i).get_class()) * _num_words + i / BITS_PER_WORD] |= Word{ 1 } << (i % BITS_PER_WORD);
+		}
+	}
+
+	void BitmapIndex::make_subset(Span<const std::size_t> indices, Word* out) const
+	{
+		std::fill(out, out + _num_words, 0);
+
+		for (auto index : indices)
+		{
+			out[index / BITS_PER_WORD] |= Word{ 1 } << (index % BITS_PER_WORD);
+		}
+	}
+
+	void DataSet::build_bitmap_index()
+	{
+		_bitmap_index = std::make_shared<const BitmapIndex>(*this);
+	}
+}
@@ -1,19 +1,56 @@
 // DataSets.cpp - Will Cassella
 
+#include <cmath>
+#include <limits>
+#include <future>
 #include <fstream>
 #include <sstream>
 #include "../include/DataSets.h"
+#include "../include/Profiler.h"
 
 namespace ml
 {
-	void load_data_set(DataSet& dataset, const char* path, bool classFirst)
+	void load_data_set(DataSet& dataset, const char* path, bool classFirst, Discretization discretization)
 	{
+		ML_PROFILE_SCOPE(Load);
 		std::ifstream file{ path, std::ios::in };
 
-		// Load all instances from the file
-		std::vector<Attribute::ValueIndex> attributes;
-		attributes.reserve(dataset.num_attributes());
+		// Ignored columns (those without a domain) are skipped as they're read, rather than stored and dropped by 'finalize'
+		std::vector<char> ignoredColumns;
+		for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+		{
+			ignoredColumns.push_back(dataset.get_attribute(attribIndex).domain.empty());
+		}
+		dataset.remove_ignored_attributes();
+
+		// Discretized attributes have their bins learned from the data, unless they're equal width
+		std::vector<Attribute::Index> learnedAttributes;
+		if (discretization != Discretization::EqualWidth)
+		{
+			for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+			{
+				if (dataset.get_attribute(attribIndex).is_discretized())
+				{
+					learnedAttributes.push_back(attribIndex);
+				}
+			}
+		}
+
+		// The bins aren't known until every value has been seen, so the instances are held back until then
+		const auto numAttributes = dataset.num_attributes();
+		std::vector<ClassIndex> classes;
+		std::vector<Attribute::ValueIndex> instances;
+
+		// Numeric attributes keep their numbers along with their bins, the other attributes are left NaN
+		std::vector<float> numbers;
 
+		// The known values of each attribute whose bins are being learned are sketched as they're read
+		std::vector<QuantileSketch> sketches(learnedAttributes.size());
+
+		// Unknowns are resolved by drawing a random value as they're read, same as other attributes, but the number of bins isn't known yet
+		std::vector<std::vector<int>> unknownDraws(learnedAttributes.size());
+
+		// Load all instances from the file
 		std::string line;
 		std::stringstream lineStream;
 		while (std::getline(file, line))
@@ -29,12 +66,39 @@ namespace ml
 				classIndex = dataset.class_index(value);
 			}
 
-			for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+			std::size_t learned = 0;
+			Attribute::Index nextAttribute = 0;
+			for (const auto ignored : ignoredColumns)
 			{
 				std::getline(lineStream, value, ',');
+				if (ignored)
+				{
+					continue;
+				}
+
+				const auto attribIndex = nextAttribute++;
+				const auto& attrib = dataset.get_attribute(attribIndex);
+				numbers.push_back(attrib.is_discretized() && value != "?" ? std::strtof(value.c_str(), nullptr) : std::numeric_limits<float>::quiet_NaN());
+
+				// The bin of an attribute whose bins are being learned is filled in once they are
+				if (learned < learnedAttributes.size() && learnedAttributes[learned] == attribIndex)
+				{
+					// A value that reads as NaN (like "nan") is treated as unknown, same as when the bins are assigned
+					if (std::isnan(numbers.back()))
+					{
+						unknownDraws[learned].push_back(std::rand());
+					}
+					else
+					{
+						sketches[learned].insert(numbers.back());
+					}
+
+					instances.push_back(0);
+					learned += 1;
+					continue;
+				}
 
-				auto valueIndex = dataset.get_attribute(attribIndex).value_index(value);
-				attributes.push_back(valueIndex);
+				instances.push_back(attrib.value_index(value));
 			}
 
 			if (!classFirst)
@@ -44,14 +108,64 @@ namespace ml
 			}
 
 			lineStream.clear();
+			classes.push_back(classIndex);
+		}
+
+		// Learn the bins of each attribute at the same time
+		{
+			std::vector<std::future<void>> results;
+			results.reserve(learnedAttributes.size());
 
-			// Add the instance to the dataset
-			dataset.add_instance(classIndex, attributes);
-			attributes.clear();
+			for (std::size_t learned = 0; learned < learnedAttributes.size(); ++learned)
+			{
+				results.push_back(std::async(std::launch::async, [&, learned]()
+				{
+					const auto attribIndex = learnedAttributes[learned];
+					auto& attrib = dataset.get_attribute(attribIndex);
+					const auto& sketch = sketches[learned];
+					const auto* values = numbers.data() + attribIndex;
+
+					// With no known values there's nothing to learn the bins from, so the attribute keeps its equal width ones
+					if (sketch.count() != 0)
+					{
+						auto edges = learn_bin_edges(sketch, values, numAttributes, classes, dataset.num_classes(), attrib.domain.size(), discretization);
+						attrib.set_bin_edges(std::move(edges), sketch.min());
+					}
+
+					// Put each value in its bin
+					auto unknown = unknownDraws[learned].begin();
+					for (std::size_t i = 0; i < classes.size(); ++i)
+					{
+						const auto value = values[i * numAttributes];
+						auto& valueIndex = instances[i * numAttributes + attribIndex];
+						if (std::isnan(value))
+						{
+							valueIndex = *unknown++ % attrib.domain.size();
+						}
+						else
+						{
+							valueIndex = attrib.bin_index(value);
+						}
+					}
+				}));
+			}
+
+			for (auto& result : results)
+			{
+				result.get();
+			}
+		}
+
+		// Add the instances to the dataset
+		std::vector<Attribute::ValueIndex> attributes(numAttributes);
+		for (std::size_t i = 0; i < classes.size(); ++i)
+		{
+			std::copy(instances.begin() + i * numAttributes, instances.begin() + (i + 1) * numAttributes, attributes.begin());
+			dataset.add_instance(classes[i], attributes, &numbers[i * numAttributes]);
 		}
 	}
 
-	DataSet load_breast_cancer_data()
+	DataSet load_breast_cancer_data(Discretization discretization)
 	{
 		DataSet result{
 			{ "2", "4" },
@@ -69,12 +183,13 @@ namespace ml
 			}
 		};
 
-		load_data_set(result, "data/breast-cancer-wisconsin.data.txt", false);
+		load_data_set(result, "data/breast-cancer-wisconsin.data.txt", false, discretization);
 		result.finalize();
+		assert(BreastCancerSchema::matches(result));
 		return result;
 	}
 
-	DataSet load_glass_data()
+	DataSet load_glass_data(Discretization discretization)
 	{
 		DataSet result{
 			{ "1", "2", "3", "4", "5", "6", "7" },
@@ -92,12 +207,13 @@ namespace ml
 			}
 		};
 
-		load_data_set(result, "data/glass.data.txt", false);
+		load_data_set(result, "data/glass.data.txt", false, discretization);
 		result.finalize();
+		assert(GlassSchema::matches(result));
 		return result;
 	}
 
-	DataSet load_house_votes_data()
+	DataSet load_house_votes_data(Discretization discretization)
 	{
 		// Initialize the dataset
 		DataSet result{
@@ -122,12 +238,13 @@ namespace ml
 			} };
 
 		// Load from file
-		load_data_set(result, "data/house-votes-84.data.txt", true);
+		load_data_set(result, "data/house-votes-84.data.txt", true, discretization);
 		result.finalize();
+		assert(HouseVotesSchema::matches(result));
 		return result;
 	}
 
-	DataSet load_iris_data()
+	DataSet load_iris_data(Discretization discretization)
 	{
 		DataSet result{
 			{ "Iris-virginica", "Iris-versicolor", "Iris-setosa" },
@@ -140,12 +257,13 @@ namespace ml
 		};
 
 		// Read from file
-		load_data_set(result, "data/iris.data.txt", false);
+		load_data_set(result, "data/iris.data.txt", false, discretization);
 		result.finalize();
+		assert(IrisSchema::matches(result));
 		return result;
 	}
 
-	DataSet load_soybean_data()
+	DataSet load_soybean_data(Discretization discretization)
 	{
 		DataSet result{
 			{ "D1", "D2", "D3", "D4" },
@@ -189,8 +307,54 @@ namespace ml
 		};
 
 		// Read from file
-		load_data_set(result, "data/soybean-small.data.txt", false);
+		load_data_set(result, "data/soybean-small.data.txt", false, discretization);
 		result.finalize();
+		assert(SoybeanSchema::matches(result));
 		return result;
 	}
+
+	namespace
+	{
+		struct NamedLoader
+		{
+			const char* name;
+			DataSetLoader loader;
+		};
+
+		const NamedLoader DATA_SET_LOADERS[] = {
+			{ "breast-cancer", &load_breast_cancer_data },
+			{ "glass", &load_glass_data },
+			{ "house-votes", &load_house_votes_data },
+			{ "iris", &load_iris_data },
+			{ "soybean", &load_soybean_data }
+		};
+	}
+
+	const std::vector<std::string>& data_set_names()
+	{
+		static const std::vector<std::string> names = []()
+		{
+			std::vector<std::string> result;
+			for (const auto& entry : DATA_SET_LOADERS)
+			{
+				result.push_back(entry.name);
+			}
+			return result;
+		}();
+
+		return names;
+	}
+
+	DataSetLoader find_data_set_loader(const std::string& name)
+	{
+		for (const auto& entry : DATA_SET_LOADERS)
+		{
+			if (name == entry.name)
+			{
+				return entry.loader;
+			}
+		}
+
+		return nullptr;
+	}
 }
@@ -0,0 +1,59 @@
+// DataView.cpp - Will Cassella
+
+#include <cassert>
+#include <numeric>
+#include <algorithm>
+#include "../include/DataView.h"
+
+namespace ml
+{
+	Folds::Folds(const DataSet& dataset, std::size_t numFolds, bool stratified)
+		: _dataset(&dataset)
+	{
+		const auto numInstances = dataset.num_instances();
+		assert(numFolds >= 1 && numFolds <= numInstances);
+
+		std::vector<std::size_t> shuffled(numInstances);
+		std::iota(shuffled.begin(), shuffled.end(), 0);
+
+		if (stratified)
+		{
+			// Shuffle the instances of each class separately, and deal them out to the folds in turn
+			std::stable_sort(shuffled.begin(), shuffled.end(), [&](std::size_t a, std::size_t b)
+			{
+				return dataset.get_instance(a).get_class() < dataset.get_instance(b).get_class();
+			});
+
+			for (auto begin = shuffled.begin(); begin != shuffled.end();)
+			{
+				const auto classIndex = dataset.get_instance(*begin).get_class();
+				const auto end = std::find_if(begin, shuffled.end(), [&](std::size_t i) { return dataset.get_instance(i).get_class() != classIndex; });
+				std::random_shuffle(begin, end);
+				begin = end;
+			}
+		}
+		else
+		{
+			std::random_shuffle(shuffled.begin(), shuffled.end());
+		}
+
+		// Instance 'i' of the shuffled order goes in fold 'i % numFolds', so the folds differ in size by at most one
+		_indices.reserve(numInstances * 2);
+		_starts.reserve(numFolds + 1);
+
+		for (std::size_t fold = 0; fold < numFolds; ++fold)
+		{
+			_starts.push_back(_indices.size());
+			for (std::size_t i = fold; i < numInstances; i += numFolds)
+			{
+				_indices.push_back(shuffled[i]);
+			}
+		}
+
+		_starts.push_back(numInstances);
+
+		// Repeat the folds, so the training set of any fold is a single contiguous run
+		_indices.resize(numInstances * 2);
+		std::copy_n(_indices.begin(), numInstances, _indices.begin() + numInstances);
+	}
+}
@@ -0,0 +1,259 @@
+// Discretization.cpp - Will Cassella
+
+#include <cmath>
+#include <algorithm>
+#include "../include/Discretization.h"
+
+namespace ml
+{
+	namespace
+	{
+		/* The number of candidate edges the entropy discretization chooses from, for each bin it makes. */
+		constexpr std::size_t ENTROPY_CANDIDATES_PER_BIN = 4;
+
+		/* Removes repeated edges, and edges at or below the smallest value (which would leave the first bin empty). */
+		void remove_empty_bins(std::vector<float>& edges, float min)
+		{
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+			edges.erase(edges.begin(), std::upper_bound(edges.begin(), edges.end(), min));
+		}
+
+		/* Returns the entropy of the instances in the given range of bins, multiplied by the number of them. */
+		double total_entropy(
+			const std::vector<std::size_t>& binClassCounts,
+			const std::size_t numClasses,
+			const std::size_t begin,
+			const std::size_t end,
+			std::vector<std::size_t>& classCounts)
+		{
+			std::fill(classCounts.begin(), classCounts.end(), 0);
+			std::size_t total = 0;
+
+			for (std::size_t bin = begin; bin < end; ++bin)
+			{
+				for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+				{
+					classCounts[classIndex] += binClassCounts[bin * numClasses + classIndex];
+					total += binClassCounts[bin * numClasses + classIndex];
+				}
+			}
+
+			double result = 0;
+			for (auto count : classCounts)
+			{
+				if (count != 0)
+				{
+					result -= count * std::log2(static_cast<double>(count) / total);
+				}
+			}
+
+			return result;
+		}
+
+		/* Picks up to 'numBins - 1' of the candidate edges, by repeatedly making the split that most reduces the entropy of the classes. */
+		std::vector<float> entropy_edges(
+			const float* values,
+			const std::size_t stride,
+			const std::vector<ClassIndex>& classes,
+			const std::size_t numClasses,
+			const std::size_t numBins,
+			const std::vector<float>& candidates)
+		{
+			// Count the instances of each class in each of the bins made by the candidates
+			const auto numCandidateBins = candidates.size() + 1;
+			std::vector<std::size_t> binClassCounts(numCandidateBins * numClasses, 0);
+
+			for (std::size_t i = 0; i < classes.size(); ++i)
+			{
+				const auto value = values[i * stride];
+				if (std::isnan(value))
+				{
+					continue;
+				}
+
+				const auto bin = std::upper_bound(candidates.begin(), candidates.end(), value) - candidates.begin();
+				binClassCounts[bin * numClasses + classes[i]] += 1;
+			}
+
+			// Each cut is the index of the candidate bin the split starts at, so the edge is the candidate before it
+			std::vector<std::size_t> cuts{ 0, numCandidateBins };
+			std::vector<std::size_t> classCounts(numClasses);
+
+			while (cuts.size() < numBins + 1)
+			{
+				double bestReduction = 0;
+				std::size_t bestCut = 0;
+
+				for (std::size_t interval = 0; interval + 1 < cuts.size(); ++interval)
+				{
+					const auto begin = cuts[interval];
+					const auto end = cuts[interval + 1];
+					const auto entropy = total_entropy(binClassCounts, numClasses, begin, end, classCounts);
+
+					for (auto cut = begin + 1; cut < end; ++cut)
+					{
+						const auto reduction = entropy
+							- total_entropy(binClassCounts, numClasses, begin, cut, classCounts)
+							- total_entropy(binClassCounts, numClasses, cut, end, classCounts);
+
+						if (reduction > bestReduction)
+						{
+							bestReduction = reduction;
+							bestCut = cut;
+						}
+					}
+				}
+
+				// Stop once no split separates the classes any better
+				if (bestCut == 0)
+				{
+					break;
+				}
+
+				cuts.insert(std::upper_bound(cuts.begin(), cuts.end(), bestCut), bestCut);
+			}
+
+			std::vector<float> result;
+			for (std::size_t i = 1; i + 1 < cuts.size(); ++i)
+			{
+				result.push_back(candidates[cuts[i] - 1]);
+			}
+
+			return result;
+		}
+	}
+
+	QuantileSketch::QuantileSketch(std::size_t capacity)
+		: _capacity(std::max<std::size_t>(capacity + capacity % 2, 2))
+	{
+		_levels.emplace_back();
+		_promote_odd.push_back(false);
+	}
+
+	void QuantileSketch::insert(float value)
+	{
+		if (_count == 0)
+		{
+			_min = value;
+			_max = value;
+		}
+		else
+		{
+			_min = std::min(_min, value);
+			_max = std::max(_max, value);
+		}
+
+		_count += 1;
+		_levels[0].push_back(value);
+
+		if (_levels[0].size() >= _capacity)
+		{
+			compact(0);
+		}
+	}
+
+	std::vector<float> QuantileSketch::quantiles(std::size_t numParts) const
+	{
+		// Gather every value along with the number of inserted values it stands for
+		std::vector<std::pair<float, std::size_t>> weighted;
+		std::size_t totalWeight = 0;
+
+		for (std::size_t level = 0; level < _levels.size(); ++level)
+		{
+			for (auto value : _levels[level])
+			{
+				weighted.push_back(std::make_pair(value, std::size_t{ 1 } << level));
+				totalWeight += std::size_t{ 1 } << level;
+			}
+		}
+
+		std::sort(weighted.begin(), weighted.end());
+
+		// The boundary of each part is the value at its starting rank
+		std::vector<float> result;
+		std::size_t rank = 0;
+		auto iter = weighted.begin();
+
+		for (std::size_t part = 1; part < numParts && !weighted.empty(); ++part)
+		{
+			const auto target = totalWeight * part / numParts;
+			while (iter + 1 < weighted.end() && rank + iter->second <= target)
+			{
+				rank += iter->second;
+				++iter;
+			}
+
+			result.push_back(iter->first);
+		}
+
+		return result;
+	}
+
+	void QuantileSketch::compact(std::size_t level)
+	{
+		if (level + 1 == _levels.size())
+		{
+			_levels.emplace_back();
+			_promote_odd.push_back(false);
+		}
+
+		auto& values = _levels[level];
+		std::sort(values.begin(), values.end());
+
+		for (std::size_t i = _promote_odd[level] ? 1 : 0; i < values.size(); i += 2)
+		{
+			_levels[level + 1].push_back(values[i]);
+		}
+
+		values.clear();
+		_promote_odd[level] = !_promote_odd[level];
+
+		if (_levels[level + 1].size() >= _capacity)
+		{
+			compact(level + 1);
+		}
+	}
+
+	std::vector<float> learn_bin_edges(
+		const QuantileSketch& sketch,
+		const float* values,
+		std::size_t stride,
+		const std::vector<ClassIndex>& classes,
+		std::size_t numClasses,
+		std::size_t numBins,
+		Discretization discretization)
+	{
+		if (discretization == Discretization::Entropy)
+		{
+			auto candidates = sketch.quantiles(numBins * ENTROPY_CANDIDATES_PER_BIN);
+			remove_empty_bins(candidates, sketch.min());
+			return entropy_edges(values, stride, classes, numClasses, numBins, candidates);
+		}
+
+		auto edges = sketch.quantiles(numBins);
+		remove_empty_bins(edges, sketch.min());
+		return edges;
+	}
+
+	bool parse_discretization(const std::string& name, Discretization& out)
+	{
+		if (name == "width")
+		{
+			out = Discretization::EqualWidth;
+		}
+		else if (name == "quantile")
+		{
+			out = Discretization::Quantile;
+		}
+		else if (name == "entropy")
+		{
+			out = Discretization::Entropy;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+}
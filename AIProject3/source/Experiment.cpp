@@ -0,0 +1,1229 @@
+// Experiment.cpp - Will Cassella
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cstring>
+#include <numeric>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <algorithm>
+#include "../include/Experiment.h"
+#include "../include/ThreadPool.h"
+#include "../include/BoundedQueue.h"
+#include "../include/WorkerProcesses.h"
+#include "../include/KNearestNeighbor.h"
+#include "../include/KNearestNeighborSweep.h"
+#include "../include/Model.h"
+#include "../include/PredictionCache.h"
+#include "../include/ID3.h"
+#include "../include/HoeffdingTree.h"
+#include "../include/Profiler.h"
+
+namespace ml
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		/* The number of times the cache replay classifies each instance. */
+		constexpr std::size_t REPLAY_PASSES = 10;
+
+		/* The number of instances the shard scaling report classifies (one at a time) with each number of threads. */
+		constexpr std::size_t SHARD_QUERIES = 32;
+
+		std::size_t run_knn(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& options, FoldResult& result)
+		{
+			return k_nearest_neighbor::algorithm(dataset, trainingSet, testSet, options.k, result);
+		}
+
+		std::size_t run_hvdm(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& options, FoldResult& result)
+		{
+			return k_nearest_neighbor::heterogeneous_algorithm(dataset, trainingSet, testSet, options.k, result);
+		}
+
+		std::size_t run_condensed(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& /*options*/, FoldResult& result)
+		{
+			return k_nearest_neighbor::condensed_algorithm(dataset, trainingSet, testSet, result);
+		}
+
+		std::size_t run_forward_selected(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& options, FoldResult& result)
+		{
+			return k_nearest_neighbor::selected_algorithm(dataset, trainingSet, testSet, k_nearest_neighbor::SelectionOptions::Direction::Forward, options.k, result);
+		}
+
+		std::size_t run_backward_selected(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& options, FoldResult& result)
+		{
+			return k_nearest_neighbor::selected_algorithm(dataset, trainingSet, testSet, k_nearest_neighbor::SelectionOptions::Direction::Backward, options.k, result);
+		}
+
+		std::size_t run_id3(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& /*options*/, FoldResult& result)
+		{
+			return id3_rep::algorithm(dataset, trainingSet, testSet, result);
+		}
+
+		std::size_t run_hoeffding(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& /*options*/, FoldResult& result)
+		{
+			return id3_rep::hoeffding_algorithm(dataset, trainingSet, testSet, result);
+		}
+
+		std::size_t run_forest(const DataSet& dataset, DataView trainingSet, DataView testSet, const ExperimentOptions& /*options*/, FoldResult& result)
+		{
+			return id3_rep::forest_algorithm(dataset, trainingSet, testSet, result);
+		}
+
+		/* Nearest neighbor compares every test instance against every training instance. */
+		double knn_cost(const DataSet& dataset, std::size_t trainingSize, std::size_t testSize)
+		{
+			return static_cast<double>(trainingSize) * testSize * dataset.num_attributes();
+		}
+
+		/* Editing and condensing compare every pair of training instances, and then every test instance is compared against the prototypes. */
+		double condensed_cost(const DataSet& dataset, std::size_t trainingSize, std::size_t testSize)
+		{
+			return static_cast<double>(trainingSize) * trainingSize * dataset.num_attributes() + knn_cost(dataset, trainingSize, testSize) / 4;
+		}
+
+		/* Each step of attribute selection scores every remaining attribute by comparing every pair of training instances. */
+		double selected_cost(const DataSet& dataset, std::size_t trainingSize, std::size_t testSize)
+		{
+			return static_cast<double>(trainingSize) * trainingSize * dataset.num_attributes() * dataset.num_attributes() / 4 + knn_cost(dataset, trainingSize, testSize);
+		}
+
+		/* ID3 evaluates every remaining attribute at each level, and pruning classifies the prune set once per candidate node. */
+		double id3_cost(const DataSet& dataset, std::size_t trainingSize, std::size_t /*testSize*/)
+		{
+			return static_cast<double>(trainingSize) * dataset.num_attributes() * dataset.num_attributes() + static_cast<double>(trainingSize) * trainingSize / 5;
+		}
+
+		/* The forest grows every tree without pruning, on its own attributes. */
+		double forest_cost(const DataSet& dataset, std::size_t trainingSize, std::size_t /*testSize*/)
+		{
+			return static_cast<double>(id3_rep::ForestOptions{}.num_trees) * trainingSize * dataset.num_attributes() * dataset.num_attributes() / 4;
+		}
+
+		/* The Hoeffding tree makes a single pass, updating a count for each attribute. */
+		double hoeffding_cost(const DataSet& dataset, std::size_t trainingSize, std::size_t /*testSize*/)
+		{
+			return static_cast<double>(trainingSize) * dataset.num_attributes();
+		}
+
+		struct AlgorithmEntry
+		{
+			/* The name the algorithm is selected by. */
+			const char* name;
+
+			/* The name the algorithm is reported as. */
+			const char* display_name;
+
+			/* Runs a single fold. */
+			std::size_t(*run)(const DataSet&, DataView, DataView, const ExperimentOptions&, FoldResult&);
+
+			/* Estimates the relative cost of a single fold, for scheduling. */
+			double(*cost)(const DataSet&, std::size_t trainingSize, std::size_t testSize);
+		};
+
+		const AlgorithmEntry ALGORITHMS[] = {
+			{ "knn", "Nearest Neighbor", &run_knn, &knn_cost },
+			{ "hvdm", "Nearest Neighbor (HVDM)", &run_hvdm, &knn_cost },
+			{ "cnn", "Nearest Neighbor (condensed)", &run_condensed, &condensed_cost },
+			{ "sfs", "Nearest Neighbor (forward selection)", &run_forward_selected, &selected_cost },
+			{ "sbs", "Nearest Neighbor (backward selection)", &run_backward_selected, &selected_cost },
+			{ "id3", "ID3", &run_id3, &id3_cost },
+			{ "hoeffding", "Hoeffding Tree", &run_hoeffding, &hoeffding_cost },
+			{ "forest", "Random Forest", &run_forest, &forest_cost }
+		};
+
+		/* A single (dataset, algorithm) cross validation run. */
+		struct Run
+		{
+			const NamedDataSet* dataset;
+			const AlgorithmEntry* algorithm;
+
+			/* The shuffled instances, which the training and test sets of every fold are views of. */
+			Folds folds;
+
+			/* The report is buffered until every run is finished, so they're written in order. */
+			std::ostringstream report;
+			std::unique_ptr<ResultSink> sink;
+
+			/* The time taken by each fold, only written by the job running it. */
+			std::vector<double> fold_seconds;
+		};
+
+		/* A single fold of a run, scheduled on the pool. */
+		struct Job
+		{
+			Run* run;
+			std::size_t fold;
+			double cost;
+		};
+
+		void run_fold(const ExperimentOptions& options, Run& run, const std::size_t fold)
+		{
+			const auto& dataset = run.dataset->second;
+
+			const auto start = Clock::now();
+			run.algorithm->run(dataset, run.folds.training_set(fold), run.folds.test_set(fold), options, run.sink->fold(fold));
+			run.fold_seconds[fold] = std::chrono::duration<double>(Clock::now() - start).count();
+		}
+
+		/* Writes the table of accuracy and timing for each run. */
+		void write_summary(
+			std::ostream& out,
+			ReportFormat format,
+			const std::vector<RunSummary>& runs,
+			const std::size_t numThreads,
+			const bool processes,
+			const double wallSeconds)
+		{
+			switch (format)
+			{
+			case ReportFormat::Text:
+			{
+				std::size_t datasetWidth = 7;
+				std::size_t algorithmWidth = 9;
+				for (const auto& run : runs)
+				{
+					datasetWidth = std::max(datasetWidth, run.dataset.size());
+					algorithmWidth = std::max(algorithmWidth, run.display_name.size());
+				}
+
+				out << std::left << std::setw(datasetWidth + 2) << "Dataset" << std::setw(algorithmWidth + 2) << "Algorithm";
+				out << std::setw(12) << "Accuracy" << std::setw(22) << "Total fold time (s)" << "Slowest fold (s)\n";
+
+				for (const auto& run : runs)
+				{
+					std::ostringstream accuracy;
+					accuracy << run.accuracy << '%';
+
+					out << std::setw(datasetWidth + 2) << run.dataset << std::setw(algorithmWidth + 2) << run.display_name;
+					out << std::setw(12) << accuracy.str();
+					out << std::setw(22) << run.seconds;
+					out << run.slowest_fold_seconds << '\n';
+				}
+
+				out << std::right << "Wall time: " << wallSeconds << "s on " << numThreads;
+				if (processes)
+				{
+					out << (numThreads == 1 ? " process\n" : " processes\n");
+				}
+				else
+				{
+					out << (numThreads == 1 ? " thread\n" : " threads\n");
+				}
+				break;
+			}
+
+			case ReportFormat::CSV:
+				for (const auto& run : runs)
+				{
+					out << "time,";
+					write_csv_field(out, run.dataset);
+					out << ',';
+					write_csv_field(out, run.display_name);
+					out << ",all,,,," << run.seconds << '\n';
+				}
+
+				out << "time,,,wall,,,," << wallSeconds << '\n';
+				break;
+
+			case ReportFormat::JSON:
+				out << "{\"summary\":[";
+				for (std::size_t i = 0; i < runs.size(); ++i)
+				{
+					const auto& run = runs[i];
+					out << (i == 0 ? "" : ",") << "{\"dataset\":";
+					write_json_string(out, run.dataset);
+					out << ",\"algorithm\":";
+					write_json_string(out, run.display_name);
+					out << ",\"accuracy\":" << run.accuracy;
+					out << ",\"seconds\":" << run.seconds << '}';
+				}
+
+				out << "],\"threads\":" << numThreads << ",\"wall_seconds\":" << wallSeconds << "}\n";
+				break;
+			}
+		}
+
+		/* Looks up the entry of each named algorithm, returns false if any of them weren't recognized. */
+		bool find_algorithms(const std::vector<std::string>& names, std::vector<const AlgorithmEntry*>& out)
+		{
+			for (const auto& name : names)
+			{
+				auto entry = std::find_if(std::begin(ALGORITHMS), std::end(ALGORITHMS), [&](const AlgorithmEntry& e) { return name == e.name; });
+				if (entry == std::end(ALGORITHMS))
+				{
+					return false;
+				}
+
+				out.push_back(entry);
+			}
+
+			return true;
+		}
+
+		/**
+		 * \brief Sets up a run of each algorithm on the dataset, and a job for each of their folds.
+		 * The folds are shuffled here rather than by the jobs, so they don't depend on the order the jobs run in.
+		 * \param writeCsvHeader Whether the first run's report should start with the CSV header.
+		 */
+		void add_runs(
+			const NamedDataSet& dataset,
+			const std::vector<const AlgorithmEntry*>& algorithms,
+			const ExperimentOptions& options,
+			Verbosity verbosity,
+			ReportFormat format,
+			bool writeCsvHeader,
+			std::vector<std::unique_ptr<Run>>& runs,
+			std::vector<Job>& jobs)
+		{
+			for (const auto* algorithm : algorithms)
+			{
+				auto run = std::make_unique<Run>();
+				run->dataset = &dataset;
+				run->algorithm = algorithm;
+				run->folds = Folds{ dataset.second, options.num_folds, options.stratified };
+
+				run->sink = std::make_unique<ResultSink>(run->report, verbosity, format, writeCsvHeader);
+				run->sink->begin(dataset.second, dataset.first, algorithm->display_name, options.num_folds);
+				run->fold_seconds.assign(options.num_folds, 0.0);
+				writeCsvHeader = false;
+
+				const auto testSize = dataset.second.num_instances() / options.num_folds;
+				const auto cost = algorithm->cost(dataset.second, dataset.second.num_instances() - testSize, testSize);
+				for (std::size_t fold = 0; fold < options.num_folds; ++fold)
+				{
+					jobs.push_back(Job{ run.get(), fold, cost });
+				}
+
+				runs.push_back(std::move(run));
+			}
+		}
+
+		/* Runs the jobs on the given pool, largest first so the small ones fill in the gaps at the end. */
+		void run_jobs(const ExperimentOptions& options, std::vector<Job>& jobs, ThreadPool& pool)
+		{
+			std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.cost > b.cost; });
+
+			for (const auto& job : jobs)
+			{
+				pool.submit([&options, job]() { run_fold(options, *job.run, job.fold); });
+			}
+
+			pool.wait();
+		}
+
+		/* Writes out the report of each finished run in order, and appends its outcome to 'summaries'. */
+		void report_runs(const std::vector<std::unique_ptr<Run>>& runs, std::ostream& out, std::vector<RunSummary>& summaries)
+		{
+			for (const auto& run : runs)
+			{
+				const auto total = run->sink->end();
+				out << run->report.str();
+
+				RunSummary summary;
+				summary.dataset = run->dataset->first;
+				summary.algorithm = run->algorithm->name;
+				summary.display_name = run->algorithm->display_name;
+				summary.accuracy = total.accuracy() * 100;
+				summary.seconds = std::accumulate(run->fold_seconds.begin(), run->fold_seconds.end(), 0.0);
+				summary.slowest_fold_seconds = *std::max_element(run->fold_seconds.begin(), run->fold_seconds.end());
+				summary.num_instances = run->dataset->second.num_instances();
+				summaries.push_back(std::move(summary));
+			}
+		}
+
+		/* Returns whether profiling is compiled in and a report was requested. */
+		bool profiling(std::ostream* profileOut)
+		{
+#if ML_ENABLE_PROFILING
+			return profileOut != nullptr;
+#else
+			static_cast<void>(profileOut);
+			return false;
+#endif
+		}
+
+		/* Writes a profiling report with the given label if requested, and resets the profiler for whatever runs next. */
+		void write_profile(std::ostream* profileOut, const std::string& label)
+		{
+#if ML_ENABLE_PROFILING
+			if (profileOut)
+			{
+				profiler::write_report(*profileOut, label.c_str());
+				profileOut->flush();
+			}
+			profiler::reset();
+#else
+			static_cast<void>(profileOut);
+			static_cast<void>(label);
+#endif
+		}
+
+		/**
+		 * \brief Runs the jobs like 'run_jobs', but one run at a time, writing a profiling report labelled "<dataset>/<algorithm>" once each run's folds are done.
+		 * Nothing else is running on the pool when the profiler is reset, so each report only counts its own run.
+		 */
+		void run_jobs_profiled(
+			const ExperimentOptions& options,
+			const std::vector<std::unique_ptr<Run>>& runs,
+			const std::vector<Job>& jobs,
+			ThreadPool& pool,
+			std::ostream* profileOut)
+		{
+			for (const auto& run : runs)
+			{
+				std::vector<Job> runJobs;
+				for (const auto& job : jobs)
+				{
+					if (job.run == run.get())
+					{
+						runJobs.push_back(job);
+					}
+				}
+
+				if (runJobs.empty())
+				{
+					continue;
+				}
+
+				run_jobs(options, runJobs, pool);
+				write_profile(profileOut, run->dataset->first + "/" + run->algorithm->name);
+			}
+		}
+	}
+
+	const std::vector<std::string>& algorithm_names()
+	{
+		static const std::vector<std::string> names = []()
+		{
+			std::vector<std::string> result;
+			for (const auto& entry : ALGORITHMS)
+			{
+				result.push_back(entry.name);
+			}
+			return result;
+		}();
+
+		return names;
+	}
+
+	bool run_experiment(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		std::ostream& out,
+		Verbosity verbosity,
+		ReportFormat format,
+		std::ostream* profileOut,
+		std::vector<RunSummary>* summaries)
+	{
+		assert(options.num_folds >= 2);
+
+		std::vector<const AlgorithmEntry*> algorithms;
+		if (!find_algorithms(options.algorithms, algorithms))
+		{
+			return false;
+		}
+
+		// Set up each run
+		std::vector<std::unique_ptr<Run>> runs;
+		std::vector<Job> jobs;
+
+		for (const auto& dataset : datasets)
+		{
+			add_runs(dataset, algorithms, options, verbosity, format, runs.empty(), runs, jobs);
+		}
+
+		// Worker processes would keep their profiling data to themselves, so everything runs on threads when profiling
+		const bool profileRuns = profiling(profileOut);
+		const bool processes = options.num_processes != 0 && !profileRuns;
+
+		// Whatever was profiled before the runs (loading the datasets) gets its own report
+		if (profileRuns)
+		{
+			write_profile(profileOut, "load");
+		}
+
+		const auto start = Clock::now();
+		std::size_t numThreads = options.num_processes;
+		std::vector<bool> finished(jobs.size(), false);
+
+		// Run the jobs on worker processes if requested, which send back the time taken followed by the fold result
+		if (processes)
+		{
+			std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.cost > b.cost; });
+
+			const auto runJob = [&options, &jobs](std::size_t index)
+			{
+				const auto& job = jobs[index];
+				run_fold(options, *job.run, job.fold);
+
+				std::string result(sizeof(double), '\0');
+				std::memcpy(&result[0], &job.run->fold_seconds[job.fold], sizeof(double));
+				job.run->sink->fold(job.fold).serialize(result);
+				return result;
+			};
+
+			const auto onResult = [&jobs](std::size_t index, const std::string& result)
+			{
+				const auto& job = jobs[index];
+				std::memcpy(&job.run->fold_seconds[job.fold], result.data(), sizeof(double));
+				job.run->sink->fold(job.fold).deserialize(result.data() + sizeof(double), result.size() - sizeof(double));
+			};
+
+			finished = run_worker_processes(options.num_processes, jobs.size(), runJob, onResult);
+		}
+
+		// Run everything that wasn't run by a worker process on the thread pool
+		if (std::find(finished.begin(), finished.end(), false) != finished.end())
+		{
+			std::vector<Job> remaining;
+			for (std::size_t i = 0; i < jobs.size(); ++i)
+			{
+				if (!finished[i])
+				{
+					remaining.push_back(jobs[i]);
+				}
+			}
+
+			ThreadPool pool{ options.num_threads };
+			if (!processes)
+			{
+				numThreads = pool.num_threads();
+			}
+
+			if (profileRuns)
+			{
+				run_jobs_profiled(options, runs, remaining, pool, profileOut);
+			}
+			else
+			{
+				run_jobs(options, remaining, pool);
+			}
+		}
+		const auto wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		// Write out the reports in order
+		std::vector<RunSummary> runSummaries;
+		report_runs(runs, out, runSummaries);
+
+		if (verbosity != Verbosity::None)
+		{
+			write_summary(out, format, runSummaries, numThreads, processes, wallSeconds);
+		}
+
+		out.flush();
+
+		if (summaries)
+		{
+			summaries->insert(summaries->end(), runSummaries.begin(), runSummaries.end());
+		}
+
+		return true;
+	}
+
+	bool run_pipelined_experiment(
+		const std::vector<std::string>& datasetNames,
+		const std::function<DataSet(const std::string& name)>& load,
+		const ExperimentOptions& options,
+		std::ostream& out,
+		Verbosity verbosity,
+		ReportFormat format,
+		std::ostream* profileOut,
+		std::vector<NamedDataSet>* loaded)
+	{
+		assert(options.num_folds >= 2);
+
+		std::vector<const AlgorithmEntry*> algorithms;
+		if (!find_algorithms(options.algorithms, algorithms))
+		{
+			return false;
+		}
+
+		// Everything about a dataset that's passed from the loading stage to the evaluation stage
+		struct Stage
+		{
+			std::unique_ptr<NamedDataSet> dataset;
+			std::vector<std::unique_ptr<Run>> runs;
+			std::vector<Job> jobs;
+		};
+
+		BoundedQueue<Stage> queue{ options.pipeline_depth };
+		const auto start = Clock::now();
+
+		// Load each dataset and shuffle its folds on a background thread. Both draw from 'std::rand', so doing them all on the
+		// same thread keeps the folds the same however long each stage takes.
+		std::thread loader{ [&]()
+		{
+			for (std::size_t i = 0; i < datasetNames.size(); ++i)
+			{
+				Stage stage;
+				stage.dataset = std::make_unique<NamedDataSet>(datasetNames[i], load(datasetNames[i]));
+				add_runs(*stage.dataset, algorithms, options, verbosity, format, i == 0, stage.runs, stage.jobs);
+
+				if (!queue.push(std::move(stage)))
+				{
+					break;
+				}
+			}
+
+			queue.close();
+		} };
+
+		// Evaluate each dataset as soon as it's ready, while the next ones load
+		std::vector<RunSummary> summaries;
+		std::size_t numThreads;
+		{
+			ThreadPool pool{ options.num_threads };
+			numThreads = pool.num_threads();
+
+			Stage stage;
+			while (queue.pop(stage))
+			{
+				if (profiling(profileOut))
+				{
+					run_jobs_profiled(options, stage.runs, stage.jobs, pool, profileOut);
+				}
+				else
+				{
+					run_jobs(options, stage.jobs, pool);
+				}
+
+				report_runs(stage.runs, out, summaries);
+				out.flush();
+
+				if (loaded)
+				{
+					loaded->push_back(std::move(*stage.dataset));
+				}
+			}
+		}
+
+		loader.join();
+		const auto wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		if (verbosity != Verbosity::None)
+		{
+			write_summary(out, format, summaries, numThreads, false, wallSeconds);
+		}
+
+		out.flush();
+		return true;
+	}
+
+	bool run_sweep(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		const k_nearest_neighbor::SweepGrid& grid,
+		std::ostream& out,
+		ReportFormat format)
+	{
+		assert(options.num_folds >= 2);
+		if (grid.num_cells() == 0)
+		{
+			return false;
+		}
+
+		// Each fold records into its own matrices, which are merged once every fold has finished
+		std::vector<std::vector<std::vector<ConfusionMatrix>>> foldResults(datasets.size());
+		std::vector<Folds> folds(datasets.size());
+
+		// The folds are shuffled here rather than by the jobs, so they don't depend on the order the jobs run in
+		for (std::size_t d = 0; d < datasets.size(); ++d)
+		{
+			const auto& dataset = datasets[d].second;
+			folds[d] = Folds{ dataset, options.num_folds, options.stratified };
+
+			foldResults[d].assign(options.num_folds, std::vector<ConfusionMatrix>(grid.num_cells(), ConfusionMatrix{ dataset.num_classes() }));
+		}
+
+		const auto start = Clock::now();
+		std::size_t numThreads;
+		{
+			ThreadPool pool{ options.num_threads };
+			numThreads = pool.num_threads();
+
+			for (std::size_t d = 0; d < datasets.size(); ++d)
+			{
+				for (std::size_t fold = 0; fold < options.num_folds; ++fold)
+				{
+					pool.submit([&, d, fold]()
+					{
+						k_nearest_neighbor::sweep(datasets[d].second, folds[d].training_set(fold), folds[d].test_set(fold), grid, foldResults[d][fold]);
+					});
+				}
+			}
+
+			pool.wait();
+		}
+		const auto wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "{\"sweep\":[";
+		}
+
+		for (std::size_t d = 0; d < datasets.size(); ++d)
+		{
+			std::vector<ConfusionMatrix> totals(grid.num_cells());
+			for (const auto& fold : foldResults[d])
+			{
+				for (std::size_t cell = 0; cell < totals.size(); ++cell)
+				{
+					totals[cell].merge(fold[cell]);
+				}
+			}
+
+			switch (format)
+			{
+			case ReportFormat::Text:
+				// A row for each 'k', and a column for each 'q'
+				out << "Nearest Neighbor sweep on '" << datasets[d].first << "', accuracy by k and q:\n";
+				out << std::left << std::setw(6) << "k";
+				for (auto q : grid.qs)
+				{
+					out << std::setw(12) << ("q=" + std::to_string(q));
+				}
+				out << '\n';
+
+				for (std::size_t kIndex = 0; kIndex < grid.ks.size(); ++kIndex)
+				{
+					out << std::setw(6) << grid.ks[kIndex];
+					for (std::size_t qIndex = 0; qIndex < grid.qs.size(); ++qIndex)
+					{
+						std::ostringstream accuracy;
+						accuracy << totals[grid.cell(kIndex, qIndex)].accuracy() * 100 << '%';
+						out << std::setw(12) << accuracy.str();
+					}
+					out << '\n';
+				}
+				out << std::right << '\n';
+				break;
+
+			case ReportFormat::CSV:
+				for (std::size_t qIndex = 0; qIndex < grid.qs.size(); ++qIndex)
+				{
+					for (std::size_t kIndex = 0; kIndex < grid.ks.size(); ++kIndex)
+					{
+						out << "sweep," << datasets[d].first << ',' << grid.ks[kIndex] << ',' << grid.qs[qIndex] << ',';
+						out << totals[grid.cell(kIndex, qIndex)].accuracy() * 100 << '\n';
+					}
+				}
+				break;
+
+			case ReportFormat::JSON:
+				for (std::size_t qIndex = 0; qIndex < grid.qs.size(); ++qIndex)
+				{
+					for (std::size_t kIndex = 0; kIndex < grid.ks.size(); ++kIndex)
+					{
+						out << (d == 0 && qIndex == 0 && kIndex == 0 ? "" : ",");
+						out << "{\"dataset\":\"" << datasets[d].first << "\",\"k\":" << grid.ks[kIndex] << ",\"q\":" << grid.qs[qIndex];
+						out << ",\"accuracy\":" << totals[grid.cell(kIndex, qIndex)].accuracy() * 100 << '}';
+					}
+				}
+				break;
+			}
+		}
+
+		switch (format)
+		{
+		case ReportFormat::Text:
+			out << "Wall time: " << wallSeconds << "s on " << numThreads << (numThreads == 1 ? " thread\n" : " threads\n");
+			break;
+
+		case ReportFormat::CSV:
+			out << "time,,,wall,,,," << wallSeconds << '\n';
+			break;
+
+		case ReportFormat::JSON:
+			out << "],\"threads\":" << numThreads << ",\"wall_seconds\":" << wallSeconds << "}\n";
+			break;
+		}
+
+		out.flush();
+		return true;
+	}
+
+	void run_condensation(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		std::ostream& out,
+		ReportFormat format)
+	{
+		assert(options.num_folds >= 2);
+
+		k_nearest_neighbor::CondenseOptions condenseOptions;
+		condenseOptions.num_threads = options.num_threads;
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "{\"condensation\":[";
+		}
+		else if (format == ReportFormat::CSV)
+		{
+			out << "condensation,dataset,training,prototypes,full_accuracy,condensed_accuracy,full_us_per_query,condensed_us_per_query,condense_seconds\n";
+		}
+
+		for (std::size_t d = 0; d < datasets.size(); ++d)
+		{
+			const auto& dataset = datasets[d].second;
+			const Folds folds{ dataset, options.num_folds, options.stratified };
+
+			std::size_t trainingSize = 0;
+			std::size_t numPrototypes = 0;
+			std::size_t numTested = 0;
+			std::size_t fullCorrect = 0;
+			std::size_t condensedCorrect = 0;
+			double fullSeconds = 0;
+			double condensedSeconds = 0;
+			double condenseSeconds = 0;
+
+			for (std::size_t fold = 0; fold < options.num_folds; ++fold)
+			{
+				const auto trainingSet = folds.training_set(fold);
+				const auto testSet = folds.test_set(fold);
+
+				const auto full = k_nearest_neighbor::train(dataset, trainingSet, options.k);
+
+				auto start = Clock::now();
+				std::size_t foldPrototypes;
+				const auto condensed = k_nearest_neighbor::train_condensed(dataset, trainingSet, condenseOptions, &foldPrototypes);
+				condenseSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				start = Clock::now();
+				for (auto instance : testSet)
+				{
+					fullCorrect += full->classify(instance) == instance.get_class();
+				}
+				fullSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				start = Clock::now();
+				for (auto instance : testSet)
+				{
+					condensedCorrect += condensed->classify(instance) == instance.get_class();
+				}
+				condensedSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				trainingSize += trainingSet.size();
+				numPrototypes += foldPrototypes;
+				numTested += testSet.size();
+			}
+
+			const auto reduction = 100.0 * (1.0 - static_cast<double>(numPrototypes) / trainingSize);
+			const auto fullAccuracy = 100.0 * fullCorrect / numTested;
+			const auto condensedAccuracy = 100.0 * condensedCorrect / numTested;
+			const auto fullMicroseconds = fullSeconds * 1e6 / numTested;
+			const auto condensedMicroseconds = condensedSeconds * 1e6 / numTested;
+
+			switch (format)
+			{
+			case ReportFormat::Text:
+				out << "Nearest Neighbor condensation on '" << datasets[d].first << "' (k = " << options.k << " full, 1 condensed):\n";
+				out << "  Prototypes:  " << static_cast<double>(numPrototypes) / options.num_folds << " of " << static_cast<double>(trainingSize) / options.num_folds;
+				out << " training instances per fold (" << reduction << "% smaller)\n";
+				out << "  Accuracy:    " << fullAccuracy << "% full, " << condensedAccuracy << "% condensed (" << std::showpos << condensedAccuracy - fullAccuracy << std::noshowpos << "%)\n";
+				out << "  Query time:  " << fullMicroseconds << "us full, " << condensedMicroseconds << "us condensed\n";
+				out << "  Condensing:  " << condenseSeconds << "s\n\n";
+				break;
+
+			case ReportFormat::CSV:
+				out << "condensation," << datasets[d].first << ',' << trainingSize << ',' << numPrototypes << ',' << fullAccuracy << ',' << condensedAccuracy << ',';
+				out << fullMicroseconds << ',' << condensedMicroseconds << ',' << condenseSeconds << '\n';
+				break;
+
+			case ReportFormat::JSON:
+				out << (d == 0 ? "" : ",") << "{\"dataset\":\"" << datasets[d].first << "\",\"training\":" << trainingSize << ",\"prototypes\":" << numPrototypes;
+				out << ",\"full_accuracy\":" << fullAccuracy << ",\"condensed_accuracy\":" << condensedAccuracy;
+				out << ",\"full_us_per_query\":" << fullMicroseconds << ",\"condensed_us_per_query\":" << condensedMicroseconds;
+				out << ",\"condense_seconds\":" << condenseSeconds << '}';
+				break;
+			}
+		}
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "]}\n";
+		}
+
+		out.flush();
+	}
+
+	void run_selection(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		k_nearest_neighbor::SelectionOptions::Direction direction,
+		std::ostream& out,
+		ReportFormat format)
+	{
+		assert(options.num_folds >= 2);
+
+		k_nearest_neighbor::SelectionOptions selectionOptions;
+		selectionOptions.direction = direction;
+		selectionOptions.k = options.k;
+		selectionOptions.num_threads = options.num_threads;
+		const auto directionName = direction == k_nearest_neighbor::SelectionOptions::Direction::Forward ? "forward" : "backward";
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "{\"selection\":[";
+		}
+		else if (format == ReportFormat::CSV)
+		{
+			out << "selection,dataset,direction,attributes,selected,full_accuracy,selected_accuracy,full_us_per_query,selected_us_per_query,select_seconds\n";
+		}
+
+		for (std::size_t d = 0; d < datasets.size(); ++d)
+		{
+			const auto& dataset = datasets[d].second;
+			const Folds folds{ dataset, options.num_folds, options.stratified };
+
+			// The number of folds each attribute was chosen in
+			std::vector<std::size_t> timesSelected(dataset.num_attributes(), 0);
+			std::size_t numSelected = 0;
+			std::size_t numTested = 0;
+			std::size_t fullCorrect = 0;
+			std::size_t selectedCorrect = 0;
+			double fullSeconds = 0;
+			double selectedSeconds = 0;
+			double selectSeconds = 0;
+
+			for (std::size_t fold = 0; fold < options.num_folds; ++fold)
+			{
+				const auto trainingSet = folds.training_set(fold);
+				const auto testSet = folds.test_set(fold);
+
+				const auto full = k_nearest_neighbor::train(dataset, trainingSet, options.k);
+
+				auto start = Clock::now();
+				std::vector<std::size_t> attributes;
+				const auto selected = k_nearest_neighbor::train_selected(dataset, trainingSet, selectionOptions, &attributes);
+				selectSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				start = Clock::now();
+				for (auto instance : testSet)
+				{
+					fullCorrect += full->classify(instance) == instance.get_class();
+				}
+				fullSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				start = Clock::now();
+				for (auto instance : testSet)
+				{
+					selectedCorrect += selected->classify(instance) == instance.get_class();
+				}
+				selectedSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				for (auto attribIndex : attributes)
+				{
+					timesSelected[attribIndex] += 1;
+				}
+
+				numSelected += attributes.size();
+				numTested += testSet.size();
+			}
+
+			const auto averageSelected = static_cast<double>(numSelected) / options.num_folds;
+			const auto fullAccuracy = 100.0 * fullCorrect / numTested;
+			const auto selectedAccuracy = 100.0 * selectedCorrect / numTested;
+			const auto fullMicroseconds = fullSeconds * 1e6 / numTested;
+			const auto selectedMicroseconds = selectedSeconds * 1e6 / numTested;
+
+			switch (format)
+			{
+			case ReportFormat::Text:
+				out << "Nearest Neighbor " << directionName << " attribute selection on '" << datasets[d].first << "' (k = " << options.k << "):\n";
+				out << "  Attributes:  " << averageSelected << " of " << dataset.num_attributes() << " per fold\n";
+				out << "  Chosen in:   ";
+				for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+				{
+					if (timesSelected[attribIndex] != 0)
+					{
+						out << dataset.get_attribute(attribIndex).name << " (" << timesSelected[attribIndex] << ") ";
+					}
+				}
+				out << "folds\n";
+				out << "  Accuracy:    " << fullAccuracy << "% full, " << selectedAccuracy << "% selected (" << std::showpos << selectedAccuracy - fullAccuracy << std::noshowpos << "%)\n";
+				out << "  Query time:  " << fullMicroseconds << "us full, " << selectedMicroseconds << "us selected\n";
+				out << "  Selecting:   " << selectSeconds << "s\n\n";
+				break;
+
+			case ReportFormat::CSV:
+				out << "selection," << datasets[d].first << ',' << directionName << ',' << dataset.num_attributes() << ',' << averageSelected << ',';
+				out << fullAccuracy << ',' << selectedAccuracy << ',' << fullMicroseconds << ',' << selectedMicroseconds << ',' << selectSeconds << '\n';
+				break;
+
+			case ReportFormat::JSON:
+				out << (d == 0 ? "" : ",") << "{\"dataset\":\"" << datasets[d].first << "\",\"direction\":\"" << directionName << '"';
+				out << ",\"attributes\":" << dataset.num_attributes() << ",\"selected\":" << averageSelected << ",\"times_selected\":[";
+				for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+				{
+					out << (attribIndex == 0 ? "" : ",") << timesSelected[attribIndex];
+				}
+				out << "],\"full_accuracy\":" << fullAccuracy << ",\"selected_accuracy\":" << selectedAccuracy;
+				out << ",\"full_us_per_query\":" << fullMicroseconds << ",\"selected_us_per_query\":" << selectedMicroseconds;
+				out << ",\"select_seconds\":" << selectSeconds << '}';
+				break;
+			}
+		}
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "]}\n";
+		}
+
+		out.flush();
+	}
+
+	void run_cache_replay(
+		const std::vector<NamedDataSet>& datasets,
+		std::size_t cacheCapacity,
+		std::ostream& out,
+		ReportFormat format)
+	{
+		if (format == ReportFormat::JSON)
+		{
+			out << "{\"cache_replay\":[";
+		}
+		else if (format == ReportFormat::CSV)
+		{
+			out << "cache_replay,dataset,model,queries,uncached_ns_per_query,cached_ns_per_query,warm_ns_per_query,hit_rate\n";
+		}
+
+		bool first = true;
+		for (const auto& named : datasets)
+		{
+			const auto& dataset = named.second;
+			const auto numAttributes = dataset.num_attributes();
+			std::vector<std::size_t> indices;
+			const auto trainingSet = view_all(dataset, indices);
+
+			// Take out the values of every instance up front, so only classifying is timed
+			std::vector<Attribute::ValueIndex> values;
+			values.reserve(dataset.num_instances() * numAttributes);
+			for (auto instance : trainingSet)
+			{
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					values.push_back(instance.get_attrib(attribIndex));
+				}
+			}
+
+			const std::pair<const char*, std::shared_ptr<const Model>> models[] = {
+				{ "Nearest Neighbor", k_nearest_neighbor::train(dataset, trainingSet) },
+				{ "ID3", id3_rep::train(dataset, trainingSet) }
+			};
+
+			for (const auto& model : models)
+			{
+				const auto numQueries = dataset.num_instances() * REPLAY_PASSES;
+				std::vector<ClassIndex> expected(dataset.num_instances());
+				std::size_t numMismatched = 0;
+
+				auto start = Clock::now();
+				for (std::size_t pass = 0; pass < REPLAY_PASSES; ++pass)
+				{
+					for (std::size_t i = 0; i < dataset.num_instances(); ++i)
+					{
+						expected[i] = model.second->classify(&values[i * numAttributes]);
+					}
+				}
+				const auto uncachedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+				// The first pass fills the cache, the rest should mostly hit it
+				const CachedModel cached{ model.second, dataset, cacheCapacity };
+				double warmSeconds = 0;
+				start = Clock::now();
+				for (std::size_t pass = 0; pass < REPLAY_PASSES; ++pass)
+				{
+					const auto passStart = Clock::now();
+					for (std::size_t i = 0; i < dataset.num_instances(); ++i)
+					{
+						numMismatched += cached.classify(&values[i * numAttributes]) != expected[i];
+					}
+
+					if (pass != 0)
+					{
+						warmSeconds += std::chrono::duration<double>(Clock::now() - passStart).count();
+					}
+				}
+				const auto cachedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+				assert(numMismatched == 0);
+				static_cast<void>(numMismatched);
+
+				const auto stats = cached.stats();
+				const auto uncachedNanoseconds = uncachedSeconds * 1e9 / numQueries;
+				const auto cachedNanoseconds = cachedSeconds * 1e9 / numQueries;
+				const auto warmNanoseconds = warmSeconds * 1e9 / (numQueries - dataset.num_instances());
+
+				switch (format)
+				{
+				case ReportFormat::Text:
+					out << model.first << " on '" << named.first << "', " << numQueries << " queries:\n";
+					out << "  Uncached:    " << uncachedNanoseconds << "ns per query\n";
+					out << "  Cached:      " << cachedNanoseconds << "ns per query, " << warmNanoseconds << "ns after the first pass\n";
+					out << "  Cache:       " << stats << "\n\n";
+					break;
+
+				case ReportFormat::CSV:
+					out << "cache_replay," << named.first << ',' << model.first << ',' << numQueries << ',' << uncachedNanoseconds << ',';
+					out << cachedNanoseconds << ',' << warmNanoseconds << ',' << stats.hit_rate() * 100 << '\n';
+					break;
+
+				case ReportFormat::JSON:
+					out << (first ? "" : ",") << "{\"dataset\":\"" << named.first << "\",\"model\":\"" << model.first << "\",\"queries\":" << numQueries;
+					out << ",\"uncached_ns_per_query\":" << uncachedNanoseconds << ",\"cached_ns_per_query\":" << cachedNanoseconds;
+					out << ",\"warm_ns_per_query\":" << warmNanoseconds << ",\"hits\":" << stats.hits << ",\"misses\":" << stats.misses;
+					out << ",\"evictions\":" << stats.evictions << ",\"hit_rate\":" << stats.hit_rate() * 100 << '}';
+					break;
+				}
+
+				first = false;
+			}
+		}
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "]}\n";
+		}
+
+		out.flush();
+	}
+
+	void run_shard_scaling(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		std::size_t numRows,
+		std::ostream& out,
+		ReportFormat format)
+	{
+		const auto maxThreads = options.num_threads != 0 ? options.num_threads : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+		// Double the number of threads up to the most requested
+		std::vector<std::size_t> threadCounts;
+		for (std::size_t numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+		{
+			threadCounts.push_back(numThreads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "{\"shard_scaling\":[";
+		}
+		else if (format == ReportFormat::CSV)
+		{
+			out << "shard_scaling,dataset,rows,threads,ms_per_query,speedup,consistent,agrees_with_unsharded\n";
+		}
+
+		bool first = true;
+		for (const auto& named : datasets)
+		{
+			const auto& dataset = named.second;
+			const auto numAttributes = dataset.num_attributes();
+
+			// Repeat the dataset's instances until there are enough training rows
+			std::vector<std::size_t> indices(std::max(numRows, dataset.num_instances()));
+			for (std::size_t i = 0; i < indices.size(); ++i)
+			{
+				indices[i] = i % dataset.num_instances();
+			}
+			const DataView trainingSet{ dataset, indices };
+
+			// Take out the values of the queries up front, so only classifying is timed
+			const auto numQueries = std::min(SHARD_QUERIES, dataset.num_instances());
+			std::vector<Attribute::ValueIndex> values;
+			values.reserve(numQueries * numAttributes);
+			for (std::size_t i = 0; i < numQueries; ++i)
+			{
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					values.push_back(trainingSet[i].get_attrib(attribIndex));
+				}
+			}
+
+			// Time a single query at a time, with the given model
+			const auto timeQueries = [&](const Model& model, std::vector<ClassIndex>& predictions)
+			{
+				predictions.resize(numQueries);
+				const auto start = Clock::now();
+				for (std::size_t i = 0; i < numQueries; ++i)
+				{
+					predictions[i] = model.classify(&values[i * numAttributes]);
+				}
+
+				return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / numQueries;
+			};
+
+			std::vector<ClassIndex> unshardedPredictions;
+			const auto unshardedMilliseconds = timeQueries(*k_nearest_neighbor::train(dataset, trainingSet, options.k), unshardedPredictions);
+
+			if (format == ReportFormat::Text)
+			{
+				out << "Sharded nearest neighbor on '" << named.first << "', " << trainingSet.size() << " rows, " << numQueries << " queries:\n";
+				out << "  Unsharded:   " << unshardedMilliseconds << "ms per query\n";
+			}
+
+			std::vector<ClassIndex> expected;
+			double oneThreadMilliseconds = 0;
+			for (auto numThreads : threadCounts)
+			{
+				std::vector<ClassIndex> predictions;
+				const auto model = k_nearest_neighbor::train_sharded(dataset, trainingSet, options.k, numThreads);
+				const auto milliseconds = timeQueries(*model, predictions);
+
+				// Every number of threads should make the same predictions as the first
+				if (expected.empty())
+				{
+					expected = predictions;
+					oneThreadMilliseconds = milliseconds;
+				}
+				const bool consistent = predictions == expected;
+				assert(consistent);
+
+				std::size_t numAgreed = 0;
+				for (std::size_t i = 0; i < numQueries; ++i)
+				{
+					numAgreed += predictions[i] == unshardedPredictions[i];
+				}
+
+				const auto speedup = oneThreadMilliseconds / milliseconds;
+
+				switch (format)
+				{
+				case ReportFormat::Text:
+					out << "  " << std::left << std::setw(13) << (std::to_string(numThreads) + (numThreads == 1 ? " thread:" : " threads:")) << std::right;
+					out << milliseconds << "ms per query, " << speedup << "x";
+					out << (consistent ? "" : ", INCONSISTENT") << ", " << numAgreed << '/' << numQueries << " agree with unsharded\n";
+					break;
+
+				case ReportFormat::CSV:
+					out << "shard_scaling," << named.first << ',' << trainingSet.size() << ',' << numThreads << ',' << milliseconds << ',';
+					out << speedup << ',' << consistent << ',' << numAgreed << '\n';
+					break;
+
+				case ReportFormat::JSON:
+					out << (first ? "" : ",") << "{\"dataset\":\"" << named.first << "\",\"rows\":" << trainingSet.size() << ",\"threads\":" << numThreads;
+					out << ",\"ms_per_query\":" << milliseconds << ",\"unsharded_ms_per_query\":" << unshardedMilliseconds << ",\"speedup\":" << speedup;
+					out << ",\"consistent\":" << (consistent ? "true" : "false") << ",\"agrees_with_unsharded\":" << numAgreed << '}';
+					break;
+				}
+
+				first = false;
+			}
+
+			if (format == ReportFormat::Text)
+			{
+				out << '\n';
+			}
+		}
+
+		if (format == ReportFormat::JSON)
+		{
+			out << "]}\n";
+		}
+
+		out.flush();
+	}
+}
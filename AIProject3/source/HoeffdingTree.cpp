@@ -0,0 +1,260 @@
+// HoeffdingTree.cpp - Will Cassella
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "../include/HoeffdingTree.h"
+#include "../include/ID3.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+
+namespace ml
+{
+	namespace id3_rep
+	{
+		namespace
+		{
+			/* Returns the class with the highest count, or 'fallback' if all counts are zero. */
+			ClassIndex majority_class(const std::size_t* classCounts, std::size_t numClasses, ClassIndex fallback)
+			{
+				ClassIndex result = fallback;
+				std::size_t resultCount = 0;
+
+				for (ClassIndex i = 0; i < numClasses; ++i)
+				{
+					if (classCounts[i] > resultCount)
+					{
+						result = i;
+						resultCount = classCounts[i];
+					}
+				}
+
+				return result;
+			}
+		}
+
+		HoeffdingTree::HoeffdingTree(const DataSet& schema, HoeffdingOptions options)
+			: _schema(&schema),
+			_options(options),
+			_num_classes(schema.num_classes())
+		{
+			// Lay out the (value, class) counts of each attribute back to back
+			_attribute_offsets.reserve(schema.num_attributes());
+			for (Attribute::Index i = 0; i < schema.num_attributes(); ++i)
+			{
+				_attribute_offsets.push_back(_stats_size);
+				_stats_size += schema.get_attribute(i).domain.size() * _num_classes;
+			}
+
+			// The root starts out as a leaf that may split on any attribute
+			std::vector<Attribute::Index> attributes(schema.num_attributes());
+			for (Attribute::Index i = 0; i < attributes.size(); ++i)
+			{
+				attributes[i] = i;
+			}
+
+			Node root;
+			root.stats = create_stats(std::move(attributes));
+			_nodes.push_back(root);
+		}
+
+		void HoeffdingTree::learn(ClassIndex classIndex, const Attribute::ValueIndex* values)
+		{
+			const auto leafIndex = find_leaf(values);
+			auto& stats = _stats[_nodes[leafIndex].stats];
+
+			stats.class_counts[classIndex] += 1;
+			for (auto attrib : stats.attributes)
+			{
+				stats.value_class_counts[_attribute_offsets[attrib] + values[attrib] * _num_classes + classIndex] += 1;
+			}
+
+			stats.seen += 1;
+			if (stats.seen - stats.seen_at_last_attempt >= _options.grace_period)
+			{
+				stats.seen_at_last_attempt = stats.seen;
+				attempt_split(leafIndex);
+			}
+		}
+
+		void HoeffdingTree::learn(Instance instance)
+		{
+			std::vector<Attribute::ValueIndex> values(_schema->num_attributes());
+			for (Attribute::Index i = 0; i < values.size(); ++i)
+			{
+				values[i] = instance.get_attrib(i);
+			}
+
+			learn(instance.get_class(), values.data());
+		}
+
+		ClassIndex HoeffdingTree::classify(const Attribute::ValueIndex* values) const
+		{
+			const auto& leaf = _nodes[find_leaf(values)];
+			return majority_class(_stats[leaf.stats].class_counts.data(), _num_classes, leaf.class_index);
+		}
+
+		ClassIndex HoeffdingTree::classify(Instance instance) const
+		{
+			std::vector<Attribute::ValueIndex> values(_schema->num_attributes());
+			for (Attribute::Index i = 0; i < values.size(); ++i)
+			{
+				values[i] = instance.get_attrib(i);
+			}
+
+			return classify(values.data());
+		}
+
+		std::size_t HoeffdingTree::find_leaf(const Attribute::ValueIndex* values) const
+		{
+			// The root is never a child, so a 'first_child' of zero means this is a leaf
+			std::size_t index = 0;
+			while (_nodes[index].first_child != 0)
+			{
+				index = _nodes[index].first_child + values[_nodes[index].split_attribute];
+			}
+
+			return index;
+		}
+
+		std::size_t HoeffdingTree::create_stats(std::vector<Attribute::Index> attributes)
+		{
+			_num_learning_leaves += 1;
+
+			std::size_t index;
+			if (_free_stats.empty())
+			{
+				index = _stats.size();
+				_stats.emplace_back();
+			}
+			else
+			{
+				index = _free_stats.back();
+				_free_stats.pop_back();
+			}
+
+			auto& stats = _stats[index];
+			stats.class_counts.assign(_num_classes, 0);
+			stats.value_class_counts.assign(_stats_size, 0);
+			stats.attributes = std::move(attributes);
+			stats.seen = 0;
+			stats.seen_at_last_attempt = 0;
+
+			return index;
+		}
+
+		void HoeffdingTree::attempt_split(std::size_t nodeIndex)
+		{
+			ML_PROFILE_SCOPE(SplitEvaluation);
+			const auto statsIndex = _nodes[nodeIndex].stats;
+
+			{
+				const auto& stats = _stats[statsIndex];
+				const auto entropy = entropy_from_counts(stats.class_counts.data(), _num_classes).first;
+
+				if (entropy == 0 || stats.attributes.empty())
+				{
+					return;
+				}
+
+				// Find the best two attributes to split on
+				auto best = stats.attributes.begin();
+				float bestGain = std::numeric_limits<float>::lowest();
+				float secondBestGain = 0.f;
+
+				for (auto iter = stats.attributes.begin(); iter != stats.attributes.end(); ++iter)
+				{
+					const auto gain = information_gain_from_counts(
+						&stats.value_class_counts[_attribute_offsets[*iter]],
+						_schema->get_attribute(*iter).domain.size(),
+						_num_classes,
+						entropy);
+
+					if (gain > bestGain)
+					{
+						secondBestGain = std::max(secondBestGain, bestGain);
+						bestGain = gain;
+						best = iter;
+					}
+					else if (gain > secondBestGain)
+					{
+						secondBestGain = gain;
+					}
+				}
+
+				// Check the Hoeffding bound, the range of information gain is log2 of the number of classes
+				const float range = std::log2(static_cast<float>(std::max<std::size_t>(_num_classes, 2)));
+				const float epsilon = std::sqrt(range * range * std::log(1.f / _options.delta) / (2.f * stats.seen));
+
+				if (bestGain <= 0.f || (bestGain - secondBestGain <= epsilon && epsilon >= _options.tie_threshold))
+				{
+					return;
+				}
+
+				// Don't grow past the limit on learning leaves
+				const auto splitAttrib = *best;
+				const auto domainSize = _schema->get_attribute(splitAttrib).domain.size();
+				if (_num_learning_leaves - 1 + domainSize > _options.max_leaves)
+				{
+					return;
+				}
+
+				// Create a child for each value, predicting the majority class seen with that value until it learns its own
+				std::vector<Attribute::Index> childAttributes;
+				childAttributes.reserve(stats.attributes.size() - 1);
+				std::copy_if(stats.attributes.begin(), stats.attributes.end(), std::back_inserter(childAttributes),
+					[splitAttrib](Attribute::Index attrib) { return attrib != splitAttrib; });
+
+				const auto parentClass = majority_class(stats.class_counts.data(), _num_classes, _nodes[nodeIndex].class_index);
+				const auto firstChild = _nodes.size();
+
+				for (Attribute::ValueIndex value = 0; value < domainSize; ++value)
+				{
+					Node child;
+					child.class_index = majority_class(
+						&_stats[statsIndex].value_class_counts[_attribute_offsets[splitAttrib] + value * _num_classes],
+						_num_classes,
+						parentClass);
+					child.stats = create_stats(childAttributes);
+					_nodes.push_back(child);
+				}
+
+				auto& node = _nodes[nodeIndex];
+				node.class_index = parentClass;
+				node.split_attribute = splitAttrib;
+				node.first_child = firstChild;
+			}
+
+			// The node is no longer a leaf, so release its statistics
+			_nodes[nodeIndex].stats = NO_STATS;
+			_free_stats.push_back(statsIndex);
+			_num_learning_leaves -= 1;
+		}
+
+		std::size_t hoeffding_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result)
+		{
+			HoeffdingTree tree{ dataset };
+
+			// A single pass over the training stream
+			for (auto instance : trainingSet)
+			{
+				tree.learn(instance);
+			}
+
+			std::size_t numCorrect = 0;
+			for (auto instance : testSet)
+			{
+				ML_PROFILE_SCOPE(Classify);
+				auto classIndex = tree.classify(instance);
+				if (classIndex == instance.get_class())
+				{
+					numCorrect += 1;
+				}
+
+				result.record(instance, classIndex);
+			}
+
+			return numCorrect;
+		}
+	}
+}
@@ -1,13 +1,24 @@
 // ID3.cpp - Will Cassella
 
 #include <cmath>
+#include <cstdint>
 #include <tuple>
+#include <memory>
+#include <algorithm>
 #include <future>
 #include <numeric>
 #include <limits>
-#include <iostream>
+#include <random>
+#include <string>
+#include <ostream>
 #include "../include/ID3.h"
 #include "../include/DataSet.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+#include "../include/Arena.h"
+#include "../include/Model.h"
+#include "../include/BitmapIndex.h"
+#include "../include/ThreadPool.h"
 
 namespace ml
 {
@@ -41,66 +52,72 @@ namespace ml
 
 			/**
 			* \brief The children of this node. If this is empty, you should consider this node a leaf node and check it's 'class_index' field.
+			* These are allocated in the arena of the training run that built the tree, and are freed along with it.
 			*/
-			std::vector<std::unique_ptr<Node>> children;
+			Span<Node> children;
 		};
 
 		/**
 		 * \brief Splits the given instance subset by the given attribute.
-		 * \param subset The subset to split.
+		 * \param subset The subset to split, either a span of instances or a view.
 		 * \param attrib The index of the attribute to split the subset by.
 		 * \param attribDomainSize The size of the domain of the attribute.
+		 * \param arena The arena to allocate the split subsets in.
 		 * \return The subset split by the attribute.
 		 */
-		auto split_subset(
-			const std::vector<Instance>& subset,
+		template <typename InstancesT>
+		Span<Span<const Instance>> split_subset(
+			const InstancesT& subset,
 			const Attribute::Index attrib,
-			const std::size_t attribDomainSize)
+			const std::size_t attribDomainSize,
+			Arena& arena)
 		{
-			std::vector<std::vector<Instance>> result;
-			result.assign(attribDomainSize, {});
+			// Count up how many instances go into each split
+			auto counts = arena.create_array<std::size_t>(attribDomainSize);
+			for (auto instance : subset)
+			{
+				counts[instance.get_attrib(attrib)] += 1;
+			}
+
+			// Lay the splits out back to back in a single buffer
+			auto* buffer = static_cast<Instance*>(arena.allocate(sizeof(Instance) * subset.size(), alignof(Instance)));
+			auto result = arena.create_array<Span<const Instance>>(attribDomainSize);
+
+			std::size_t offset = 0;
+			for (Attribute::ValueIndex value = 0; value < attribDomainSize; ++value)
+			{
+				result[value] = Span<const Instance>{ buffer + offset, counts[value] };
+				counts[value] = offset;
+				offset += result[value].size();
+			}
 
 			for (auto instance : subset)
 			{
-				result[instance.get_attrib(attrib)].push_back(instance);
+				new (buffer + counts[instance.get_attrib(attrib)]++) Instance(instance);
 			}
 
 			return result;
 		}
 
-		/* Calculates the entropy of the subset, taking a predicate to filter the subset further. */
-		template <typename PredFnT>
-		std::pair<float, ClassIndex> calculate_entropy(
-			const std::vector<Instance>& subset,
-			const std::size_t numClasses,
-			PredFnT&& pred)
+		std::pair<float, ClassIndex> entropy_from_counts(
+			const std::size_t* classCounts,
+			const std::size_t numClasses)
 		{
 			float entropy = 0;
 			std::size_t instanceCount = 0;
 
-			// Array of all
-			std::vector<std::size_t> classCounter;
-			classCounter.assign(numClasses, 0);
-
-			for (const auto& instance : subset)
+			for (ClassIndex i = 0; i < numClasses; ++i)
 			{
-				// If we're considering this instance when calculating the entropy
-				if (pred(instance))
-				{
-					instanceCount += 1;
-
-					// Increment the counter for the class this instance is a member of
-					classCounter[instance.get_class()] += 1;
-				}
+				instanceCount += classCounts[i];
 			}
 
 			ClassIndex mostCommonClass = 0;
 			std::size_t mostCommonClassCount = 0;
 
 			// For each class that we counted up
-			for (ClassIndex i = 0; i < classCounter.size(); ++i)
+			for (ClassIndex i = 0; i < numClasses; ++i)
 			{
-				const std::size_t count = classCounter[i];
+				const std::size_t count = classCounts[i];
 
 				if (count == 0)
 				{
@@ -119,62 +136,383 @@ namespace ml
 			return std::make_pair(-entropy, mostCommonClass);
 		}
 
-		/* Calculates the information gain by splitting the given subset on the given attribute. */
-		float calculate_information_gain(
-			const std::vector<Instance>& subset,
+		float information_gain_from_counts(
+			const std::size_t* valueClassCounts,
+			const std::size_t domainSize,
 			const std::size_t numClasses,
-			const float currentEntropy,
-			const Attribute::Index splitAttribute,
-			const std::size_t splitAttributeDomainSize)
+			const float currentEntropy)
 		{
+			std::size_t instanceCount = 0;
+			for (std::size_t i = 0; i < domainSize * numClasses; ++i)
+			{
+				instanceCount += valueClassCounts[i];
+			}
+
 			float attribEntropy = 0;
 
-			for (Attribute::ValueIndex value = 0; value < splitAttributeDomainSize; ++value)
+			for (Attribute::ValueIndex value = 0; value < domainSize; ++value)
 			{
+				const auto* classCounts = valueClassCounts + value * numClasses;
+
 				// Keep track of the number of values in this
 				float valueProportion = 0.f;
-				auto predicate = [&valueProportion, value, splitAttribute](Instance instance)
+				for (ClassIndex i = 0; i < numClasses; ++i)
 				{
-					if (instance.get_attrib(splitAttribute) == value)
-					{
-						valueProportion += 1.f;
-						return true;
-					}
-					else
-					{
-						return false;
-					}
-				};
+					valueProportion += classCounts[i];
+				}
 
 				// Calculate the entropy for this value's branch of the attribute
-				const float valueEntropy = calculate_entropy(subset, numClasses, predicate).first;
-				attribEntropy += valueProportion / subset.size() * valueEntropy;
+				const float valueEntropy = entropy_from_counts(classCounts, numClasses).first;
+				attribEntropy += valueProportion / instanceCount * valueEntropy;
 			}
 
 			return currentEntropy - attribEntropy;
 		}
 
+		/* Calculates the entropy of the subset, along with its most common class. 'classCounter' is scratch space with an element for each class. */
+		template <typename InstancesT>
+		std::pair<float, ClassIndex> calculate_entropy(
+			const InstancesT& subset,
+			Span<std::size_t> classCounter)
+		{
+			std::fill(classCounter.begin(), classCounter.end(), 0);
+
+			for (const auto& instance : subset)
+			{
+				// Increment the counter for the class this instance is a member of
+				classCounter[instance.get_class()] += 1;
+			}
+
+			return entropy_from_counts(classCounter.data(), classCounter.size());
+		}
+
+		/**
+		 * \brief Calculates the information gain by splitting the given subset on the given attribute.
+		 * 'valueClassCounter' is scratch space with an element for each (value, class) pair of the attribute.
+		 */
+		template <typename InstancesT>
+		float calculate_information_gain(
+			const InstancesT& subset,
+			Span<std::size_t> valueClassCounter,
+			const std::size_t numClasses,
+			const float currentEntropy,
+			const Attribute::Index splitAttribute,
+			const std::size_t splitAttributeDomainSize)
+		{
+			ML_PROFILE_SCOPE(SplitEvaluation);
+
+			// Count up the instances with each value in each class, in a single pass
+			std::fill(valueClassCounter.begin(), valueClassCounter.begin() + splitAttributeDomainSize * numClasses, 0);
+			for (const auto& instance : subset)
+			{
+				valueClassCounter[instance.get_attrib(splitAttribute) * numClasses + instance.get_class()] += 1;
+			}
+
+			return information_gain_from_counts(valueClassCounter.data(), splitAttributeDomainSize, numClasses, currentEntropy);
+		}
+
+		/* A subset of the dataset, represented by a bitmap of its instances. */
+		struct BitmapSubset
+		{
+			const BitmapIndex* index;
+			const BitmapIndex::Word* bits;
+		};
+
+		/* Splits the given bitmap subset by the given attribute, by intersecting it with the bitmap of each value. */
+		Span<BitmapSubset> split_subset(
+			const BitmapSubset subset,
+			const Attribute::Index attrib,
+			const std::size_t attribDomainSize,
+			Arena& arena)
+		{
+			const auto numWords = subset.index->num_words();
+			auto result = arena.create_array<BitmapSubset>(attribDomainSize);
+
+			for (Attribute::ValueIndex value = 0; value < attribDomainSize; ++value)
+			{
+				auto* bits = static_cast<BitmapIndex::Word*>(arena.allocate(sizeof(BitmapIndex::Word) * numWords, alignof(BitmapIndex::Word)));
+				intersect(subset.bits, subset.index->value_bitmap(attrib, value), bits, numWords);
+				result[value] = BitmapSubset{ subset.index, bits };
+			}
+
+			return result;
+		}
+
+		/* Calculates the entropy of the bitmap subset, along with its most common class. 'classCounter' is scratch space with an element for each class. */
+		std::pair<float, ClassIndex> calculate_entropy(
+			const BitmapSubset subset,
+			Span<std::size_t> classCounter)
+		{
+			for (ClassIndex classIndex = 0; classIndex < classCounter.size(); ++classIndex)
+			{
+				classCounter[classIndex] = count_and(subset.bits, subset.index->class_bitmap(classIndex), subset.index->num_words());
+			}
+
+			return entropy_from_counts(classCounter.data(), classCounter.size());
+		}
+
+		/* Calculates the information gain by splitting the bitmap subset on the given attribute, by counting the intersections of its bitmaps. */
+		float calculate_information_gain(
+			const BitmapSubset subset,
+			Span<std::size_t> valueClassCounter,
+			const std::size_t numClasses,
+			const float currentEntropy,
+			const Attribute::Index splitAttribute,
+			const std::size_t splitAttributeDomainSize)
+		{
+			ML_PROFILE_SCOPE(SplitEvaluation);
+			const auto numWords = subset.index->num_words();
+
+			for (Attribute::ValueIndex value = 0; value < splitAttributeDomainSize; ++value)
+			{
+				const auto* valueBits = subset.index->value_bitmap(splitAttribute, value);
+				auto* classCounts = &valueClassCounter[value * numClasses];
+
+				// The last class gets whatever's left, so it doesn't need to be counted
+				std::size_t remaining = count_and(subset.bits, valueBits, numWords);
+				for (ClassIndex classIndex = 0; classIndex + 1 < numClasses; ++classIndex)
+				{
+					classCounts[classIndex] = remaining == 0 ? 0 : count_and(subset.bits, valueBits, subset.index->class_bitmap(classIndex), numWords);
+					remaining -= classCounts[classIndex];
+				}
+
+				classCounts[numClasses - 1] = remaining;
+			}
+
+			return information_gain_from_counts(valueClassCounter.data(), splitAttributeDomainSize, numClasses, currentEntropy);
+		}
+
+		/**
+		 * \brief A subset of the dataset with repeats, such as a bootstrap sample, represented by the distinct instance indices and the number of times each is in it.
+		 * The values are read straight out of the dataset's columns, so any number of these may share them.
+		 */
+		struct WeightedSubset
+		{
+			const DataSet* dataset;
+			Span<const std::uint32_t> indices;
+			Span<const std::uint32_t> weights;
+
+			/* Each node only considers this many of the remaining attributes, picked at random. */
+			std::size_t num_candidates;
+			std::minstd_rand* random;
+		};
+
+		/* Splits the given weighted subset by the given attribute. */
+		Span<WeightedSubset> split_subset(
+			const WeightedSubset subset,
+			const Attribute::Index attrib,
+			const std::size_t attribDomainSize,
+			Arena& arena)
+		{
+			const auto& values = subset.dataset->get_attribute(attrib).instance_values;
+
+			// Count up how many distinct instances go into each split
+			auto counts = arena.create_array<std::size_t>(attribDomainSize);
+			for (auto index : subset.indices)
+			{
+				counts[values[index]] += 1;
+			}
+
+			// Lay the splits out back to back in a single buffer
+			auto indices = arena.create_array<std::uint32_t>(subset.indices.size());
+			auto weights = arena.create_array<std::uint32_t>(subset.indices.size());
+			auto result = arena.create_array<WeightedSubset>(attribDomainSize);
+
+			std::size_t offset = 0;
+			for (Attribute::ValueIndex value = 0; value < attribDomainSize; ++value)
+			{
+				result[value] = WeightedSubset{
+					subset.dataset,
+					Span<const std::uint32_t>{ indices.data() + offset, counts[value] },
+					Span<const std::uint32_t>{ weights.data() + offset, counts[value] },
+					subset.num_candidates,
+					subset.random };
+				counts[value] = offset;
+				offset += result[value].indices.size();
+			}
+
+			for (std::size_t i = 0; i < subset.indices.size(); ++i)
+			{
+				const auto position = counts[values[subset.indices[i]]]++;
+				indices[position] = subset.indices[i];
+				weights[position] = subset.weights[i];
+			}
+
+			return result;
+		}
+
+		/* Calculates the entropy of the weighted subset, along with its most common class. 'classCounter' is scratch space with an element for each class. */
+		std::pair<float, ClassIndex> calculate_entropy(
+			const WeightedSubset subset,
+			Span<std::size_t> classCounter)
+		{
+			std::fill(classCounter.begin(), classCounter.end(), 0);
+
+			for (std::size_t i = 0; i < subset.indices.size(); ++i)
+			{
+				classCounter[subset.dataset->get_instance(subset.indices[i]).get_class()] += subset.weights[i];
+			}
+
+			return entropy_from_counts(classCounter.data(), classCounter.size());
+		}
+
+		/* Calculates the information gain by splitting the weighted subset on the given attribute. */
+		float calculate_information_gain(
+			const WeightedSubset subset,
+			Span<std::size_t> valueClassCounter,
+			const std::size_t numClasses,
+			const float currentEntropy,
+			const Attribute::Index splitAttribute,
+			const std::size_t splitAttributeDomainSize)
+		{
+			ML_PROFILE_SCOPE(SplitEvaluation);
+			const auto& values = subset.dataset->get_attribute(splitAttribute).instance_values;
+
+			std::fill(valueClassCounter.begin(), valueClassCounter.begin() + splitAttributeDomainSize * numClasses, 0);
+			for (std::size_t i = 0; i < subset.indices.size(); ++i)
+			{
+				const auto index = subset.indices[i];
+				valueClassCounter[values[index] * numClasses + subset.dataset->get_instance(index).get_class()] += subset.weights[i];
+			}
+
+			return information_gain_from_counts(valueClassCounter.data(), splitAttributeDomainSize, numClasses, currentEntropy);
+		}
+
+		template <typename SubsetT>
+		void id3_recurse(
+			const DataSet& dataset,
+			const SubsetT subset,
+			Span<const Attribute::Index> attributes,
+			const Node* parent,
+			Node& node,
+			Arena& arena);
+
+		/* Recurses into a child node built from a list of instances. */
+		void id3_recurse_child(
+			const DataSet& dataset,
+			Span<const Instance> subset,
+			Span<const Attribute::Index> attributes,
+			const Node* parent,
+			Node& node,
+			Arena& arena)
+		{
+			id3_recurse(dataset, subset, attributes, parent, node, arena);
+		}
+
+		/* Returns the attributes a node may split on, which is all of the remaining ones. */
+		template <typename SubsetT>
+		Span<const Attribute::Index> candidate_attributes(
+			const SubsetT& /*subset*/,
+			Span<const Attribute::Index> attributes,
+			Arena& /*arena*/)
+		{
+			return attributes;
+		}
+
+		/* Returns a random selection of the remaining attributes for a node of a weighted subset to split on, in their original order. */
+		Span<const Attribute::Index> candidate_attributes(
+			const WeightedSubset& subset,
+			Span<const Attribute::Index> attributes,
+			Arena& arena)
+		{
+			if (attributes.size() <= subset.num_candidates)
+			{
+				return attributes;
+			}
+
+			auto result = arena.create_array<Attribute::Index>(attributes.size());
+			std::copy(attributes.begin(), attributes.end(), result.begin());
+
+			for (std::size_t i = 0; i < subset.num_candidates; ++i)
+			{
+				std::uniform_int_distribution<std::size_t> pick{ i, result.size() - 1 };
+				std::swap(result[i], result[pick(*subset.random)]);
+			}
+
+			std::sort(result.begin(), result.begin() + subset.num_candidates);
+			return Span<const Attribute::Index>{ result.data(), subset.num_candidates };
+		}
+
+		/* Recurses into a child node built from a weighted subset. */
+		void id3_recurse_child(
+			const DataSet& dataset,
+			const WeightedSubset subset,
+			Span<const Attribute::Index> attributes,
+			const Node* parent,
+			Node& node,
+			Arena& arena)
+		{
+			id3_recurse(dataset, subset, attributes, parent, node, arena);
+		}
+
+		/**
+		 * \brief Recurses into a child node built from a bitmap. Counting with bitmaps costs the same however few instances are in the subset,
+		 * so once the subset is sparse enough that iterating its instances is cheaper, it's switched to a list of instances.
+		 */
+		void id3_recurse_child(
+			const DataSet& dataset,
+			const BitmapSubset subset,
+			Span<const Attribute::Index> attributes,
+			const Node* parent,
+			Node& node,
+			Arena& arena)
+		{
+			// Bitmaps are used while at least one in this many instances is in the subset
+			constexpr std::size_t MIN_BITMAP_DENSITY = 32;
+
+			const auto numWords = subset.index->num_words();
+			const auto size = count(subset.bits, numWords);
+
+			if (size * MIN_BITMAP_DENSITY >= numWords * BitmapIndex::BITS_PER_WORD)
+			{
+				id3_recurse(dataset, subset, attributes, parent, node, arena);
+				return;
+			}
+
+			auto instances = static_cast<Instance*>(arena.allocate(sizeof(Instance) * size, alignof(Instance)));
+			std::size_t numInstances = 0;
+
+			for (std::size_t word = 0; word < numWords; ++word)
+			{
+				for (auto bits = subset.bits[word]; bits != 0; bits &= bits - 1)
+				{
+					// The index of the lowest set bit is the number of bits below it
+					const auto bit = popcount((bits & (0 - bits)) - 1);
+					new (instances + numInstances++) Instance(dataset.get_instance(word * BitmapIndex::BITS_PER_WORD + bit));
+				}
+			}
+
+			id3_recurse(dataset, Span<const Instance>{ instances, numInstances }, attributes, parent, node, arena);
+		}
+
 		/**
 		 * \brief Recursively builds the ID3 tree.
 		 * \param dataset The dataset to build it with.
+		 * \param subset The instances to build the node from, either a span of instances or a bitmap.
+		 * \param arena The arena to allocate child nodes and scratch space in.
 		 */
+		template <typename SubsetT>
 		void id3_recurse(
 			const DataSet& dataset,
-			std::vector<Instance> subset,
-			std::vector<Attribute::Index> attributes,
+			const SubsetT subset,
+			Span<const Attribute::Index> attributes,
 			const Node* parent,
-			Node& node)
+			Node& node,
+			Arena& arena)
 		{
+			ML_PROFILE_SCOPE(ID3Recurse);
+			ML_PROFILE_COUNT(NodesBuilt, 1);
+
 			// Get the current entropy of the node and most common class
+			auto classCounter = arena.create_array<std::size_t>(dataset.num_classes());
 			float entropy;
-			auto pred = [](auto) {return true; };
-			std::tie(entropy, node.class_index) = calculate_entropy(subset, dataset.num_classes(), pred);
+			std::tie(entropy, node.class_index) = calculate_entropy(subset, classCounter);
 
 			// If there is no entropy or no more attributes to select from
 			if (entropy == 0 || attributes.empty())
 			{
 				// In the case that there was zero entropy because no instance remain, we need to set the class index to the parent most common class
-				if (subset.empty())
+				if (std::accumulate(classCounter.begin(), classCounter.end(), std::size_t{ 0 }) == 0)
 				{
 					node.class_index = parent->class_index;
 				}
@@ -183,14 +521,23 @@ namespace ml
 			}
 
 			// There's still entropy and attributes to split by, so we need to recurse
-			auto bestAttribute = attributes.begin();
+			std::size_t maxDomainSize = 0;
+			for (auto attrib : attributes)
+			{
+				maxDomainSize = std::max(maxDomainSize, dataset.get_attribute(attrib).domain.size());
+			}
+
+			auto valueClassCounter = arena.create_array<std::size_t>(maxDomainSize * dataset.num_classes());
+			const auto candidates = candidate_attributes(subset, attributes, arena);
+			auto bestAttribute = candidates.begin();
 			float bestAttributeInformationGain = std::numeric_limits<float>::lowest();
 
-			for (auto iter = attributes.begin(); iter != attributes.end(); ++iter)
+			for (auto iter = candidates.begin(); iter != candidates.end(); ++iter)
 			{
 				// Calculate the information gain by splitting on this attribute
 				const auto informationGain = calculate_information_gain(
 					subset,
+					valueClassCounter,
 					dataset.num_classes(),
 					entropy,
 					*iter,
@@ -204,31 +551,28 @@ namespace ml
 				}
 			}
 
-			// Remove the attribute from the list of attributes
+			// Remove the attribute from the list of attributes (shared by all the children)
 			auto attrib = *bestAttribute;
-			attributes.erase(bestAttribute);
+			auto childAttributes = arena.create_array<Attribute::Index>(attributes.size() - 1);
+			std::remove_copy(attributes.begin(), attributes.end(), childAttributes.begin(), attrib);
 			node.split_attribute = attrib;
 
 			// Get the domain size of the attribute we chose
 			const auto attribSize = dataset.get_attribute(attrib).domain.size();
 
 			// Recurse by splittin on the best attribute
-			node.children.reserve(attribSize);
+			const auto childSubsets = split_subset(subset, attrib, attribSize, arena);
+			node.children = arena.create_array<Node>(attribSize);
 
-			for (auto& childSubset : split_subset(subset, attrib, attribSize))
+			for (std::size_t i = 0; i < attribSize; ++i)
 			{
-				// Create a child node
-				auto child = std::make_unique<Node>();
-				auto* pChild = child.get();
-				node.children.push_back(std::move(child));
-
-				// Recurse on it
-				id3_recurse(
+				id3_recurse_child(
 					dataset,
-					std::move(childSubset),
-					attributes,
+					childSubsets[i],
+					childAttributes,
 					&node,
-					std::ref(*pChild));
+					node.children[i],
+					arena);
 			}
 		}
 
@@ -249,7 +593,7 @@ namespace ml
 				return node.class_index;
 			}
 
-			return classify(*node.children[instance.get_attrib(node.split_attribute)], instance);
+			return classify(node.children[instance.get_attrib(node.split_attribute)], instance);
 		}
 
 		/**
@@ -260,7 +604,7 @@ namespace ml
 		 */
 		float prune_test(
 			const Node& root,
-			const std::vector<Instance>& pruneSet)
+			DataView pruneSet)
 		{
 			float result = 0.f;
 
@@ -284,7 +628,7 @@ namespace ml
 		void prune_recurse(
 			const Node& root,
 			Node& node,
-			const std::vector<Instance>& pruneSet)
+			DataView pruneSet)
 		{
 			if (node.is_leaf())
 			{
@@ -294,13 +638,13 @@ namespace ml
 			// Try to prune all this node's children
 			for (auto& child : node.children)
 			{
-				prune_recurse(root, *child, pruneSet);
+				prune_recurse(root, child, pruneSet);
 			}
 
 			// See if this node now contains any non-leaves
 			for (auto& child : node.children)
 			{
-				if (!child->is_leaf())
+				if (!child.is_leaf())
 				{
 					return;
 				}
@@ -310,62 +654,493 @@ namespace ml
 			float prePrune = prune_test(root, pruneSet);
 
 			// Back up the children
-			auto children = std::move(node.children);
+			const auto children = node.children;
+			node.children = {};
 
 			// If pruning this node does not reduce the accuracy
 			if (prePrune - prune_test(root, pruneSet) != 0.f)
 			{
 				// Restore the children
-				node.children = std::move(children);
+				node.children = children;
+			}
+		}
+
+		/**
+		 * \brief Classifies the given attribute values using the ID3 tree.
+		 * \param node The current root.
+		 * \param values The value index of each attribute.
+		 * \return The class index of the values.
+		 */
+		ClassIndex classify(
+			const Node& node,
+			const Attribute::ValueIndex* values)
+		{
+			const Node* current = &node;
+			while (!current->is_leaf())
+			{
+				current = &current->children[values[current->split_attribute]];
+			}
+
+			return current->class_index;
+		}
+
+		/* Returns a seed for random numbers that only depends on the instances in the training set, and their order. */
+		std::size_t training_set_seed(DataView trainingSet)
+		{
+			std::size_t seed = trainingSet.size();
+			for (auto instance : trainingSet)
+			{
+				seed = seed * 31 + instance.index();
 			}
+
+			return seed;
 		}
 
-		std::size_t algorithm(const DataSet& dataset, const std::vector<Instance>& trainingSet, const std::vector<Instance>& testSet)
+		/**
+		 * \brief Builds and prunes an ID3 tree.
+		 * \param dataset The dataset to build it with.
+		 * \param trainingSet The instances to build it from, 20% are set aside for pruning.
+		 * \param arena The arena to allocate the nodes and scratch space in, the tree lives as long as it does.
+		 * \return The root of the tree.
+		 */
+		Node* build_tree(const DataSet& dataset, DataView trainingSet, Arena& arena)
 		{
 			// Build up a list of attributes
-			std::vector<Attribute::Index> attributes;
-			attributes.assign(dataset.num_attributes(), 0);
+			auto attributes = arena.create_array<Attribute::Index>(dataset.num_attributes());
 			std::iota(attributes.begin(), attributes.end(), 0);
 
-			// Copy the training set and shuffle it, so we don't end up using the same values as pruning values repeatedly
-			auto trainingSetCopy = trainingSet;
-			std::random_shuffle(trainingSetCopy.begin(), trainingSetCopy.end());
+			// Shuffle the training set's indices, so we don't end up using the same values as pruning values repeatedly.
+			// The shuffle is seeded from the training set rather than using 'rand', so the tree is the same whichever thread builds it, in whatever order.
+			std::minstd_rand random{ static_cast<std::minstd_rand::result_type>(training_set_seed(trainingSet)) };
+			auto indices = arena.create_array<std::size_t>(trainingSet.size());
+			std::copy(trainingSet.indices().begin(), trainingSet.indices().end(), indices.begin());
+			std::shuffle(indices.begin(), indices.end(), random);
 
-			// 20% of the training set is set aside for pruning
-			const std::size_t pruneSize = trainingSetCopy.size() / 5;
-			std::vector<Instance> pruneSet;
-			pruneSet.reserve(pruneSize);
+			// The last 20% of the shuffled training set is set aside for pruning
+			const DataView shuffled{ dataset, indices };
+			const std::size_t pruneSize = shuffled.size() / 5;
+			const auto growSet = shuffled.slice(0, shuffled.size() - pruneSize);
+			const auto pruneSet = shuffled.slice(shuffled.size() - pruneSize, pruneSize);
 
-			while (pruneSet.size() < pruneSize)
+			// Build the tree, counting with the dataset's bitmaps if it has them
+			auto* root = arena.create<Node>();
+			if (const auto* index = dataset.bitmap_index())
 			{
-				pruneSet.push_back(trainingSetCopy.back());
-				trainingSetCopy.erase(trainingSetCopy.end() - 1);
+				auto* bits = static_cast<BitmapIndex::Word*>(arena.allocate(sizeof(BitmapIndex::Word) * index->num_words(), alignof(BitmapIndex::Word)));
+				index->make_subset(growSet.indices(), bits);
+				id3_recurse(dataset, BitmapSubset{ index, bits }, attributes, nullptr, *root, arena);
+			}
+			else
+			{
+				id3_recurse(dataset, growSet, attributes, nullptr, *root, arena);
 			}
-
-			// Build the tree
-			auto root = std::make_unique<Node>();
-			id3_recurse(dataset, trainingSetCopy, std::move(attributes), nullptr, *root);
 
 			// Prune the training set
-			prune_recurse(*root, *root, pruneSet);
+			{
+				ML_PROFILE_SCOPE(Prune);
+				prune_recurse(*root, *root, pruneSet);
+			}
+
+			return root;
+		}
+
+		/* An ID3 tree, along with the arena that owns its nodes. */
+		class TreeModel final : public Model
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			TreeModel(const DataSet& dataset, DataView trainingSet)
+				: _arena(new Arena()),
+				_num_attributes(dataset.num_attributes())
+			{
+				_root = build_tree(dataset, trainingSet, *_arena);
+			}
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			using Model::classify;
+
+			std::size_t num_attributes() const override
+			{
+				return _num_attributes;
+			}
+
+			ClassIndex classify(const Attribute::ValueIndex* values) const override
+			{
+				return id3_rep::classify(*_root, values);
+			}
+
+			/* Returns the root of the tree. */
+			const Node& root() const
+			{
+				return *_root;
+			}
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			std::unique_ptr<Arena> _arena;
+			const Node* _root;
+			std::size_t _num_attributes;
+		};
+
+		std::unique_ptr<Model> train(const DataSet& dataset, DataView trainingSet)
+		{
+			return std::make_unique<TreeModel>(dataset, trainingSet);
+		}
+
+		/**
+		 * \brief Grows an unpruned ID3 tree from a bootstrap sample of the training set, each node splitting on the best of a random subset of the attributes.
+		 * \param dataset The dataset to build it with.
+		 * \param trainingSet The set to draw the bootstrap sample from.
+		 * \param numCandidates The number of attributes each node picks from.
+		 * \param seed The seed for drawing the sample and attributes.
+		 * \param arena The arena to allocate the nodes and scratch space in, the tree lives as long as it does.
+		 * \return The root of the tree.
+		 */
+		Node* build_bagged_tree(
+			const DataSet& dataset,
+			DataView trainingSet,
+			const std::size_t numCandidates,
+			const std::size_t seed,
+			Arena& arena)
+		{
+			// There's nothing to sample from an empty training set, so the tree is a single leaf
+			if (trainingSet.empty())
+			{
+				return arena.create<Node>();
+			}
+
+			std::minstd_rand random{ static_cast<std::minstd_rand::result_type>(seed) };
+
+			auto attributes = arena.create_array<Attribute::Index>(dataset.num_attributes());
+			std::iota(attributes.begin(), attributes.end(), 0);
+
+			// Draw the sample with replacement, counting how many times each instance was drawn rather than copying them
+			std::vector<std::uint32_t> draws(dataset.num_instances(), 0);
+			std::uniform_int_distribution<std::size_t> pick{ 0, trainingSet.size() - 1 };
+			for (std::size_t i = 0; i < trainingSet.size(); ++i)
+			{
+				draws[trainingSet[pick(random)].index()] += 1;
+			}
+
+			const auto numDistinct = static_cast<std::size_t>(dataset.num_instances() - std::count(draws.begin(), draws.end(), 0u));
+			auto indices = arena.create_array<std::uint32_t>(numDistinct);
+			auto weights = arena.create_array<std::uint32_t>(numDistinct);
+
+			std::size_t numInstances = 0;
+			for (std::size_t index = 0; index < draws.size(); ++index)
+			{
+				if (draws[index] != 0)
+				{
+					indices[numInstances] = static_cast<std::uint32_t>(index);
+					weights[numInstances] = draws[index];
+					numInstances += 1;
+				}
+			}
+
+			auto* root = arena.create<Node>();
+			id3_recurse(dataset, WeightedSubset{ &dataset, indices, weights, numCandidates, &random }, attributes, nullptr, *root, arena);
+
+			return root;
+		}
+
+		/* An ensemble of ID3 trees, which classifies by majority vote. */
+		class ForestModel final : public Model
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			ForestModel(const DataSet& dataset, DataView trainingSet, const ForestOptions& options)
+				: _num_attributes(dataset.num_attributes()),
+				_num_classes(dataset.num_classes())
+			{
+				const auto numTrees = std::max<std::size_t>(options.num_trees, 1);
+				auto numCandidates = options.num_candidates;
+				if (numCandidates == 0)
+				{
+					numCandidates = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(_num_attributes))));
+				}
+
+				_arenas.resize(numTrees);
+				_trees.resize(numTrees);
+
+				// Each tree is seeded from the training set and its index, so the forest is the same however many threads build it
+				const auto seed = training_set_seed(trainingSet);
+
+				const auto buildTree = [&, numCandidates](std::size_t tree)
+				{
+					_arenas[tree] = std::make_unique<Arena>();
+					_trees[tree] = build_bagged_tree(dataset, trainingSet, numCandidates, seed * 31 + tree + 1, *_arenas[tree]);
+				};
+
+				const auto numThreads = std::min(options.num_threads == 0 ? std::max<std::size_t>(std::thread::hardware_concurrency(), 1) : options.num_threads, numTrees);
+				if (numThreads == 1)
+				{
+					// Don't bother with a pool, this is usually a fold that's already running on one
+					for (std::size_t tree = 0; tree < numTrees; ++tree)
+					{
+						buildTree(tree);
+					}
+					return;
+				}
+
+				ThreadPool pool{ numThreads };
+				for (std::size_t tree = 0; tree < numTrees; ++tree)
+				{
+					pool.submit([&buildTree, tree]() { buildTree(tree); });
+				}
+
+				pool.wait();
+			}
+
+			///////////////////
+			///   Methods   ///
+		public:
+
+			using Model::classify;
+
+			std::size_t num_attributes() const override
+			{
+				return _num_attributes;
+			}
+
+			ClassIndex classify(const Attribute::ValueIndex* values) const override
+			{
+				ClassIndex result;
+				classify_batch(values, 1, &result);
+				return result;
+			}
+
+			void classify_batch(const Attribute::ValueIndex* values, std::size_t count, ClassIndex* out) const override
+			{
+				ML_PROFILE_SCOPE(Classify);
+
+				// Walk one tree at a time over the whole batch, so each tree's nodes stay in cache
+				std::vector<std::size_t> votes(count * _num_classes, 0);
+				for (const auto* tree : _trees)
+				{
+					for (std::size_t query = 0; query < count; ++query)
+					{
+						votes[query * _num_classes + id3_rep::classify(*tree, values + query * _num_attributes)] += 1;
+					}
+				}
+
+				// Ties go to the lowest class index
+				for (std::size_t query = 0; query < count; ++query)
+				{
+					const auto begin = votes.begin() + query * _num_classes;
+					out[query] = static_cast<ClassIndex>(std::max_element(begin, begin + _num_classes) - begin);
+				}
+			}
+
+			//////////////////
+			///   Fields   ///
+		private:
+
+			std::vector<std::unique_ptr<Arena>> _arenas;
+			std::vector<const Node*> _trees;
+			std::size_t _num_attributes;
+			std::size_t _num_classes;
+		};
+
+		std::unique_ptr<Model> train_forest(const DataSet& dataset, DataView trainingSet, const ForestOptions& options)
+		{
+			return std::make_unique<ForestModel>(dataset, trainingSet, options);
+		}
+
+		/* Writes the given string as a C++ string literal. */
+		void write_cpp_string(const std::string& value, std::ostream& out)
+		{
+			out << '"';
+			for (auto c : value)
+			{
+				if (c == '"' || c == '\\')
+				{
+					out << '\\';
+				}
+				out << c;
+			}
+			out << '"';
+		}
+
+		/**
+		 * \brief Recursively writes the C++ code for classifying with the given node, as a nested switch.
+		 * \param dataset The dataset the tree was built with.
+		 * \param node The node to write the code for.
+		 * \param depth The level of indentation to write the code at.
+		 * \param out The stream to write the code to.
+		 */
+		void write_cpp_node(
+			const DataSet& dataset,
+			const Node& node,
+			const std::size_t depth,
+			std::ostream& out)
+		{
+			const std::string indent(depth, '\t');
+
+			if (node.is_leaf())
+			{
+				out << indent << "return " << node.class_index << "; // " << dataset.class_name(node.class_index) << '\n';
+				return;
+			}
+
+			const auto& attrib = dataset.get_attribute(node.split_attribute);
+
+			// Leaves of the most common leaf class are folded into the default case, the rest are grouped by class
+			std::vector<std::size_t> leafCounts(dataset.num_classes(), 0);
+			for (const auto& child : node.children)
+			{
+				if (child.is_leaf())
+				{
+					leafCounts[child.class_index] += 1;
+				}
+			}
+
+			auto defaultClass = node.class_index;
+			const auto mostCommonLeaf = std::max_element(leafCounts.begin(), leafCounts.end());
+			if (*mostCommonLeaf != 0)
+			{
+				defaultClass = mostCommonLeaf - leafCounts.begin();
+			}
+
+			out << indent << "switch (values[" << node.split_attribute << "]) // " << attrib.name << '\n';
+			out << indent << "{\n";
+
+			for (ClassIndex classIndex = 0; classIndex < dataset.num_classes(); ++classIndex)
+			{
+				if (classIndex == defaultClass || leafCounts[classIndex] == 0)
+				{
+					continue;
+				}
+
+				for (Attribute::ValueIndex value = 0; value < node.children.size(); ++value)
+				{
+					if (node.children[value].is_leaf() && node.children[value].class_index == classIndex)
+					{
+						out << indent << "case " << value << ": // " << attrib.value_name(value) << '\n';
+					}
+				}
+
+				out << indent << "\treturn " << classIndex << "; // " << dataset.class_name(classIndex) << '\n';
+			}
+
+			for (Attribute::ValueIndex value = 0; value < node.children.size(); ++value)
+			{
+				if (node.children[value].is_leaf())
+				{
+					continue;
+				}
+
+				out << indent << "case " << value << ": // " << attrib.value_name(value) << '\n';
+				out << indent << "{\n";
+				write_cpp_node(dataset, node.children[value], depth + 1, out);
+				out << indent << "}\n";
+			}
+
+			out << indent << "default:\n";
+			out << indent << "\treturn " << defaultClass << "; // " << dataset.class_name(defaultClass) << '\n';
+			out << indent << "}\n";
+		}
+
+		bool export_cpp(const Model& model, const DataSet& dataset, const std::string& name, std::ostream& out)
+		{
+			const auto* tree = dynamic_cast<const TreeModel*>(&model);
+			if (!tree)
+			{
+				return false;
+			}
+
+			out << "// " << name << ".h - Generated from an ID3 tree, do not edit\n";
+			out << "#pragma once\n\n";
+			out << "#include <cstddef>\n\n";
+			out << "namespace " << name << "\n{\n";
+
+			out << "\t/* The number of attribute values 'classify' expects. */\n";
+			out << "\tconstexpr std::size_t NUM_ATTRIBUTES = " << dataset.num_attributes() << ";\n\n";
+
+			out << "\t/* The names of the classes returned by 'classify'. */\n";
+			out << "\tconstexpr const char* CLASS_NAMES[] = { ";
+			for (ClassIndex i = 0; i < dataset.num_classes(); ++i)
+			{
+				if (i != 0)
+				{
+					out << ", ";
+				}
+				write_cpp_string(dataset.class_name(i), out);
+			}
+			out << " };\n\n";
+
+			out << "\t/* Classifies an instance, given as the value index of each of its attributes. */\n";
+			out << "\tinline std::size_t classify(const std::size_t* values)\n\t{\n";
+			write_cpp_node(dataset, tree->root(), 2, out);
+			out << "\t}\n}\n";
+
+			return static_cast<bool>(out);
+		}
+
+		std::size_t algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result)
+		{
+			// All nodes and scratch space for this training run are allocated here, and freed together at the end
+			Arena arena;
+			const auto* root = build_tree(dataset, trainingSet, arena);
 
 			// Classify each value
 			std::size_t numCorrect = 0;
 			for (auto instance : testSet)
 			{
+				ML_PROFILE_SCOPE(Classify);
 				auto classIndex = classify(*root, instance);
 				if (classIndex == instance.get_class())
 				{
 					numCorrect += 1;
 				}
 
-				std::cout << "    Classified '";
-				instance.print();
-				std::cout << "' as '" << dataset.class_name(classIndex);
-				std::cout << "', actual class: '" << dataset.class_name(instance.get_class()) << "'" << std::endl;
+				result.record(instance, classIndex);
+			}
+
+			return numCorrect;
+		}
+
+		std::size_t forest_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result)
+		{
+			// Folds are already run in parallel, so each grows its trees on a single thread
+			ForestOptions options;
+			options.num_threads = 1;
+			const auto model = train_forest(dataset, trainingSet, options);
+
+			// Classify the whole test set as a single batch
+			const auto numAttributes = dataset.num_attributes();
+			std::vector<Attribute::ValueIndex> values;
+			values.reserve(testSet.size() * numAttributes);
+			for (auto instance : testSet)
+			{
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					values.push_back(instance.get_attrib(attribIndex));
+				}
+			}
+
+			std::vector<ClassIndex> classes(testSet.size());
+			model->classify_batch(values.data(), testSet.size(), classes.data());
+
+			std::size_t numCorrect = 0;
+			for (std::size_t i = 0; i < testSet.size(); ++i)
+			{
+				if (classes[i] == testSet[i].get_class())
+				{
+					numCorrect += 1;
+				}
+
+				result.record(testSet[i], classes[i]);
 			}
 
-			std::cout << "Accuracy: " << static_cast<float>(numCorrect * 100) / testSet.size() << "%" << std::endl;
 			return numCorrect;
 		}
 	}
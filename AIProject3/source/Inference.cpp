@@ -0,0 +1,163 @@
+// Inference.cpp - Will Cassella
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include "../include/Inference.h"
+#include "../include/ID3.h"
+
+namespace ml
+{
+	bool parse_model_kind(const std::string& name, ModelKind& out)
+	{
+		if (name == "knn")
+		{
+			out = ModelKind::NearestNeighbor;
+		}
+		else if (name == "cnn")
+		{
+			out = ModelKind::CondensedNearestNeighbor;
+		}
+		else if (name == "sfs")
+		{
+			out = ModelKind::ForwardSelectedNearestNeighbor;
+		}
+		else if (name == "sbs")
+		{
+			out = ModelKind::BackwardSelectedNearestNeighbor;
+		}
+		else if (name == "sharded")
+		{
+			out = ModelKind::ShardedNearestNeighbor;
+		}
+		else if (name == "id3")
+		{
+			out = ModelKind::ID3;
+		}
+		else if (name == "forest")
+		{
+			out = ModelKind::Forest;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	ModelHandle train_model(const DataSet& dataset, DataView trainingSet, const TrainOptions& options)
+	{
+		switch (options.kind)
+		{
+		case ModelKind::CondensedNearestNeighbor:
+		{
+			k_nearest_neighbor::CondenseOptions condenseOptions;
+			condenseOptions.num_threads = options.num_threads;
+			return k_nearest_neighbor::train_condensed(dataset, trainingSet, condenseOptions);
+		}
+
+		case ModelKind::ForwardSelectedNearestNeighbor:
+		case ModelKind::BackwardSelectedNearestNeighbor:
+		{
+			k_nearest_neighbor::SelectionOptions selectionOptions;
+			selectionOptions.direction = options.kind == ModelKind::ForwardSelectedNearestNeighbor
+				? k_nearest_neighbor::SelectionOptions::Direction::Forward
+				: k_nearest_neighbor::SelectionOptions::Direction::Backward;
+			selectionOptions.k = options.k;
+			selectionOptions.num_threads = options.num_threads;
+			return k_nearest_neighbor::train_selected(dataset, trainingSet, selectionOptions);
+		}
+
+		case ModelKind::ShardedNearestNeighbor:
+			return k_nearest_neighbor::train_sharded(dataset, trainingSet, options.k, options.num_threads);
+
+		case ModelKind::ID3:
+			return id3_rep::train(dataset, trainingSet);
+
+		case ModelKind::Forest:
+		{
+			id3_rep::ForestOptions forestOptions;
+			forestOptions.num_threads = options.num_threads;
+			return id3_rep::train_forest(dataset, trainingSet, forestOptions);
+		}
+
+		case ModelKind::NearestNeighbor:
+		default:
+			return k_nearest_neighbor::train(dataset, trainingSet, options.k);
+		}
+	}
+
+	namespace
+	{
+		/* Returns whether the whole value is a finite number, other than surrounding whitespace. */
+		bool is_number(const std::string& value)
+		{
+			const char* begin = value.c_str();
+			char* end = nullptr;
+			const float number = std::strtof(begin, &end);
+			if (end == begin || !std::isfinite(number))
+			{
+				return false;
+			}
+
+			while (std::isspace(static_cast<unsigned char>(*end)))
+			{
+				++end;
+			}
+
+			return *end == '\0';
+		}
+	}
+
+	bool parse_instance(const DataSet& schema, const std::string& line, std::vector<Attribute::ValueIndex>& values, std::string& error)
+	{
+		values.clear();
+		values.reserve(schema.num_attributes());
+
+		std::stringstream lineStream{ line };
+		std::string value;
+
+		while (std::getline(lineStream, value, ','))
+		{
+			if (values.size() == schema.num_attributes())
+			{
+				error = "too many values, expected " + std::to_string(schema.num_attributes());
+				return false;
+			}
+
+			const auto& attrib = schema.get_attribute(values.size());
+
+			// Ignored attributes take anything
+			if (attrib.domain.empty())
+			{
+				values.push_back(0);
+				continue;
+			}
+
+			// 'value_index' would pick a value at random for an unknown, so the same query could get different answers
+			if (value == "?")
+			{
+				error = "missing value for attribute '" + attrib.name + "', every value must be known";
+				return false;
+			}
+
+			if (attrib.is_discretized() ? !is_number(value) : !attrib.has_value(value))
+			{
+				error = "unknown value '" + value + "' for attribute '" + attrib.name + "'";
+				return false;
+			}
+
+			values.push_back(attrib.value_index(value));
+		}
+
+		if (values.size() != schema.num_attributes())
+		{
+			error = "expected " + std::to_string(schema.num_attributes()) + " values, got " + std::to_string(values.size());
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -1,10 +1,17 @@
 // KNearestNeighbor.cpp - Will Cassella
 
-#include <map>
+#include <cmath>
 #include <future>
-#include <iostream>
 #include "../include/KNearestNeighbor.h"
 #include "../include/DataSet.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+#include "../include/Arena.h"
+#include "../include/Neighbors.h"
+#include "../include/BitmapIndex.h"
+#include "../include/Model.h"
+#include "../include/DataSets.h"
+#include "../include/KNearestNeighborKernel.h"
 
 namespace ml
 {
@@ -14,7 +21,7 @@ namespace ml
 
 		/* Produces an array that contains the conditional probability for all values of the specified attribute across all classes. */
 		AttributeCPCache attribute_conditional_probability(
-			const std::vector<Instance>& trainingSet,
+			DataView trainingSet,
 			const Attribute::Index attribIndex,
 			const std::size_t attribDomainSize,
 			const std::size_t numClasses)
@@ -65,32 +72,33 @@ namespace ml
 			return result;
 		}
 
-		using AttributeVDM = std::vector<float>;
-
-		/* Computes the VDM for the value of the given attribute against all instance in the test set. */
-		AttributeVDM attribute_value_difference_metric(
-			const std::vector<Instance>& trainingSet,
-			const AttributeCPCache& cpCache,
+		/* Produces the same conditional probabilities, by counting the intersections of the training set's bitmap with the dataset's bitmaps. */
+		AttributeCPCache attribute_conditional_probability(
+			const BitmapIndex& index,
+			const BitmapIndex::Word* trainingBits,
 			const Attribute::Index attribIndex,
-			const std::size_t numClasses,
-			const Attribute::ValueIndex attribValue,
-			const int q)
+			const std::size_t attribDomainSize,
+			const std::size_t numClasses)
 		{
-			AttributeVDM result;
-			result.assign(trainingSet.size(), 0.f);
+			AttributeCPCache result;
+			result.assign(attribDomainSize * numClasses, 0.f);
 
-			for (std::size_t i = 0; i < trainingSet.size(); ++i)
+			for (std::size_t valueIndex = 0; valueIndex < attribDomainSize; ++valueIndex)
 			{
-				const auto trainingValueIndex = trainingSet[i].get_attrib(attribIndex);
+				const auto* valueBits = index.value_bitmap(attribIndex, valueIndex);
+				const auto count = count_and(trainingBits, valueBits, index.num_words());
 
-				// Sum up the conditional probability differences for the attribute and the training value
-				for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+				// First check to make sure we actually found instances of this value
+				if (count == 0)
 				{
-					result[i] += std::abs(cpCache[attribValue * numClasses + classIndex] - cpCache[trainingValueIndex * numClasses + classIndex]);
+					continue;
 				}
 
-				// Set it to the power of 'q'
-				result[i] = std::pow(result[i], q);
+				for (std::size_t classIndex = 0; classIndex < numClasses; ++classIndex)
+				{
+					const auto classCount = count_and(trainingBits, valueBits, index.class_bitmap(classIndex), index.num_words());
+					result[valueIndex * numClasses + classIndex] = static_cast<float>(classCount) / count;
+				}
 			}
 
 			return result;
@@ -104,8 +112,9 @@ namespace ml
 
 			void init(
 				const DataSet& dataset,
-				const std::vector<Instance>& trainingSet)
+				DataView trainingSet)
 			{
+				ML_PROFILE_SCOPE(CPCacheBuild);
 				const auto numAttributes = dataset.num_attributes();
 				_attribute_conditional_probabilities.reserve(numAttributes);
 
@@ -113,16 +122,30 @@ namespace ml
 				std::vector<std::future<AttributeCPCache>> results;
 				results.reserve(numAttributes);
 
+				// Count with the dataset's bitmaps if it has them
+				const auto* index = dataset.bitmap_index();
+				std::vector<BitmapIndex::Word> trainingBits;
+				if (index)
+				{
+					trainingBits.resize(index->num_words());
+					index->make_subset(trainingSet.indices(), trainingBits.data());
+				}
+
 				// Queue up all the attributes
 				for (Attribute::Index i = 0; i < numAttributes; ++i)
 				{
-					results.push_back(std::async(
-						std::launch::async,
-						attribute_conditional_probability,
-						trainingSet,
-						i,
-						dataset.get_attribute(i).domain.size(),
-						dataset.num_classes()));
+					const auto domainSize = dataset.get_attribute(i).domain.size();
+					const auto numClasses = dataset.num_classes();
+
+					results.push_back(std::async(std::launch::async, [&, i, domainSize, numClasses]()
+					{
+						if (index)
+						{
+							return attribute_conditional_probability(*index, trainingBits.data(), i, domainSize, numClasses);
+						}
+
+						return attribute_conditional_probability(trainingSet, i, domainSize, numClasses);
+					}));
 				}
 
 				// Retreive the results
@@ -132,175 +155,434 @@ namespace ml
 				}
 			}
 
+			/* Returns the conditional probability cache for the indexed attribute. */
+			const AttributeCPCache& conditional_probabilities(Attribute::Index attribIndex) const
+			{
+				return _attribute_conditional_probabilities[attribIndex];
+			}
+
+			/**
+			 * \brief Classifies the given instance against the training set this cache was initialized with.
+			 * The distance to each training instance is computed in full (every attribute) in a single pass over the training set.
+			 * \param scratch Arena for per-query scratch memory, this is reset by each call.
+			 */
 			ClassIndex classify(
 				const DataSet& dataset,
-				const std::vector<Instance>& trainingSet,
+				DataView trainingSet,
 				const Instance instance,
-				const unsigned int k) const
+				const unsigned int k,
+				Arena& scratch) const
 			{
-				// Calculate the VDM for each attribute against each instance in the training set
+				ML_PROFILE_SCOPE(Classify);
+				ML_PROFILE_COUNT(DistanceEvaluations, trainingSet.size());
+				scratch.reset();
+
 				const auto numAttributes = dataset.num_attributes();
-				std::vector<std::future<AttributeVDM>> attributeDifferences;
-				attributeDifferences.reserve(numAttributes);
+				const auto numClasses = dataset.num_classes();
+				const int q = 1;
 
-				// Queue up all the attributes
-				for (std::size_t i = 0; i < numAttributes; ++i)
+				// The conditional probabilities of the query's value of each attribute
+				auto queryProbabilities = scratch.create_array<const float*>(numAttributes);
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
 				{
-					attributeDifferences.push_back(std::async(
-						std::launch::async,
-						attribute_value_difference_metric,
-						trainingSet,
-						_attribute_conditional_probabilities[i],
-						i,
-						dataset.num_classes(),
-						instance.get_attrib(i),
-						1));
+					queryProbabilities[attribIndex] = &_attribute_conditional_probabilities[attribIndex][instance.get_attrib(attribIndex) * numClasses];
 				}
 
-				// Build a vector to hold the results
-				std::vector<AttributeVDM> results;
-				results.reserve(numAttributes);
+				auto distances = scratch.create_array<float>(trainingSet.size());
 
-				for (auto& vdm : attributeDifferences)
+				// For each element of the training set
+				for (std::size_t i = 0; i < trainingSet.size(); ++i)
 				{
-					results.push_back(vdm.get());
+					const auto trainingInstance = trainingSet[i];
+					float distance = 0;
+
+					// For each attribute
+					for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+					{
+						const auto* trainingProbabilities = &_attribute_conditional_probabilities[attribIndex][trainingInstance.get_attrib(attribIndex) * numClasses];
+
+						// Sum up the conditional probability differences for the attribute and the training value, to the power of 'q'
+						float difference = 0;
+						for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+						{
+							difference += std::abs(queryProbabilities[attribIndex][classIndex] - trainingProbabilities[classIndex]);
+						}
+						difference = std::pow(difference, q);
+
+						// Add the attribute's difference metric and square it (distance function)
+						distance += std::pow(difference, 2);
+					}
+
+					// Take the square root to get the distance
+					distances[i] = std::sqrt(distance);
+				}
+
+				// Find the nearest neighbors, and vote on them
+				ML_PROFILE_SCOPE(TopK);
+				auto nearestNeighbors = scratch.create_array<Neighbor>(k);
+				std::size_t numNeighbors = 0;
+
+				for (std::size_t i = 0; i < trainingSet.size(); ++i)
+				{
+					// Add the training set instance to the nearest neighbor vector if it's closer than any of the current ones
+					insert_if_closer(nearestNeighbors, numNeighbors, std::make_pair(distances[i], trainingSet[i].get_class()));
 				}
 
 				// Find the common class among k nearest neighbors
-				return classify_impl(trainingSet, results, k);
+				return most_common_class(Span<const Neighbor>{ nearestNeighbors.data(), numNeighbors }, scratch.create_array<std::size_t>(numClasses));
 			}
 
+			//////////////////
+			///   Fields   ///
 		private:
 
-			using Neighbor = std::pair<float, ClassIndex>;
+			std::vector<AttributeCPCache> _attribute_conditional_probabilities;
+		};
+
+		/* The number of training rows a batch is compared against at a time, before the nearest of them are picked for each query. */
+		constexpr std::size_t ROWS_PER_TILE = 256;
+
+		/**
+		 * \brief A trained K nearest neighbor model. It keeps a copy of the training set's values, and the value difference
+		 * between every pair of values of each attribute, so distances are just table lookups.
+		 */
+		class VDMModel final : public Model
+		{
+			////////////////////////
+			///   Constructors   ///
+		public:
+
+			VDMModel(const DataSet& dataset, DataView trainingSet, unsigned int k, int q)
+				: VDMModel(dataset, trainingSet, trainingSet, all_attributes(dataset), k, q)
+			{
+			}
 
-			static ClassIndex classify_impl(
-				const std::vector<Instance>& trainingSet,
-				const std::vector<AttributeVDM>& attributeDifferences,
-				const unsigned int k)
+			/**
+			 * \brief Creates a model that keeps only the given prototypes, and only compares instances by the given attributes.
+			 * The value difference metric is still taken over the whole training set.
+			 */
+			VDMModel(const DataSet& dataset, DataView trainingSet, DataView prototypes, std::vector<Attribute::Index> attributes, unsigned int k, int q)
+				: _num_attributes(dataset.num_attributes()),
+				_num_classes(dataset.num_classes()),
+				_k(k),
+				_used_attributes(std::move(attributes))
 			{
-				std::vector<Neighbor> nearestNeighbors;
-				nearestNeighbors.reserve(k);
+				VDMCache cache;
+				cache.init(dataset, trainingSet);
 
-				// For each element of the training set
-				for (std::size_t i = 0; i < trainingSet.size(); ++i)
+				// Compute the differences between every pair of values of each attribute used
+				_attributes.resize(_used_attributes.size());
+				for (std::size_t i = 0; i < _used_attributes.size(); ++i)
 				{
-					float distance = 0;
-
-					// For each attribute
-					for (Attribute::Index attribIndex = 0; attribIndex < attributeDifferences.size(); ++attribIndex)
+					const auto attribIndex = _used_attributes[i];
+					const auto& cpCache = cache.conditional_probabilities(attribIndex);
+					const auto domainSize = dataset.get_attribute(attribIndex).domain.size();
+					auto& attrib = _attributes[i];
+					attrib.domain_size = domainSize;
+					attrib.value_differences.assign(domainSize * domainSize, 0.f);
+
+					for (Attribute::ValueIndex x = 0; x < domainSize; ++x)
 					{
-						// Add the attribute's difference metric and square it (distance function)
-						distance += std::pow(attributeDifferences[attribIndex][i], 2);
+						for (Attribute::ValueIndex y = 0; y < domainSize; ++y)
+						{
+							float difference = 0;
+							for (ClassIndex classIndex = 0; classIndex < _num_classes; ++classIndex)
+							{
+								difference += std::abs(cpCache[x * _num_classes + classIndex] - cpCache[y * _num_classes + classIndex]);
+							}
+
+							attrib.value_differences[x * domainSize + y] = std::pow(difference, q);
+						}
 					}
+				}
 
-					// Take the square root to get the distance
-					distance = std::sqrt(distance);
+				// Copy the values of the attributes used of the prototypes
+				_values.reserve(prototypes.size() * _used_attributes.size());
+				_classes.reserve(prototypes.size());
+				for (auto instance : prototypes)
+				{
+					for (auto attribIndex : _used_attributes)
+					{
+						_values.push_back(instance.get_attrib(attribIndex));
+					}
 
-					// Add the current training set instance to the nearest neighbor vector if it's closer than any of the current ones
-					insert_if_closer(nearestNeighbors, std::make_pair(distance, trainingSet[i].get_class()), k);
+					_classes.push_back(instance.get_class());
 				}
-
-				return most_common_class(nearestNeighbors);
 			}
 
-			static void insert_if_closer(
-				std::vector<Neighbor>& nearestNeighbors,
-				const Neighbor candidate,
-				const unsigned int k)
+			///////////////////
+			///   Methods   ///
+		public:
+
+			using Model::classify;
+
+			/* Returns the index of every attribute of the dataset. */
+			static std::vector<Attribute::Index> all_attributes(const DataSet& dataset)
 			{
-				// If we don't already have k neighbors
-				if (nearestNeighbors.size() < k)
+				std::vector<Attribute::Index> result(dataset.num_attributes());
+				for (Attribute::Index attribIndex = 0; attribIndex < result.size(); ++attribIndex)
 				{
-					// Just add it
-					nearestNeighbors.push_back(candidate);
-					return;
+					result[attribIndex] = attribIndex;
 				}
 
-				// Find the nearest neighbor that this one is closer than
-				auto beaten = nearestNeighbors.end();
-				for (auto iter = nearestNeighbors.begin(); iter < nearestNeighbors.end(); ++iter)
+				return result;
+			}
+
+			std::size_t num_attributes() const override
+			{
+				return _num_attributes;
+			}
+
+			ClassIndex classify(const Attribute::ValueIndex* values) const override
+			{
+				ClassIndex result;
+				classify_batch(values, 1, &result);
+				return result;
+			}
+
+			void classify_batch(const Attribute::ValueIndex* values, std::size_t count, ClassIndex* out) const override
+			{
+				ML_PROFILE_SCOPE(Classify);
+				ML_PROFILE_COUNT(DistanceEvaluations, count * _classes.size());
+
+				std::vector<Neighbor> nearestNeighbors(count * _k);
+				std::vector<std::size_t> numNeighbors(count, 0);
+
+				// Walk the training set once for the whole batch rather than once per query, a tile of rows at a time so the distances stay in cache
+				const auto numRows = _classes.size();
+				const auto numUsed = _used_attributes.size();
+				std::vector<float> distances(count * std::min(ROWS_PER_TILE, numRows));
+				for (std::size_t tileStart = 0; tileStart < numRows; tileStart += ROWS_PER_TILE)
 				{
-					// Don't bother if this one is further
-					if (candidate.first > iter->first)
+					const auto tileSize = std::min(ROWS_PER_TILE, numRows - tileStart);
+					for (std::size_t tileRow = 0; tileRow < tileSize; ++tileRow)
 					{
-						continue;
+						const auto* rowValues = &_values[(tileStart + tileRow) * numUsed];
+
+						for (std::size_t query = 0; query < count; ++query)
+						{
+							const auto* queryValues = values + query * _num_attributes;
+							float distance = 0;
+
+							for (std::size_t i = 0; i < numUsed; ++i)
+							{
+								const auto& attrib = _attributes[i];
+								distance += std::pow(attrib.value_differences[queryValues[_used_attributes[i]] * attrib.domain_size + rowValues[i]], 2);
+							}
+
+							distances[query * tileSize + tileRow] = std::sqrt(distance);
+						}
 					}
 
-					// If we haven't beaten one yet, or the one we've beaten is closer than this one (want to push out the furthest ones)
-					if (beaten == nearestNeighbors.end() || beaten->first < iter->first)
+					// Rows are taken in order for each query, so ties go the same way as comparing them one at a time
+					ML_PROFILE_SCOPE(TopK);
+					for (std::size_t query = 0; query < count; ++query)
 					{
-						beaten = iter;
+						for (std::size_t tileRow = 0; tileRow < tileSize; ++tileRow)
+						{
+							insert_if_closer(
+								Span<Neighbor>{ &nearestNeighbors[query * _k], _k },
+								numNeighbors[query],
+								std::make_pair(distances[query * tileSize + tileRow], _classes[tileStart + tileRow]));
+						}
 					}
 				}
 
-				// If the candidate beat one of the current nearest neighbors
-				if (beaten != nearestNeighbors.end())
+				// Vote on each query
+				ML_PROFILE_SCOPE(TopK);
+				std::vector<std::size_t> classCounts(_num_classes);
+				for (std::size_t query = 0; query < count; ++query)
 				{
-					*beaten = candidate;
+					out[query] = most_common_class(Span<const Neighbor>{ &nearestNeighbors[query * _k], numNeighbors[query] }, Span<std::size_t>{ classCounts });
 				}
 			}
 
-			static ClassIndex most_common_class(
-				const std::vector<Neighbor>& nearestNeighbors)
+			//////////////////
+			///   Fields   ///
+		private:
+
+			struct AttributeTable
+			{
+				std::size_t domain_size = 0;
+
+				/* The value difference metric between values 'x' and 'y', at 'x * domain_size + y'. */
+				std::vector<float> value_differences;
+			};
+
+			std::size_t _num_attributes;
+			std::size_t _num_classes;
+			unsigned int _k;
+
+			/* The attributes instances are compared by, and the value differences of each. */
+			std::vector<Attribute::Index> _used_attributes;
+			std::vector<AttributeTable> _attributes;
+
+			/* The prototypes, the values of the attributes used of row 'i' start at 'i * _used_attributes.size()'. */
+			std::vector<Attribute::ValueIndex> _values;
+			std::vector<ClassIndex> _classes;
+		};
+
+		std::unique_ptr<Model> train(const DataSet& dataset, DataView trainingSet, unsigned int k)
+		{
+			return std::make_unique<VDMModel>(dataset, trainingSet, k, 1);
+		}
+
+		std::unique_ptr<Model> train_condensed(
+			const DataSet& dataset,
+			DataView trainingSet,
+			const CondenseOptions& options,
+			std::size_t* numPrototypes)
+		{
+			const auto prototypes = condense(dataset, trainingSet, options);
+			if (numPrototypes)
+			{
+				*numPrototypes = prototypes.size();
+			}
+
+			return std::make_unique<VDMModel>(dataset, trainingSet, DataView{ dataset, Span<const std::size_t>{ prototypes } }, VDMModel::all_attributes(dataset), 1, 1);
+		}
+
+		std::unique_ptr<Model> train_selected(
+			const DataSet& dataset,
+			DataView trainingSet,
+			const SelectionOptions& options,
+			std::vector<std::size_t>* attributes)
+		{
+			auto selected = select_attributes(dataset, trainingSet, options);
+			if (attributes)
 			{
-				std::map<ClassIndex, std::size_t> classCounts;
+				*attributes = selected;
+			}
 
-				// Count up all the classes
-				for (auto neighbor : nearestNeighbors)
+			return std::make_unique<VDMModel>(dataset, trainingSet, trainingSet, std::move(selected), options.k, 1);
+		}
+
+		std::size_t selected_algorithm(
+			const DataSet& dataset,
+			DataView trainingSet,
+			DataView testSet,
+			SelectionOptions::Direction direction,
+			unsigned int k,
+			FoldResult& result)
+		{
+			SelectionOptions options;
+			options.direction = direction;
+			options.k = k;
+			options.num_threads = 1;
+			const auto model = train_selected(dataset, trainingSet, options);
+
+			std::size_t numCorrect = 0;
+			for (auto instance : testSet)
+			{
+				auto classIndex = model->classify(instance);
+				if (classIndex == instance.get_class())
 				{
-					classCounts[neighbor.second] += 1;
+					numCorrect += 1;
 				}
 
-				// Figure out which one has the most occurrences
-				ClassIndex classIndex = 0;
-				std::size_t occurrences = 0;
+				result.record(instance, classIndex);
+			}
+
+			return numCorrect;
+		}
+
+		std::size_t condensed_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result)
+		{
+			CondenseOptions options;
+			options.num_threads = 1;
+			const auto model = train_condensed(dataset, trainingSet, options);
 
-				for (auto iter : classCounts)
+			std::size_t numCorrect = 0;
+			for (auto instance : testSet)
+			{
+				auto classIndex = model->classify(instance);
+				if (classIndex == instance.get_class())
 				{
-					if (iter.second > occurrences)
-					{
-						classIndex = iter.first;
-						occurrences = iter.second;
-					}
+					numCorrect += 1;
 				}
 
-				return classIndex;
+				result.record(instance, classIndex);
 			}
 
-			//////////////////
-			///   Fields   ///
-		private:
+			return numCorrect;
+		}
 
-			std::vector<AttributeCPCache> _attribute_conditional_probabilities;
-		};
+		/* Creates a kernel specialized on the given schema, if the dataset has it. */
+		template <typename SchemaT, int Q, unsigned int K>
+		std::unique_ptr<Kernel> make_kernel_for_schema(const DataSet& dataset, DataView trainingSet)
+		{
+			if (!SchemaT::matches(dataset))
+			{
+				return nullptr;
+			}
+
+			return std::make_unique<SpecializedKernel<SchemaT::num_classes, SchemaT::num_attributes, Q, K>>(dataset, trainingSet);
+		}
+
+		std::unique_ptr<Kernel> make_specialized_kernel(const DataSet& dataset, DataView trainingSet, int q, unsigned int k)
+		{
+			// Only the configuration the algorithm runs with is instantiated, to keep the number of instantiations down
+			if (q != 1 || k != DEFAULT_K)
+			{
+				return nullptr;
+			}
+
+			std::unique_ptr<Kernel> result;
+			(result = make_kernel_for_schema<BreastCancerSchema, 1, DEFAULT_K>(dataset, trainingSet)) ||
+				(result = make_kernel_for_schema<GlassSchema, 1, DEFAULT_K>(dataset, trainingSet)) ||
+				(result = make_kernel_for_schema<HouseVotesSchema, 1, DEFAULT_K>(dataset, trainingSet)) ||
+				(result = make_kernel_for_schema<IrisSchema, 1, DEFAULT_K>(dataset, trainingSet)) ||
+				(result = make_kernel_for_schema<SoybeanSchema, 1, DEFAULT_K>(dataset, trainingSet));
+
+			return result;
+		}
+
+		std::size_t algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, FoldResult& result)
+		{
+			return algorithm(dataset, trainingSet, testSet, DEFAULT_K, result);
+		}
 
-		std::size_t algorithm(const DataSet& dataset, const std::vector<Instance>& trainingSet, const std::vector<Instance>& testSet)
+		std::size_t algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, unsigned int k, FoldResult& result)
 		{
+			// Use the kernel specialized for this dataset's schema if there is one
+			if (auto kernel = make_specialized_kernel(dataset, trainingSet, 1, k))
+			{
+				std::size_t numCorrect = 0;
+
+				for (auto instance : testSet)
+				{
+					auto classIndex = kernel->classify(instance);
+					if (classIndex == instance.get_class())
+					{
+						numCorrect += 1;
+					}
+
+					result.record(instance, classIndex);
+				}
+
+				return numCorrect;
+			}
+
 			VDMCache vdm;
 			vdm.init(dataset, trainingSet);
 
-			// The value of K
-			constexpr unsigned int K_VALUE = 9;
+			// Per-query scratch memory, reused by every query
+			Arena scratch;
 
 			std::size_t numCorrect = 0;
 
 			for (auto instance : testSet)
 			{
 				// Try to classify the test set
-				auto classIndex = vdm.classify(dataset, trainingSet, instance, K_VALUE);
+				auto classIndex = vdm.classify(dataset, trainingSet, instance, k, scratch);
 				if (classIndex == instance.get_class())
 				{
 					numCorrect += 1;
 				}
 
-				std::cout << "    Classified '";
-				instance.print();
-				std::cout << "' as '" << dataset.class_name(classIndex);
-				std::cout << "', actual class: '" << dataset.class_name(instance.get_class()) << "'" << std::endl;
+				result.record(instance, classIndex);
 			}
 
-			std::cout << "Accuracy: " << static_cast<float>(numCorrect * 100) / testSet.size() << "%" << std::endl;
 			return numCorrect;
 		}
 	}
@@ -0,0 +1,214 @@
+// KNearestNeighborCondense.cpp - Will Cassella
+
+#include <limits>
+#include <algorithm>
+#include "../include/KNearestNeighbor.h"
+#include "../include/KNearestNeighborDistance.h"
+#include "../include/Profiler.h"
+#include "../include/Neighbors.h"
+#include "../include/ThreadPool.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		namespace
+		{
+			/* The number of chunks each thread's share of a parallel loop is split into, so uneven chunks balance out. */
+			constexpr std::size_t CHUNKS_PER_THREAD = 4;
+
+			/* Calls 'func(i)' for every 'i' below 'count', split into chunks across the pool (or on this thread, if there's no pool). */
+			template <typename F>
+			void parallel_for(ThreadPool* pool, std::size_t count, const F& func)
+			{
+				if (!pool)
+				{
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						func(i);
+					}
+
+					return;
+				}
+
+				const auto numChunks = pool->num_threads() * CHUNKS_PER_THREAD;
+				const auto chunkSize = std::max<std::size_t>((count + numChunks - 1) / numChunks, 1);
+
+				for (std::size_t start = 0; start < count; start += chunkSize)
+				{
+					const auto end = std::min(start + chunkSize, count);
+					pool->submit([&func, start, end]()
+					{
+						for (auto i = start; i < end; ++i)
+						{
+							func(i);
+						}
+					});
+				}
+
+				pool->wait();
+			}
+
+			/* Wilson editing: returns the rows whose 'k' nearest other rows vote for their own class. */
+			std::vector<std::size_t> edit(const DistanceTable& table, unsigned int k, std::size_t numClasses, ThreadPool* pool)
+			{
+				std::vector<char> keep(table.size(), 0);
+
+				parallel_for(pool, table.size(), [&](std::size_t row)
+				{
+					std::vector<Neighbor> nearestNeighbors(k);
+					std::vector<std::size_t> classCounts(numClasses);
+					std::size_t numNeighbors = 0;
+
+					for (std::size_t other = 0; other < table.size(); ++other)
+					{
+						if (other != row)
+						{
+							insert_if_closer(Span<Neighbor>{ nearestNeighbors }, numNeighbors, std::make_pair(table.distance(row, other), table.get_class(other)));
+						}
+					}
+
+					const auto vote = most_common_class(Span<const Neighbor>{ nearestNeighbors.data(), numNeighbors }, Span<std::size_t>{ classCounts });
+					keep[row] = vote == table.get_class(row);
+				});
+
+				std::vector<std::size_t> result;
+				for (std::size_t row = 0; row < table.size(); ++row)
+				{
+					if (keep[row])
+					{
+						result.push_back(row);
+					}
+				}
+
+				return result;
+			}
+
+			/**
+			 * \brief Hart's condensed nearest neighbor: starting from the first row of each class, repeatedly passes over the rows in order,
+			 * adding each one the store misclassifies (by its single nearest neighbor) to the store, until a pass adds nothing.
+			 * Each pass first finds every row's nearest neighbor in the store as it was at the start of the pass, in parallel. The rows are then
+			 * walked in order, checking only the rows added earlier in the pass, which gives the same store as checking everything in order.
+			 * \return The rows in the store.
+			 */
+			std::vector<std::size_t> condense_rows(const DistanceTable& table, const std::vector<std::size_t>& rows, std::size_t numClasses, ThreadPool* pool)
+			{
+				std::vector<std::size_t> store;
+				std::vector<char> inStore(table.size(), 0);
+				std::vector<char> classSeen(numClasses, 0);
+
+				for (auto row : rows)
+				{
+					if (!classSeen[table.get_class(row)])
+					{
+						classSeen[table.get_class(row)] = 1;
+						inStore[row] = 1;
+						store.push_back(row);
+					}
+				}
+
+				// The nearest row in the store so far for each row, ties go to whichever was added to the store first
+				std::vector<Neighbor> nearest(table.size());
+
+				while (true)
+				{
+					std::vector<std::size_t> candidates;
+					for (auto row : rows)
+					{
+						if (!inStore[row])
+						{
+							candidates.push_back(row);
+						}
+					}
+
+					const auto storeSize = store.size();
+					parallel_for(pool, candidates.size(), [&](std::size_t i)
+					{
+						auto best = std::make_pair(std::numeric_limits<float>::infinity(), ClassIndex{ 0 });
+						for (std::size_t s = 0; s < storeSize; ++s)
+						{
+							const auto distance = table.distance(candidates[i], store[s]);
+							if (distance < best.first)
+							{
+								best = std::make_pair(distance, table.get_class(store[s]));
+							}
+						}
+
+						nearest[candidates[i]] = best;
+					});
+
+					for (auto row : candidates)
+					{
+						auto best = nearest[row];
+						for (auto s = storeSize; s < store.size(); ++s)
+						{
+							const auto distance = table.distance(row, store[s]);
+							if (distance < best.first)
+							{
+								best = std::make_pair(distance, table.get_class(store[s]));
+							}
+						}
+
+						if (best.second != table.get_class(row))
+						{
+							inStore[row] = 1;
+							store.push_back(row);
+						}
+					}
+
+					// Stop once every row is classified correctly
+					if (store.size() == storeSize)
+					{
+						break;
+					}
+				}
+
+				return store;
+			}
+		}
+
+		std::vector<std::size_t> condense(const DataSet& dataset, DataView trainingSet, const CondenseOptions& options)
+		{
+			ML_PROFILE_SCOPE(Condense);
+			const DistanceTable table{ dataset, trainingSet };
+
+			std::unique_ptr<ThreadPool> pool;
+			if (options.num_threads != 1)
+			{
+				pool = std::make_unique<ThreadPool>(options.num_threads);
+			}
+
+			// Edit out the rows that disagree with their neighbors, unless that would leave nothing
+			std::vector<std::size_t> rows;
+			if (options.edit)
+			{
+				rows = edit(table, options.edit_k, dataset.num_classes(), pool.get());
+			}
+
+			if (rows.empty())
+			{
+				rows.resize(table.size());
+				for (std::size_t row = 0; row < rows.size(); ++row)
+				{
+					rows[row] = row;
+				}
+			}
+
+			if (options.condense)
+			{
+				rows = condense_rows(table, rows, dataset.num_classes(), pool.get());
+			}
+
+			// Return the prototypes in training set order
+			std::sort(rows.begin(), rows.end());
+			std::vector<std::size_t> result;
+			result.reserve(rows.size());
+			for (auto row : rows)
+			{
+				result.push_back(trainingSet.indices()[row]);
+			}
+
+			return result;
+		}
+	}
+}
@@ -0,0 +1,223 @@
+// KNearestNeighborHeterogeneous.cpp - Will Cassella
+
+#include <cmath>
+#include <cstdint>
+#include "../include/KNearestNeighbor.h"
+#include "../include/DataSet.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+#include "../include/Neighbors.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ML_HVDM_SSE 1
+#include <emmintrin.h>
+#else
+#define ML_HVDM_SSE 0
+#endif
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		namespace
+		{
+			/* Numeric differences are divided by this many standard deviations, so they're about as large as the categorical ones. */
+			constexpr float NUMERIC_DEVIATIONS = 4.f;
+
+			/**
+			 * \brief Adds the squared difference between the query and each element of the column to the corresponding distance.
+			 * \param column The (normalized) numbers of an attribute for each training instance.
+			 * \param query The (normalized) number of the query for the attribute.
+			 * \param distances The squared distance to each training instance so far.
+			 * \param count The number of training instances.
+			 */
+			void accumulate_squared_differences(const float* column, const float query, float* distances, const std::size_t count)
+			{
+				std::size_t i = 0;
+
+#if ML_HVDM_SSE
+				const auto queries = _mm_set1_ps(query);
+				for (; i + 4 <= count; i += 4)
+				{
+					const auto differences = _mm_sub_ps(_mm_loadu_ps(column + i), queries);
+					_mm_storeu_ps(distances + i, _mm_add_ps(_mm_loadu_ps(distances + i), _mm_mul_ps(differences, differences)));
+				}
+#endif
+
+				for (; i < count; ++i)
+				{
+					const auto difference = column[i] - query;
+					distances[i] += difference * difference;
+				}
+			}
+		}
+
+		std::size_t heterogeneous_algorithm(const DataSet& dataset, DataView trainingSet, DataView testSet, unsigned int k, FoldResult& result)
+		{
+			const auto numClasses = dataset.num_classes();
+			const auto numTraining = trainingSet.size();
+
+			// Split up the categorical and numeric attributes
+			std::vector<Attribute::Index> categorical;
+			std::vector<Attribute::Index> numeric;
+			for (Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+			{
+				(dataset.get_attribute(attribIndex).is_discretized() ? numeric : categorical).push_back(attribIndex);
+			}
+
+			// Give each (categorical attribute, value) pair a single code
+			std::vector<std::size_t> offsets(categorical.size());
+			std::size_t numCodes = 0;
+			for (std::size_t i = 0; i < categorical.size(); ++i)
+			{
+				offsets[i] = numCodes;
+				numCodes += dataset.get_attribute(categorical[i]).domain.size();
+			}
+
+			// Count up the training instances with each code in each class, and lay out the training codes row by row
+			std::vector<float> conditionalProbabilities(numCodes * numClasses, 0.f);
+			std::vector<std::size_t> codeCounts(numCodes, 0);
+			std::vector<std::uint32_t> rows;
+			rows.reserve(numTraining * categorical.size());
+
+			// Lay out the numbers column by column, scaled by the standard deviation so a difference of one is 'NUMERIC_DEVIATIONS' deviations
+			std::vector<float> columns(numTraining * numeric.size());
+			std::vector<float> scales(numeric.size());
+			std::vector<float> means(numeric.size());
+
+			{
+				ML_PROFILE_SCOPE(CPCacheBuild);
+				for (auto instance : trainingSet)
+				{
+					for (std::size_t i = 0; i < categorical.size(); ++i)
+					{
+						const auto code = offsets[i] + instance.get_attrib(categorical[i]);
+						rows.push_back(static_cast<std::uint32_t>(code));
+						codeCounts[code] += 1;
+						conditionalProbabilities[code * numClasses + instance.get_class()] += 1.f;
+					}
+				}
+
+				for (std::size_t code = 0; code < numCodes; ++code)
+				{
+					for (ClassIndex classIndex = 0; codeCounts[code] != 0 && classIndex < numClasses; ++classIndex)
+					{
+						conditionalProbabilities[code * numClasses + classIndex] /= codeCounts[code];
+					}
+				}
+
+				for (std::size_t i = 0; i < numeric.size(); ++i)
+				{
+					// Find the mean and standard deviation of the known numbers
+					double sum = 0;
+					double sumOfSquares = 0;
+					std::size_t numKnown = 0;
+					for (auto instance : trainingSet)
+					{
+						const double number = instance.get_number(numeric[i]);
+						if (!std::isnan(number))
+						{
+							sum += number;
+							sumOfSquares += number * number;
+							numKnown += 1;
+						}
+					}
+
+					const auto mean = numKnown == 0 ? 0.0 : sum / numKnown;
+					const auto deviation = numKnown == 0 ? 0.0 : std::sqrt(std::max(sumOfSquares / numKnown - mean * mean, 0.0));
+					scales[i] = deviation == 0 ? 0.f : static_cast<float>(1 / (NUMERIC_DEVIATIONS * deviation));
+					means[i] = static_cast<float>(mean * scales[i]);
+
+					// Unknown training numbers are filled in with the mean
+					auto* column = &columns[i * numTraining];
+					for (std::size_t row = 0; row < numTraining; ++row)
+					{
+						const auto number = trainingSet[row].get_number(numeric[i]);
+						column[row] = std::isnan(number) ? means[i] : number * scales[i];
+					}
+				}
+			}
+
+			// Scratch space reused by every query
+			std::vector<float> squaredDifferences(numCodes);
+			std::vector<float> distances(numTraining);
+			std::vector<Neighbor> nearestNeighbors(k);
+			std::vector<std::size_t> classCounts(numClasses);
+			std::size_t numCorrect = 0;
+
+			for (auto instance : testSet)
+			{
+				ML_PROFILE_SCOPE(Classify);
+				ML_PROFILE_COUNT(DistanceEvaluations, numTraining);
+
+				// The value difference metric from the query's value of each categorical attribute to every other value
+				for (std::size_t i = 0; i < categorical.size(); ++i)
+				{
+					const auto offset = offsets[i];
+					const auto domainSize = dataset.get_attribute(categorical[i]).domain.size();
+					const float* query = &conditionalProbabilities[(offset + instance.get_attrib(categorical[i])) * numClasses];
+
+					for (Attribute::ValueIndex value = 0; value < domainSize; ++value)
+					{
+						const float* other = &conditionalProbabilities[(offset + value) * numClasses];
+
+						float difference = 0;
+						for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+						{
+							difference += std::abs(query[classIndex] - other[classIndex]);
+						}
+
+						squaredDifferences[offset + value] = difference * difference;
+					}
+				}
+
+				// Sum up the categorical distances row by row
+				for (std::size_t row = 0; row < numTraining; ++row)
+				{
+					const auto* codes = &rows[row * categorical.size()];
+					float distance = 0;
+					for (std::size_t i = 0; i < categorical.size(); ++i)
+					{
+						distance += squaredDifferences[codes[i]];
+					}
+
+					distances[row] = distance;
+				}
+
+				// Then add the numeric distances column by column
+				for (std::size_t i = 0; i < numeric.size(); ++i)
+				{
+					const auto number = instance.get_number(numeric[i]);
+
+					// An unknown number would be the same distance from every row, which can't change which are nearest, so it's ignored
+					if (std::isnan(number))
+					{
+						continue;
+					}
+
+					accumulate_squared_differences(&columns[i * numTraining], number * scales[i], distances.data(), numTraining);
+				}
+
+				// Find the nearest neighbors, the distances are left squared since it doesn't change their order
+				std::size_t numNeighbors = 0;
+				{
+					ML_PROFILE_SCOPE(TopK);
+					for (std::size_t row = 0; row < numTraining; ++row)
+					{
+						insert_if_closer(Span<Neighbor>{ nearestNeighbors }, numNeighbors, std::make_pair(distances[row], trainingSet[row].get_class()));
+					}
+				}
+
+				const auto classIndex = most_common_class(Span<const Neighbor>{ nearestNeighbors.data(), numNeighbors }, Span<std::size_t>{ classCounts });
+				if (classIndex == instance.get_class())
+				{
+					numCorrect += 1;
+				}
+
+				result.record(instance, classIndex);
+			}
+
+			return numCorrect;
+		}
+	}
+}
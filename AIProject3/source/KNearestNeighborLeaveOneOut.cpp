@@ -0,0 +1,175 @@
+// KNearestNeighborLeaveOneOut.cpp - Will Cassella
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "../include/KNearestNeighbor.h"
+#include "../include/DataSet.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+#include "../include/Neighbors.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		/* The number of instances along each side of a tile of the distance matrix. */
+		constexpr std::size_t LEAVE_ONE_OUT_TILE_SIZE = 64;
+
+		std::size_t leave_one_out(const DataSet& dataset, unsigned int k, FoldResult& result)
+		{
+			const auto numInstances = dataset.num_instances();
+			const auto numAttributes = dataset.num_attributes();
+			const auto numClasses = dataset.num_classes();
+
+			// Give each (attribute, value) pair a single code
+			std::vector<std::size_t> offsets(numAttributes);
+			std::size_t numCodes = 0;
+			for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+			{
+				offsets[attribIndex] = numCodes;
+				numCodes += dataset.get_attribute(attribIndex).domain.size();
+			}
+
+			// Count the instances with each code in each class, over the whole dataset
+			std::vector<std::size_t> classCodeCounts(numCodes * numClasses, 0);
+			std::vector<std::size_t> codeCounts(numCodes, 0);
+			std::vector<std::uint32_t> rows(numInstances * numAttributes);
+			std::vector<ClassIndex> classes(numInstances);
+
+			for (std::size_t i = 0; i < numInstances; ++i)
+			{
+				const auto instance = dataset.get_instance(i);
+				classes[i] = instance.get_class();
+
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					const auto code = offsets[attribIndex] + instance.get_attrib(attribIndex);
+					rows[i * numAttributes + attribIndex] = static_cast<std::uint32_t>(code);
+					codeCounts[code] += 1;
+					classCodeCounts[code * numClasses + classes[i]] += 1;
+				}
+			}
+
+			// Holding out an instance only changes the counts of its own codes, so every other code's conditional probabilities are shared
+			std::vector<float> conditionalProbabilities(numCodes * numClasses, 0.f);
+			for (std::size_t code = 0; code < numCodes; ++code)
+			{
+				for (ClassIndex classIndex = 0; codeCounts[code] != 0 && classIndex < numClasses; ++classIndex)
+				{
+					conditionalProbabilities[code * numClasses + classIndex] = static_cast<float>(classCodeCounts[code * numClasses + classIndex]) / codeCounts[code];
+				}
+			}
+
+			// The squared VDM from each held out instance's values to every code, with its own counts taken out.
+			// The distance from 'i' to 'j' is then the sum of row 'i' at the codes of 'j'.
+			std::vector<double> squaredDifferences(numInstances * numCodes);
+			{
+				ML_PROFILE_SCOPE(CPCacheBuild);
+				std::vector<float> heldOut(numClasses);
+
+				for (std::size_t i = 0; i < numInstances; ++i)
+				{
+					auto* table = &squaredDifferences[i * numCodes];
+
+					for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+					{
+						const auto offset = offsets[attribIndex];
+						const auto domainSize = dataset.get_attribute(attribIndex).domain.size();
+						const auto ownCode = rows[i * numAttributes + attribIndex];
+
+						// Adjust the conditional probabilities of this instance's value, as if it weren't in the training set
+						const auto count = codeCounts[ownCode] - 1;
+						for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+						{
+							const auto classCount = classCodeCounts[ownCode * numClasses + classIndex] - (classIndex == classes[i] ? 1 : 0);
+							heldOut[classIndex] = count == 0 ? 0.f : static_cast<float>(classCount) / count;
+						}
+
+						for (Attribute::ValueIndex value = 0; value < domainSize; ++value)
+						{
+							const auto code = offset + value;
+
+							// Other instances with the same value have the same adjusted probabilities
+							if (code == ownCode)
+							{
+								table[code] = 0;
+								continue;
+							}
+
+							float difference = 0;
+							for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+							{
+								difference += std::abs(heldOut[classIndex] - conditionalProbabilities[code * numClasses + classIndex]);
+							}
+
+							const double vdm = difference;
+							table[code] = vdm * vdm;
+						}
+					}
+				}
+			}
+
+			// The nearest neighbors of each instance, filled in as the tiles are visited
+			std::vector<Neighbor> nearestNeighbors(numInstances * k);
+			std::vector<std::size_t> numNeighbors(numInstances, 0);
+
+			// Visit each pair once, computing the distance in both directions while both rows are at hand.
+			// Each instance sees the others in increasing order, the same order a retrained model would see its training set in.
+			{
+				ML_PROFILE_SCOPE(TopK);
+				ML_PROFILE_COUNT(DistanceEvaluations, numInstances * (numInstances - 1));
+
+				for (std::size_t tileI = 0; tileI < numInstances; tileI += LEAVE_ONE_OUT_TILE_SIZE)
+				{
+					const auto endI = std::min(tileI + LEAVE_ONE_OUT_TILE_SIZE, numInstances);
+
+					for (std::size_t tileJ = tileI; tileJ < numInstances; tileJ += LEAVE_ONE_OUT_TILE_SIZE)
+					{
+						const auto endJ = std::min(tileJ + LEAVE_ONE_OUT_TILE_SIZE, numInstances);
+
+						for (std::size_t i = tileI; i < endI; ++i)
+						{
+							const auto* tableI = &squaredDifferences[i * numCodes];
+							const auto* codesI = &rows[i * numAttributes];
+
+							for (std::size_t j = std::max(tileJ, i + 1); j < endJ; ++j)
+							{
+								const auto* tableJ = &squaredDifferences[j * numCodes];
+								const auto* codesJ = &rows[j * numAttributes];
+
+								float distanceIJ = 0;
+								float distanceJI = 0;
+								for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+								{
+									distanceIJ += tableI[codesJ[attribIndex]];
+									distanceJI += tableJ[codesI[attribIndex]];
+								}
+
+								insert_if_closer(Span<Neighbor>{ &nearestNeighbors[i * k], k }, numNeighbors[i], std::make_pair(std::sqrt(distanceIJ), classes[j]));
+								insert_if_closer(Span<Neighbor>{ &nearestNeighbors[j * k], k }, numNeighbors[j], std::make_pair(std::sqrt(distanceJI), classes[i]));
+							}
+						}
+					}
+				}
+			}
+
+			// Vote on each instance
+			std::vector<std::size_t> classCounts(numClasses);
+			std::size_t numCorrect = 0;
+
+			for (std::size_t i = 0; i < numInstances; ++i)
+			{
+				const auto classIndex = most_common_class(Span<const Neighbor>{ &nearestNeighbors[i * k], numNeighbors[i] }, Span<std::size_t>{ classCounts });
+				if (classIndex == classes[i])
+				{
+					numCorrect += 1;
+				}
+
+				result.record(dataset.get_instance(i), classIndex);
+			}
+
+			return numCorrect;
+		}
+	}
+}
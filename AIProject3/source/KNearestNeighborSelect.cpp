@@ -0,0 +1,219 @@
+// KNearestNeighborSelect.cpp - Will Cassella
+
+#include <algorithm>
+#include "../include/KNearestNeighbor.h"
+#include "../include/KNearestNeighborDistance.h"
+#include "../include/Profiler.h"
+#include "../include/Neighbors.h"
+#include "../include/ThreadPool.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		namespace
+		{
+			/**
+			 * \brief Counts how many training instances are classified correctly by their 'k' nearest other training instances,
+			 * by the stored distance sums plus (or minus) the contribution of one more attribute.
+			 * \param sums The squared distance between each pair of rows over the current attributes, row 'i' starts at 'i * table.size()'.
+			 * \param attribIndex The attribute to add or remove, or 'num_attributes' for the current attributes as they are.
+			 * \param sign One to add the attribute's contribution, minus one to remove it.
+			 */
+			std::size_t count_correct(
+				const DistanceTable& table,
+				const std::vector<float>& sums,
+				Attribute::Index attribIndex,
+				float sign,
+				unsigned int k,
+				std::size_t numClasses)
+			{
+				const auto numRows = table.size();
+				const bool adjust = attribIndex < table.num_attributes();
+
+				std::vector<Neighbor> nearestNeighbors(k);
+				std::vector<std::size_t> classCounts(numClasses);
+				std::size_t numCorrect = 0;
+
+				for (std::size_t row = 0; row < numRows; ++row)
+				{
+					const auto* rowSums = &sums[row * numRows];
+					std::size_t numNeighbors = 0;
+
+					for (std::size_t other = 0; other < numRows; ++other)
+					{
+						if (other == row)
+						{
+							continue;
+						}
+
+						auto distance = rowSums[other];
+						if (adjust)
+						{
+							distance += sign * table.contribution(attribIndex, row, other);
+						}
+
+						insert_if_closer(Span<Neighbor>{ nearestNeighbors }, numNeighbors, std::make_pair(distance, table.get_class(other)));
+					}
+
+					const auto vote = most_common_class(Span<const Neighbor>{ nearestNeighbors.data(), numNeighbors }, Span<std::size_t>{ classCounts });
+					numCorrect += vote == table.get_class(row);
+				}
+
+				return numCorrect;
+			}
+		}
+
+		std::vector<std::size_t> select_attributes(const DataSet& dataset, DataView trainingSet, const SelectionOptions& options)
+		{
+			ML_PROFILE_SCOPE(Select);
+			const DistanceTable table{ dataset, trainingSet };
+			const auto numRows = table.size();
+			const auto numAttributes = table.num_attributes();
+			const bool forward = options.direction == SelectionOptions::Direction::Forward;
+
+			// Start with no attributes going forward, or all of them going backward
+			std::vector<char> selected(numAttributes, forward ? 0 : 1);
+			std::vector<float> sums(numRows * numRows, 0.f);
+			if (!forward)
+			{
+				for (std::size_t row = 0; row < numRows; ++row)
+				{
+					for (std::size_t other = 0; other < numRows; ++other)
+					{
+						sums[row * numRows + other] = table.distance(row, other);
+					}
+				}
+			}
+
+			std::unique_ptr<ThreadPool> pool;
+			if (options.num_threads != 1)
+			{
+				pool = std::make_unique<ThreadPool>(options.num_threads);
+			}
+
+			auto current = count_correct(table, sums, numAttributes, 0.f, options.k, dataset.num_classes());
+			std::vector<std::size_t> candidateCorrect(numAttributes, 0);
+
+			while (true)
+			{
+				// Evaluate adding (or removing) each attribute on its own
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					if ((selected[attribIndex] != 0) == forward)
+					{
+						continue;
+					}
+
+					const auto job = [&, attribIndex]()
+					{
+						candidateCorrect[attribIndex] = count_correct(table, sums, attribIndex, forward ? 1.f : -1.f, options.k, dataset.num_classes());
+					};
+
+					if (pool)
+					{
+						pool->submit(job);
+					}
+					else
+					{
+						job();
+					}
+				}
+
+				if (pool)
+				{
+					pool->wait();
+				}
+
+				// Take the best candidate, the first one wins ties
+				auto best = numAttributes;
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					if ((selected[attribIndex] != 0) != forward && (best == numAttributes || candidateCorrect[attribIndex] > candidateCorrect[best]))
+					{
+						best = attribIndex;
+					}
+				}
+
+				// Going forward an attribute has to help to be added, going backward one is removed as long as it doesn't hurt.
+				// At least one attribute is always kept.
+				const auto numSelected = static_cast<std::size_t>(std::count(selected.begin(), selected.end(), 1));
+				if (best == numAttributes ||
+					(forward && numSelected != 0 && candidateCorrect[best] <= current) ||
+					(!forward && (numSelected == 1 || candidateCorrect[best] < current)))
+				{
+					break;
+				}
+
+				selected[best] = forward ? 1 : 0;
+				current = candidateCorrect[best];
+
+				// Recompute the stored sums over the chosen attributes, rather than adding or subtracting the chosen one's contribution,
+				// so rounding doesn't pile up from step to step (and rows at the same distance stay tied)
+				std::vector<Attribute::Index> chosen;
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					if (selected[attribIndex])
+					{
+						chosen.push_back(attribIndex);
+					}
+				}
+
+				const auto recompute = [&](std::size_t row)
+				{
+					for (std::size_t other = 0; other < numRows; ++other)
+					{
+						float sum = 0;
+						for (auto attribIndex : chosen)
+						{
+							sum += table.contribution(attribIndex, row, other);
+						}
+
+						sums[row * numRows + other] = sum;
+					}
+				};
+
+				if (pool)
+				{
+					pool->run_batch(numRows, recompute);
+				}
+				else
+				{
+					for (std::size_t row = 0; row < numRows; ++row)
+					{
+						recompute(row);
+					}
+				}
+			}
+
+			std::vector<std::size_t> result;
+			for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+			{
+				if (selected[attribIndex])
+				{
+					result.push_back(attribIndex);
+				}
+			}
+
+			return result;
+		}
+
+		bool parse_selection_direction(const std::string& name, SelectionOptions::Direction& out)
+		{
+			if (name == "forward")
+			{
+				out = SelectionOptions::Direction::Forward;
+			}
+			else if (name == "backward")
+			{
+				out = SelectionOptions::Direction::Backward;
+			}
+			else
+			{
+				return false;
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,253 @@
+// KNearestNeighborSharded.cpp - Will Cassella
+
+#include <limits>
+#include <thread>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include "../include/KNearestNeighbor.h"
+#include "../include/KNearestNeighborDistance.h"
+#include "../include/Profiler.h"
+#include "../include/Neighbors.h"
+#include "../include/ThreadPool.h"
+#include "../include/Model.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		namespace
+		{
+			/* A training row a shard found near a query. */
+			struct Candidate
+			{
+				float distance;
+				std::size_t row;
+				ClassIndex class_index;
+			};
+
+			/* Whether 'a' is nearer than 'b', ties go to the earlier row. */
+			bool nearer(const Candidate& a, const Candidate& b)
+			{
+				return a.distance < b.distance || (a.distance == b.distance && a.row < b.row);
+			}
+
+			/**
+			 * \brief A K nearest neighbor model that splits the training rows into shards, one per thread. Each shard finds the 'k' nearest
+			 * of its rows to each query, and the nearest 'k' of those are merged. Since ties go to the earlier row in both, the result is
+			 * the same however many shards there are. Distances are left squared, since only their order matters.
+			 */
+			class ShardedModel final : public Model
+			{
+				////////////////////////
+				///   Constructors   ///
+			public:
+
+				ShardedModel(const DataSet& dataset, DataView trainingSet, unsigned int k, std::size_t numThreads)
+					: _num_attributes(dataset.num_attributes()),
+					_num_classes(dataset.num_classes()),
+					_k(k)
+				{
+					if (numThreads == 0)
+					{
+						numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+					}
+
+					// The thread classifying takes a shard too
+					_num_shards = numThreads;
+					if (numThreads > 1)
+					{
+						_pool = std::make_unique<ThreadPool>(numThreads - 1);
+					}
+
+					_table_offsets.resize(_num_attributes);
+					_domain_sizes.resize(_num_attributes);
+					for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+					{
+						const auto differences = squared_value_differences(dataset, trainingSet, attribIndex);
+						_table_offsets[attribIndex] = _squared_differences.size();
+						_domain_sizes[attribIndex] = dataset.get_attribute(attribIndex).domain.size();
+						_squared_differences.insert(_squared_differences.end(), differences.begin(), differences.end());
+					}
+
+					// Copy the training set, as narrowly as the domains allow
+					_values.reserve(trainingSet.size() * _num_attributes);
+					_classes.reserve(trainingSet.size());
+					for (auto instance : trainingSet)
+					{
+						for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+						{
+							assert(_domain_sizes[attribIndex] <= std::numeric_limits<std::uint16_t>::max() + 1u);
+							_values.push_back(static_cast<std::uint16_t>(instance.get_attrib(attribIndex)));
+						}
+
+						_classes.push_back(instance.get_class());
+					}
+				}
+
+				///////////////////
+				///   Methods   ///
+			public:
+
+				using Model::classify;
+
+				std::size_t num_attributes() const override
+				{
+					return _num_attributes;
+				}
+
+				ClassIndex classify(const Attribute::ValueIndex* values) const override
+				{
+					ClassIndex result;
+					classify_batch(values, 1, &result);
+					return result;
+				}
+
+				void classify_batch(const Attribute::ValueIndex* values, std::size_t count, ClassIndex* out) const override
+				{
+					ML_PROFILE_SCOPE(Classify);
+					ML_PROFILE_COUNT(DistanceEvaluations, count * _classes.size());
+
+					// The row of each attribute's table for each query's value, so a distance is a lookup per attribute
+					std::vector<const float*> queryTables(count * _num_attributes);
+					for (std::size_t query = 0; query < count; ++query)
+					{
+						for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+						{
+							const auto value = values[query * _num_attributes + attribIndex];
+							queryTables[query * _num_attributes + attribIndex] = &_squared_differences[_table_offsets[attribIndex] + value * _domain_sizes[attribIndex]];
+						}
+					}
+
+					// The nearest rows each shard found for each query, those of shard 's' for query 'q' start at '(s * count + q) * _k'
+					const auto numRows = _classes.size();
+					const auto numShards = std::max<std::size_t>(std::min(_num_shards, numRows), 1);
+					std::vector<Candidate> candidates(numShards * count * _k);
+					std::vector<std::size_t> numCandidates(numShards * count, 0);
+
+					const auto findNearest = [&](std::size_t shard)
+					{
+						const auto begin = numRows * shard / numShards;
+						const auto end = numRows * (shard + 1) / numShards;
+						find_nearest(queryTables.data(), count, begin, end, &candidates[shard * count * _k], &numCandidates[shard * count]);
+					};
+
+					if (_pool)
+					{
+						_pool->run_batch(numShards, findNearest);
+					}
+					else
+					{
+						for (std::size_t shard = 0; shard < numShards; ++shard)
+						{
+							findNearest(shard);
+						}
+					}
+
+					// Merge the shards' nearest rows, and vote on each query
+					ML_PROFILE_SCOPE(TopK);
+					std::vector<Candidate> merged;
+					std::vector<Neighbor> nearestNeighbors(_k);
+					std::vector<std::size_t> classCounts(_num_classes);
+					for (std::size_t query = 0; query < count; ++query)
+					{
+						merged.clear();
+						for (std::size_t shard = 0; shard < numShards; ++shard)
+						{
+							const auto* shardCandidates = &candidates[(shard * count + query) * _k];
+							merged.insert(merged.end(), shardCandidates, shardCandidates + numCandidates[shard * count + query]);
+						}
+
+						const auto numNearest = std::min<std::size_t>(_k, merged.size());
+						std::partial_sort(merged.begin(), merged.begin() + numNearest, merged.end(), nearer);
+
+						for (std::size_t i = 0; i < numNearest; ++i)
+						{
+							nearestNeighbors[i] = std::make_pair(merged[i].distance, merged[i].class_index);
+						}
+
+						out[query] = most_common_class(Span<const Neighbor>{ nearestNeighbors.data(), numNearest }, Span<std::size_t>{ classCounts });
+					}
+				}
+
+			private:
+
+				/* Finds the 'k' nearest rows in [begin, end) to each query, into its own array of 'k' candidates. */
+				void find_nearest(
+					const float* const* queryTables,
+					std::size_t count,
+					std::size_t begin,
+					std::size_t end,
+					Candidate* nearest,
+					std::size_t* numNearest) const
+				{
+					// The furthest of each query's candidates, once it has 'k' of them
+					std::vector<std::size_t> furthest(count, 0);
+
+					for (auto row = begin; row < end; ++row)
+					{
+						const auto* rowValues = &_values[row * _num_attributes];
+
+						for (std::size_t query = 0; query < count; ++query)
+						{
+							const auto* tables = queryTables + query * _num_attributes;
+							float distance = 0;
+							for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+							{
+								distance += tables[attribIndex][rowValues[attribIndex]];
+							}
+
+							auto* queryNearest = nearest + query * _k;
+							auto& numQueryNearest = numNearest[query];
+							const Candidate candidate{ distance, row, _classes[row] };
+
+							if (numQueryNearest < _k)
+							{
+								queryNearest[numQueryNearest++] = candidate;
+							}
+							else if (distance < queryNearest[furthest[query]].distance)
+							{
+								// Rows come in order, so a row as far as the furthest candidate loses the tie
+								queryNearest[furthest[query]] = candidate;
+							}
+							else
+							{
+								continue;
+							}
+
+							// Find the new furthest candidate
+							if (numQueryNearest == _k)
+							{
+								furthest[query] = std::max_element(queryNearest, queryNearest + _k, nearer) - queryNearest;
+							}
+						}
+					}
+				}
+
+				//////////////////
+				///   Fields   ///
+			private:
+
+				std::size_t _num_attributes;
+				std::size_t _num_classes;
+				unsigned int _k;
+				std::size_t _num_shards;
+				std::unique_ptr<ThreadPool> _pool;
+
+				/* The squared value difference between values 'x' and 'y' of attribute 'a', at '_table_offsets[a] + x * _domain_sizes[a] + y'. */
+				std::vector<std::size_t> _table_offsets;
+				std::vector<std::size_t> _domain_sizes;
+				std::vector<float> _squared_differences;
+
+				/* The training set, the values of row 'i' start at 'i * _num_attributes'. */
+				std::vector<std::uint16_t> _values;
+				std::vector<ClassIndex> _classes;
+			};
+		}
+
+		std::unique_ptr<Model> train_sharded(const DataSet& dataset, DataView trainingSet, unsigned int k, std::size_t numThreads)
+		{
+			return std::make_unique<ShardedModel>(dataset, trainingSet, k, numThreads);
+		}
+	}
+}
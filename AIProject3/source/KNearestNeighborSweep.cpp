@@ -0,0 +1,154 @@
+// KNearestNeighborSweep.cpp - Will Cassella
+
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+#include "../include/KNearestNeighborSweep.h"
+#include "../include/Profiler.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		void sweep(
+			const DataSet& dataset,
+			DataView trainingSet,
+			DataView testSet,
+			const SweepGrid& grid,
+			std::vector<ConfusionMatrix>& results)
+		{
+			assert(results.size() == grid.num_cells());
+			const auto numAttributes = dataset.num_attributes();
+			const auto numClasses = dataset.num_classes();
+			const auto numQs = grid.qs.size();
+
+			// Give each (attribute, value) pair a single code
+			std::vector<std::size_t> offsets(numAttributes);
+			std::size_t numCodes = 0;
+			for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+			{
+				offsets[attribIndex] = numCodes;
+				numCodes += dataset.get_attribute(attribIndex).domain.size();
+			}
+
+			// Count the training instances with each code in each class, these are shared by every 'q'
+			std::vector<float> conditionalProbabilities(numCodes * numClasses, 0.f);
+			std::vector<std::size_t> codeCounts(numCodes, 0);
+			std::vector<std::uint32_t> rows;
+			rows.reserve(trainingSet.size() * numAttributes);
+			{
+				ML_PROFILE_SCOPE(CPCacheBuild);
+				for (auto instance : trainingSet)
+				{
+					for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+					{
+						const auto code = offsets[attribIndex] + instance.get_attrib(attribIndex);
+						rows.push_back(static_cast<std::uint32_t>(code));
+						codeCounts[code] += 1;
+						conditionalProbabilities[code * numClasses + instance.get_class()] += 1.f;
+					}
+				}
+
+				for (std::size_t code = 0; code < numCodes; ++code)
+				{
+					for (ClassIndex classIndex = 0; codeCounts[code] != 0 && classIndex < numClasses; ++classIndex)
+					{
+						conditionalProbabilities[code * numClasses + classIndex] /= codeCounts[code];
+					}
+				}
+			}
+
+			// Visit the values of 'k' in increasing order, so the votes may be counted up incrementally
+			std::vector<std::size_t> kOrder(grid.ks.size());
+			std::iota(kOrder.begin(), kOrder.end(), 0);
+			std::sort(kOrder.begin(), kOrder.end(), [&](std::size_t a, std::size_t b) { return grid.ks[a] < grid.ks[b]; });
+			const std::size_t maxK = grid.ks.empty() ? 0 : std::min<std::size_t>(grid.ks[kOrder.back()], trainingSet.size());
+
+			// Scratch space reused by every query
+			std::vector<double> squaredDifferences(numQs * numCodes);
+			std::vector<float> distances(numQs * trainingSet.size());
+			std::vector<std::pair<float, std::size_t>> neighbors(trainingSet.size());
+			std::vector<std::size_t> classCounts(numClasses);
+
+			for (auto instance : testSet)
+			{
+				ML_PROFILE_SCOPE(Classify);
+				ML_PROFILE_COUNT(DistanceEvaluations, trainingSet.size());
+
+				// The difference between the query's value and each value of each attribute only needs to be summed once for every 'q'
+				for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+				{
+					const auto offset = offsets[attribIndex];
+					const auto domainSize = dataset.get_attribute(attribIndex).domain.size();
+					const float* query = &conditionalProbabilities[(offset + instance.get_attrib(attribIndex)) * numClasses];
+
+					for (Attribute::ValueIndex value = 0; value < domainSize; ++value)
+					{
+						const float* other = &conditionalProbabilities[(offset + value) * numClasses];
+
+						float difference = 0;
+						for (ClassIndex classIndex = 0; classIndex < numClasses; ++classIndex)
+						{
+							difference += std::abs(query[classIndex] - other[classIndex]);
+						}
+
+						// Rounded through float the same way as the other implementations
+						for (std::size_t qIndex = 0; qIndex < numQs; ++qIndex)
+						{
+							const double vdm = static_cast<float>(std::pow(difference, grid.qs[qIndex]));
+							squaredDifferences[qIndex * numCodes + offset + value] = vdm * vdm;
+						}
+					}
+				}
+
+				// Compute the distances for every 'q' in a single pass over the training set
+				std::fill(distances.begin(), distances.end(), 0.f);
+				for (std::size_t row = 0; row < trainingSet.size(); ++row)
+				{
+					const auto* codes = &rows[row * numAttributes];
+					for (Attribute::Index attribIndex = 0; attribIndex < numAttributes; ++attribIndex)
+					{
+						for (std::size_t qIndex = 0; qIndex < numQs; ++qIndex)
+						{
+							auto& distance = distances[qIndex * trainingSet.size() + row];
+							distance = static_cast<float>(distance + squaredDifferences[qIndex * numCodes + codes[attribIndex]]);
+						}
+					}
+				}
+
+				for (std::size_t qIndex = 0; qIndex < numQs; ++qIndex)
+				{
+					// Sort the nearest neighbors up to the largest 'k', with ties going to the later training instance
+					ML_PROFILE_SCOPE(TopK);
+					for (std::size_t row = 0; row < trainingSet.size(); ++row)
+					{
+						neighbors[row] = std::make_pair(std::sqrt(distances[qIndex * trainingSet.size() + row]), row);
+					}
+
+					std::partial_sort(neighbors.begin(), neighbors.begin() + maxK, neighbors.end(), [](const std::pair<float, std::size_t>& a, const std::pair<float, std::size_t>& b)
+					{
+						return a.first < b.first || (a.first == b.first && a.second > b.second);
+					});
+
+					// Count up the votes one neighbor at a time, classifying each time a 'k' is reached
+					std::fill(classCounts.begin(), classCounts.end(), 0);
+					std::size_t numVotes = 0;
+
+					for (auto kIndex : kOrder)
+					{
+						const auto k = std::min<std::size_t>(grid.ks[kIndex], maxK);
+						for (; numVotes < k; ++numVotes)
+						{
+							classCounts[trainingSet[neighbors[numVotes].second].get_class()] += 1;
+						}
+
+						// Ties go to the lowest class index
+						const auto classIndex = static_cast<ClassIndex>(std::max_element(classCounts.begin(), classCounts.end()) - classCounts.begin());
+						results[grid.cell(kIndex, qIndex)].record(instance.get_class(), classIndex);
+					}
+				}
+			}
+		}
+	}
+}
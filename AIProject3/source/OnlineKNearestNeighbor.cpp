@@ -0,0 +1,231 @@
+// OnlineKNearestNeighbor.cpp - Will Cassella
+
+#include <cmath>
+#include "../include/OnlineKNearestNeighbor.h"
+#include "../include/KNearestNeighbor.h"
+#include "../include/Neighbors.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+
+namespace ml
+{
+	namespace k_nearest_neighbor
+	{
+		OnlineModel::OnlineModel(const DataSet& schema, std::size_t windowSize, int q)
+			: _num_classes(schema.num_classes()),
+			_num_attributes(schema.num_attributes()),
+			_window_size(windowSize),
+			_q(q),
+			_schema(&schema)
+		{
+			_attributes.resize(_num_attributes);
+
+			for (Attribute::Index i = 0; i < _num_attributes; ++i)
+			{
+				auto& stats = _attributes[i];
+				stats.domain_size = schema.get_attribute(i).domain.size();
+				stats.value_counts.assign(stats.domain_size, 0);
+				stats.value_class_counts.assign(stats.domain_size * _num_classes, 0);
+				stats.conditional_probabilities.assign(stats.domain_size * _num_classes, 0.f);
+				stats.value_differences.assign(stats.domain_size * stats.domain_size, 0.f);
+			}
+		}
+
+		OnlineModel::InstanceId OnlineModel::insert(ClassIndex classIndex, const Attribute::ValueIndex* values)
+		{
+			const auto id = _next_id++;
+			const auto slot = _classes.size();
+
+			_values.insert(_values.end(), values, values + _num_attributes);
+			_classes.push_back(classIndex);
+			_ids.push_back(id);
+			_slots[id] = slot;
+			_insertion_order.push_back(id);
+
+			update_counts(classIndex, values, 1);
+
+			// Expire the oldest instances if we've gone over the window
+			set_window_size(_window_size);
+
+			return id;
+		}
+
+		OnlineModel::InstanceId OnlineModel::insert(Instance instance)
+		{
+			std::vector<Attribute::ValueIndex> values(_num_attributes);
+			for (Attribute::Index i = 0; i < _num_attributes; ++i)
+			{
+				values[i] = instance.get_attrib(i);
+			}
+
+			return insert(instance.get_class(), values.data());
+		}
+
+		bool OnlineModel::remove(InstanceId id)
+		{
+			auto iter = _slots.find(id);
+			if (iter == _slots.end())
+			{
+				return false;
+			}
+
+			remove_slot(iter->second);
+
+			// Don't let ids that were removed out of order pile up in the insertion order
+			if (_insertion_order.size() > 2 * size() + 16)
+			{
+				std::deque<InstanceId> order;
+				for (auto orderId : _insertion_order)
+				{
+					if (_slots.count(orderId) != 0)
+					{
+						order.push_back(orderId);
+					}
+				}
+
+				_insertion_order = std::move(order);
+			}
+
+			return true;
+		}
+
+		void OnlineModel::set_window_size(std::size_t windowSize)
+		{
+			_window_size = windowSize;
+			if (_window_size == 0)
+			{
+				return;
+			}
+
+			while (size() > _window_size)
+			{
+				const auto id = _insertion_order.front();
+				_insertion_order.pop_front();
+
+				// The id may have already been removed explicitly
+				auto iter = _slots.find(id);
+				if (iter != _slots.end())
+				{
+					remove_slot(iter->second);
+				}
+			}
+		}
+
+		void OnlineModel::remove_slot(std::size_t slot)
+		{
+			update_counts(_classes[slot], &_values[slot * _num_attributes], -1);
+			_slots.erase(_ids[slot]);
+
+			// Move the last instance into this slot
+			const auto last = _classes.size() - 1;
+			if (slot != last)
+			{
+				std::copy(
+					_values.begin() + last * _num_attributes,
+					_values.begin() + (last + 1) * _num_attributes,
+					_values.begin() + slot * _num_attributes);
+				_classes[slot] = _classes[last];
+				_ids[slot] = _ids[last];
+				_slots[_ids[slot]] = slot;
+			}
+
+			_values.resize(last * _num_attributes);
+			_classes.pop_back();
+			_ids.pop_back();
+		}
+
+		void OnlineModel::update_counts(ClassIndex classIndex, const Attribute::ValueIndex* values, int delta)
+		{
+			for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+			{
+				auto& stats = _attributes[attribIndex];
+				const auto value = values[attribIndex];
+				const auto startIndex = value * _num_classes;
+
+				stats.value_counts[value] += delta;
+				stats.value_class_counts[startIndex + classIndex] += delta;
+
+				// Only the conditional probabilities for this value have changed
+				const auto count = stats.value_counts[value];
+				for (ClassIndex c = 0; c < _num_classes; ++c)
+				{
+					stats.conditional_probabilities[startIndex + c] = count == 0 ? 0.f : static_cast<float>(stats.value_class_counts[startIndex + c]) / count;
+				}
+
+				// So only the differences against this value need to be refreshed
+				for (Attribute::ValueIndex other = 0; other < stats.domain_size; ++other)
+				{
+					float difference = 0;
+					for (ClassIndex c = 0; c < _num_classes; ++c)
+					{
+						difference += std::abs(stats.conditional_probabilities[startIndex + c] - stats.conditional_probabilities[other * _num_classes + c]);
+					}
+
+					difference = std::pow(difference, _q);
+					stats.value_differences[value * stats.domain_size + other] = difference;
+					stats.value_differences[other * stats.domain_size + value] = difference;
+				}
+			}
+		}
+
+		ClassIndex OnlineModel::classify(const Attribute::ValueIndex* values, unsigned int k) const
+		{
+			ML_PROFILE_SCOPE(Classify);
+			ML_PROFILE_COUNT(DistanceEvaluations, size());
+
+			std::vector<Neighbor> nearestNeighbors(k);
+			std::size_t numNeighbors = 0;
+
+			for (std::size_t slot = 0; slot < _classes.size(); ++slot)
+			{
+				const auto* slotValues = &_values[slot * _num_attributes];
+				float distance = 0;
+
+				for (Attribute::Index attribIndex = 0; attribIndex < _num_attributes; ++attribIndex)
+				{
+					const auto& stats = _attributes[attribIndex];
+					const auto difference = stats.value_differences[values[attribIndex] * stats.domain_size + slotValues[attribIndex]];
+					distance += difference * difference;
+				}
+
+				distance = std::sqrt(distance);
+				insert_if_closer(Span<Neighbor>{ nearestNeighbors }, numNeighbors, std::make_pair(distance, _classes[slot]));
+			}
+
+			std::vector<std::size_t> classCounts(_num_classes);
+			return most_common_class(Span<const Neighbor>{ nearestNeighbors.data(), numNeighbors }, Span<std::size_t>{ classCounts });
+		}
+
+		ClassIndex OnlineModel::classify(Instance instance, unsigned int k) const
+		{
+			std::vector<Attribute::ValueIndex> values(_num_attributes);
+			for (Attribute::Index i = 0; i < _num_attributes; ++i)
+			{
+				values[i] = instance.get_attrib(i);
+			}
+
+			return classify(values.data(), k);
+		}
+
+		std::size_t online_algorithm(const DataSet& dataset, const std::vector<Instance>& stream, std::size_t windowSize, FoldResult& result)
+		{
+			OnlineModel model{ dataset, windowSize };
+			std::size_t numCorrect = 0;
+
+			for (auto instance : stream)
+			{
+				// Test on the instance before it's learned from
+				const auto classIndex = model.classify(instance, DEFAULT_K);
+				if (classIndex == instance.get_class())
+				{
+					numCorrect += 1;
+				}
+
+				result.record(instance, classIndex);
+				model.insert(instance);
+			}
+
+			return numCorrect;
+		}
+	}
+}
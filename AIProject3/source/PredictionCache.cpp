@@ -0,0 +1,284 @@
+// PredictionCache.cpp - Will Cassella
+
+#include <ostream>
+#include <algorithm>
+#include "../include/PredictionCache.h"
+
+namespace ml
+{
+	namespace
+	{
+		/* Keys up to this many words long are packed on the stack. */
+		constexpr std::size_t MAX_STACK_KEY_WORDS = 8;
+
+		/* Returns the number of bits needed to hold every value below 'domainSize'. */
+		unsigned int bits_for(std::size_t domainSize)
+		{
+			unsigned int bits = 0;
+			while (bits < 64 && (std::uint64_t{ 1 } << bits) < domainSize)
+			{
+				bits += 1;
+			}
+
+			return bits;
+		}
+
+		/* Mixes the bits of 'x' so every bit of the input affects every bit of the output (the 'splitmix64' finalizer). */
+		std::uint64_t mix(std::uint64_t x)
+		{
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ull;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebull;
+			x ^= x >> 31;
+			return x;
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& out, const PredictionCacheStats& stats)
+	{
+		out << "cache hits: " << stats.hits << ", misses: " << stats.misses << ", hit rate: " << stats.hit_rate() * 100 << '%';
+		out << ", evictions: " << stats.evictions << ", invalidations: " << stats.invalidations;
+		return out;
+	}
+
+	PredictionCache::PredictionCache(const DataSet& schema, std::size_t capacity)
+		: _key_words(1),
+		_sets_per_shard(1)
+	{
+		// Work out how many bits each attribute is packed into
+		unsigned int totalBits = 0;
+		for (Attribute::Index attribIndex = 0; attribIndex < schema.num_attributes(); ++attribIndex)
+		{
+			const auto domainSize = schema.get_attribute(attribIndex).domain.size();
+			_domain_sizes.push_back(domainSize);
+			_bits.push_back(bits_for(domainSize));
+			totalBits += _bits.back();
+		}
+
+		_key_words = std::max<std::size_t>((totalBits + 63) / 64, 1);
+
+		while (_sets_per_shard * NUM_SHARDS * WAYS < capacity)
+		{
+			_sets_per_shard *= 2;
+		}
+
+		for (auto& shard : _shards)
+		{
+			shard.generations.assign(_sets_per_shard * WAYS, 0);
+			shard.classes.assign(_sets_per_shard * WAYS, 0);
+			shard.keys.assign(_sets_per_shard * WAYS * _key_words, 0);
+			shard.most_recent.assign(_sets_per_shard, 0);
+		}
+	}
+
+	bool PredictionCache::find(const Attribute::ValueIndex* values, ClassIndex& out)
+	{
+		std::uint64_t stackKey[MAX_STACK_KEY_WORDS];
+		std::vector<std::uint64_t> heapKey(_key_words > MAX_STACK_KEY_WORDS ? _key_words : 0);
+		auto* packed = heapKey.empty() ? stackKey : heapKey.data();
+
+		if (!pack(values, packed))
+		{
+			_uncacheable.fetch_add(1);
+			return false;
+		}
+
+		const auto hashed = hash(packed);
+		auto& owner = _shards[hashed % NUM_SHARDS];
+		const auto set = static_cast<std::size_t>(hashed / NUM_SHARDS) & (_sets_per_shard - 1);
+		const auto generation = _generation.load();
+
+		std::lock_guard<std::mutex> lock{ owner.mutex };
+		for (std::size_t way = 0; way < WAYS; ++way)
+		{
+			const auto entry = set * WAYS + way;
+			if (owner.generations[entry] == generation && std::equal(packed, packed + _key_words, &owner.keys[entry * _key_words]))
+			{
+				owner.most_recent[set] = static_cast<std::uint8_t>(way);
+				owner.stats.hits += 1;
+				out = owner.classes[entry];
+				return true;
+			}
+		}
+
+		owner.stats.misses += 1;
+		return false;
+	}
+
+	void PredictionCache::insert(const Attribute::ValueIndex* values, ClassIndex classIndex, std::uint64_t generation)
+	{
+		std::uint64_t stackKey[MAX_STACK_KEY_WORDS];
+		std::vector<std::uint64_t> heapKey(_key_words > MAX_STACK_KEY_WORDS ? _key_words : 0);
+		auto* packed = heapKey.empty() ? stackKey : heapKey.data();
+
+		if (!pack(values, packed))
+		{
+			return;
+		}
+
+		const auto hashed = hash(packed);
+		auto& owner = _shards[hashed % NUM_SHARDS];
+		const auto set = static_cast<std::size_t>(hashed / NUM_SHARDS) & (_sets_per_shard - 1);
+
+		std::lock_guard<std::mutex> lock{ owner.mutex };
+
+		// The prediction came from a model that has since been replaced
+		if (generation != _generation.load())
+		{
+			return;
+		}
+
+		// Use the entry with this key if there is one, then an empty (or stale) entry, and otherwise the one after the most recently used
+		std::size_t way = WAYS;
+		for (std::size_t w = 0; w < WAYS && way == WAYS; ++w)
+		{
+			const auto entry = set * WAYS + w;
+			if (owner.generations[entry] == generation && std::equal(packed, packed + _key_words, &owner.keys[entry * _key_words]))
+			{
+				way = w;
+			}
+		}
+		for (std::size_t w = 0; w < WAYS && way == WAYS; ++w)
+		{
+			if (owner.generations[set * WAYS + w] != generation)
+			{
+				way = w;
+			}
+		}
+		if (way == WAYS)
+		{
+			way = (owner.most_recent[set] + 1) % WAYS;
+			owner.stats.evictions += 1;
+		}
+
+		const auto entry = set * WAYS + way;
+		owner.generations[entry] = generation;
+		owner.classes[entry] = classIndex;
+		std::copy(packed, packed + _key_words, &owner.keys[entry * _key_words]);
+		owner.most_recent[set] = static_cast<std::uint8_t>(way);
+	}
+
+	void PredictionCache::invalidate()
+	{
+		_generation.fetch_add(1);
+		_invalidations.fetch_add(1);
+	}
+
+	PredictionCacheStats PredictionCache::stats() const
+	{
+		PredictionCacheStats result;
+		for (auto& shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock{ shard.mutex };
+			result.hits += shard.stats.hits;
+			result.misses += shard.stats.misses;
+			result.evictions += shard.stats.evictions;
+		}
+
+		result.misses += _uncacheable.load();
+		result.invalidations = _invalidations.load();
+		return result;
+	}
+
+	bool PredictionCache::pack(const Attribute::ValueIndex* values, std::uint64_t* key) const
+	{
+		std::fill(key, key + _key_words, 0);
+
+		std::size_t bit = 0;
+		for (std::size_t attribIndex = 0; attribIndex < _domain_sizes.size(); ++attribIndex)
+		{
+			const auto value = values[attribIndex];
+			if (value >= _domain_sizes[attribIndex])
+			{
+				return false;
+			}
+
+			// A value may straddle two words
+			const auto word = bit / 64;
+			const auto offset = bit % 64;
+			key[word] |= static_cast<std::uint64_t>(value) << offset;
+			if (offset + _bits[attribIndex] > 64)
+			{
+				key[word + 1] |= static_cast<std::uint64_t>(value) >> (64 - offset);
+			}
+
+			bit += _bits[attribIndex];
+		}
+
+		return true;
+	}
+
+	std::uint64_t PredictionCache::hash(const std::uint64_t* key) const
+	{
+		std::uint64_t result = 0;
+		for (std::size_t word = 0; word < _key_words; ++word)
+		{
+			result = mix(result ^ key[word]);
+		}
+
+		return result;
+	}
+
+	CachedModel::CachedModel(std::shared_ptr<const Model> model, const DataSet& schema, std::size_t capacity)
+		: _num_attributes(model->num_attributes()),
+		_model(std::move(model)),
+		_cache(schema, capacity)
+	{
+	}
+
+	ClassIndex CachedModel::classify(const Attribute::ValueIndex* values) const
+	{
+		ClassIndex result;
+		if (_cache.find(values, result))
+		{
+			return result;
+		}
+
+		// Take the generation before the model, so a prediction from a replaced model is never cached under the new generation
+		const auto generation = _cache.generation();
+		const auto model = std::atomic_load(&_model);
+		result = model->classify(values);
+		_cache.insert(values, result, generation);
+		return result;
+	}
+
+	void CachedModel::classify_batch(const Attribute::ValueIndex* values, std::size_t count, ClassIndex* out) const
+	{
+		// Gather up the instances that aren't cached
+		std::vector<std::size_t> missed;
+		std::vector<Attribute::ValueIndex> missedValues;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const auto* instanceValues = values + i * _num_attributes;
+			if (!_cache.find(instanceValues, out[i]))
+			{
+				missed.push_back(i);
+				missedValues.insert(missedValues.end(), instanceValues, instanceValues + _num_attributes);
+			}
+		}
+
+		if (missed.empty())
+		{
+			return;
+		}
+
+		const auto generation = _cache.generation();
+		const auto model = std::atomic_load(&_model);
+		std::vector<ClassIndex> missedClasses(missed.size());
+		model->classify_batch(missedValues.data(), missed.size(), missedClasses.data());
+
+		for (std::size_t i = 0; i < missed.size(); ++i)
+		{
+			out[missed[i]] = missedClasses[i];
+			_cache.insert(&missedValues[i * _num_attributes], missedClasses[i], generation);
+		}
+	}
+
+	void CachedModel::retrain(std::shared_ptr<const Model> model)
+	{
+		// Replace the model before invalidating, so anything classified under the new generation used the new model
+		std::atomic_store(&_model, std::move(model));
+		_cache.invalidate();
+	}
+}
@@ -0,0 +1,485 @@
+// Profiler.cpp - Will Cassella
+
+#include "../include/Profiler.h"
+
+#if ML_ENABLE_PROFILING
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <ostream>
+#endif
+
+#if ML_ENABLE_PERF_EVENTS
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace ml
+{
+	namespace profiler
+	{
+		const char* phase_name(Phase phase)
+		{
+			switch (phase)
+			{
+			case Phase::Load:
+				return "load";
+			case Phase::CPCacheBuild:
+				return "cp_cache_build";
+			case Phase::Classify:
+				return "classify";
+			case Phase::TopK:
+				return "top_k";
+			case Phase::ID3Recurse:
+				return "id3_recurse";
+			case Phase::SplitEvaluation:
+				return "split_evaluation";
+			case Phase::Prune:
+				return "prune";
+			case Phase::Condense:
+				return "condense";
+			case Phase::Select:
+				return "select";
+			default:
+				return "unknown";
+			}
+		}
+
+		const char* counter_name(Counter counter)
+		{
+			switch (counter)
+			{
+			case Counter::NodesBuilt:
+				return "nodes_built";
+			case Counter::DistanceEvaluations:
+				return "distance_evaluations";
+			case Counter::Allocations:
+				return "allocations";
+			case Counter::BytesAllocated:
+				return "bytes_allocated";
+			default:
+				return "unknown";
+			}
+		}
+
+#if ML_ENABLE_PROFILING
+
+		namespace
+		{
+			constexpr std::size_t NUM_PHASES = static_cast<std::size_t>(Phase::NUM_PHASES);
+			constexpr std::size_t NUM_COUNTERS = static_cast<std::size_t>(Counter::NUM_COUNTERS);
+			constexpr std::size_t NUM_HARDWARE_COUNTERS = 3;
+
+			/* A counter that is only ever written by one thread, but may be read by the reporting thread. */
+			struct ThreadCounter
+			{
+				void add(std::uint64_t amount)
+				{
+					// Only the owning thread writes, so this doesn't need to be an atomic read-modify-write
+					value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+				}
+
+				std::uint64_t get() const
+				{
+					return value.load(std::memory_order_relaxed);
+				}
+
+				std::atomic<std::uint64_t> value{ 0 };
+			};
+
+			struct PhaseData
+			{
+				ThreadCounter calls;
+				ThreadCounter nanoseconds;
+				ThreadCounter hardware[NUM_HARDWARE_COUNTERS];
+			};
+
+			/**
+			 * \brief Profiling data for a single thread.
+			 * These are never freed, since the threads created by 'std::async' exit before the report is written.
+			 * Instead, they're handed to the next thread that starts once their thread exits.
+			 */
+			struct ThreadData
+			{
+				PhaseData phases[NUM_PHASES];
+				ThreadCounter counters[NUM_COUNTERS];
+
+				/* How deeply nested each phase currently is on this thread. */
+				unsigned int depth[NUM_PHASES] = {};
+
+				/* The perf event group for this thread, -1 if not opened (or unavailable). */
+				int perf_fds[NUM_HARDWARE_COUNTERS] = { -1, -1, -1 };
+				bool perf_opened = false;
+
+				/* Whether a running thread currently owns this data. */
+				bool in_use = true;
+			};
+
+			std::atomic<bool> hardware_counters_enabled{ false };
+
+			std::mutex& registry_mutex()
+			{
+				static std::mutex mutex;
+				return mutex;
+			}
+
+			std::vector<ThreadData*>& registry()
+			{
+				static std::vector<ThreadData*> threads;
+				return threads;
+			}
+
+			void close_perf_events(ThreadData& data);
+
+			/* Owns the calling thread's data, and releases it back to the registry when the thread exits. */
+			struct ThreadDataHandle
+			{
+				~ThreadDataHandle();
+
+				ThreadData* data = nullptr;
+			};
+
+			thread_local ThreadDataHandle thread_handle;
+
+			/* Set once the calling thread's handle has been destroyed, so late allocations during thread exit aren't counted. */
+			thread_local bool thread_exited = false;
+
+			ThreadDataHandle::~ThreadDataHandle()
+			{
+				thread_exited = true;
+
+				if (data != nullptr)
+				{
+					close_perf_events(*data);
+
+					std::lock_guard<std::mutex> lock{ registry_mutex() };
+					data->in_use = false;
+				}
+			}
+
+			ThreadData& get_thread_data()
+			{
+				auto& handle = thread_handle;
+				if (handle.data == nullptr)
+				{
+					std::lock_guard<std::mutex> lock{ registry_mutex() };
+
+					// Try to reuse the data of a thread that has exited
+					for (auto* data : registry())
+					{
+						if (!data->in_use)
+						{
+							data->in_use = true;
+							handle.data = data;
+							return *data;
+						}
+					}
+
+					// Allocated with malloc so that the counting 'operator new' doesn't recurse into here
+					handle.data = new (std::malloc(sizeof(ThreadData))) ThreadData();
+					registry().push_back(handle.data);
+				}
+
+				return *handle.data;
+			}
+
+			std::uint64_t now_ns()
+			{
+				using namespace std::chrono;
+				return static_cast<std::uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+			}
+
+#if ML_ENABLE_PERF_EVENTS
+
+			int open_perf_event(std::uint64_t config, int groupFd)
+			{
+				perf_event_attr attr = {};
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.size = sizeof(attr);
+				attr.config = config;
+				attr.disabled = groupFd == -1 ? 1 : 0;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP;
+
+				return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+			}
+
+			/* Opens the cycle, cache miss and branch miss counters for the calling thread. */
+			void open_thread_perf_events(ThreadData& data)
+			{
+				data.perf_opened = true;
+
+				const std::uint64_t configs[NUM_HARDWARE_COUNTERS] = {
+					PERF_COUNT_HW_CPU_CYCLES,
+					PERF_COUNT_HW_CACHE_MISSES,
+					PERF_COUNT_HW_BRANCH_MISSES
+				};
+
+				for (std::size_t i = 0; i < NUM_HARDWARE_COUNTERS; ++i)
+				{
+					data.perf_fds[i] = open_perf_event(configs[i], data.perf_fds[0]);
+					if (data.perf_fds[i] == -1)
+					{
+						// Close the ones we did manage to open, and give up on this thread
+						for (std::size_t j = 0; j < i; ++j)
+						{
+							close(data.perf_fds[j]);
+							data.perf_fds[j] = -1;
+						}
+						return;
+					}
+				}
+
+				ioctl(data.perf_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+				ioctl(data.perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+			}
+
+			void close_perf_events(ThreadData& data)
+			{
+				for (auto& fd : data.perf_fds)
+				{
+					if (fd != -1)
+					{
+						close(fd);
+						fd = -1;
+					}
+				}
+
+				data.perf_opened = false;
+			}
+
+			/* Reads the current values of the hardware counters for the calling thread, returns false if they're unavailable. */
+			bool read_hardware_counters(ThreadData& data, std::uint64_t* out)
+			{
+				if (!hardware_counters_enabled.load(std::memory_order_relaxed))
+				{
+					return false;
+				}
+
+				if (!data.perf_opened)
+				{
+					open_thread_perf_events(data);
+				}
+
+				if (data.perf_fds[0] == -1)
+				{
+					return false;
+				}
+
+				struct
+				{
+					std::uint64_t nr;
+					std::uint64_t values[NUM_HARDWARE_COUNTERS];
+				} group;
+
+				if (read(data.perf_fds[0], &group, sizeof(group)) != static_cast<ssize_t>(sizeof(group)))
+				{
+					return false;
+				}
+
+				for (std::size_t i = 0; i < NUM_HARDWARE_COUNTERS; ++i)
+				{
+					out[i] = group.values[i];
+				}
+
+				return true;
+			}
+
+#else
+
+			void close_perf_events(ThreadData& /*data*/)
+			{
+			}
+
+			bool read_hardware_counters(ThreadData& /*data*/, std::uint64_t* /*out*/)
+			{
+				return false;
+			}
+
+#endif
+		}
+
+		void add(Counter counter, std::uint64_t amount)
+		{
+			if (thread_exited)
+			{
+				return;
+			}
+
+			get_thread_data().counters[static_cast<std::size_t>(counter)].add(amount);
+		}
+
+		bool enable_hardware_counters()
+		{
+#if ML_ENABLE_PERF_EVENTS
+			// Check that we can actually open the counters here before turning them on everywhere
+			ThreadData& data = get_thread_data();
+			hardware_counters_enabled = true;
+
+			std::uint64_t values[NUM_HARDWARE_COUNTERS];
+			if (!read_hardware_counters(data, values))
+			{
+				hardware_counters_enabled = false;
+			}
+
+			return hardware_counters_enabled;
+#else
+			return false;
+#endif
+		}
+
+		void write_report(std::ostream& out, const char* label)
+		{
+			static const char* const HARDWARE_NAMES[NUM_HARDWARE_COUNTERS] = { "cycles", "cache_misses", "branch_misses" };
+
+			std::uint64_t calls[NUM_PHASES] = {};
+			std::uint64_t nanoseconds[NUM_PHASES] = {};
+			std::uint64_t hardware[NUM_PHASES][NUM_HARDWARE_COUNTERS] = {};
+			std::uint64_t counters[NUM_COUNTERS] = {};
+
+			{
+				std::lock_guard<std::mutex> lock{ registry_mutex() };
+				for (const auto* data : registry())
+				{
+					for (std::size_t p = 0; p < NUM_PHASES; ++p)
+					{
+						calls[p] += data->phases[p].calls.get();
+						nanoseconds[p] += data->phases[p].nanoseconds.get();
+
+						for (std::size_t h = 0; h < NUM_HARDWARE_COUNTERS; ++h)
+						{
+							hardware[p][h] += data->phases[p].hardware[h].get();
+						}
+					}
+
+					for (std::size_t c = 0; c < NUM_COUNTERS; ++c)
+					{
+						counters[c] += data->counters[c].get();
+					}
+				}
+			}
+
+			out << "{\"label\":\"" << label << "\",\"phases\":{";
+			for (std::size_t p = 0; p < NUM_PHASES; ++p)
+			{
+				out << (p == 0 ? "" : ",") << '"' << phase_name(static_cast<Phase>(p)) << "\":{";
+				out << "\"calls\":" << calls[p] << ",\"seconds\":" << nanoseconds[p] / 1e9;
+
+				if (hardware_counters_enabled)
+				{
+					for (std::size_t h = 0; h < NUM_HARDWARE_COUNTERS; ++h)
+					{
+						out << ",\"" << HARDWARE_NAMES[h] << "\":" << hardware[p][h];
+					}
+				}
+
+				out << '}';
+			}
+
+			out << "},\"counters\":{";
+			for (std::size_t c = 0; c < NUM_COUNTERS; ++c)
+			{
+				out << (c == 0 ? "" : ",") << '"' << counter_name(static_cast<Counter>(c)) << "\":" << counters[c];
+			}
+			out << "}}\n";
+		}
+
+		void reset()
+		{
+			std::lock_guard<std::mutex> lock{ registry_mutex() };
+			for (auto* data : registry())
+			{
+				for (auto& phase : data->phases)
+				{
+					phase.calls.value = 0;
+					phase.nanoseconds.value = 0;
+
+					for (auto& hardware : phase.hardware)
+					{
+						hardware.value = 0;
+					}
+				}
+
+				for (auto& counter : data->counters)
+				{
+					counter.value = 0;
+				}
+			}
+		}
+
+		ScopedTimer::ScopedTimer(Phase phase)
+			: _phase(phase)
+		{
+			auto& data = get_thread_data();
+			_outermost = data.depth[static_cast<std::size_t>(phase)]++ == 0;
+
+			if (_outermost)
+			{
+				_hardware = read_hardware_counters(data, _start_hw);
+				_start_ns = now_ns();
+			}
+		}
+
+		ScopedTimer::~ScopedTimer()
+		{
+			const auto endNs = now_ns();
+			auto& data = get_thread_data();
+			auto& phase = data.phases[static_cast<std::size_t>(_phase)];
+
+			data.depth[static_cast<std::size_t>(_phase)] -= 1;
+			phase.calls.add(1);
+
+			if (!_outermost)
+			{
+				return;
+			}
+
+			phase.nanoseconds.add(endNs - _start_ns);
+
+			std::uint64_t endHw[NUM_HARDWARE_COUNTERS];
+			if (_hardware && read_hardware_counters(data, endHw))
+			{
+				for (std::size_t h = 0; h < NUM_HARDWARE_COUNTERS; ++h)
+				{
+					phase.hardware[h].add(endHw[h] - _start_hw[h]);
+				}
+			}
+		}
+
+#endif
+	}
+}
+
+#if ML_ENABLE_PROFILING
+
+/* Count every allocation made by the program. */
+void* operator new(std::size_t size)
+{
+	ML_PROFILE_COUNT(Allocations, 1);
+	ML_PROFILE_COUNT(BytesAllocated, size);
+
+	if (void* result = std::malloc(size == 0 ? 1 : size))
+	{
+		return result;
+	}
+
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /*size*/) noexcept
+{
+	std::free(ptr);
+}
+
+#endif
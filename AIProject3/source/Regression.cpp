@@ -0,0 +1,396 @@
+// Regression.cpp - Will Cassella
+
+#include <map>
+#include <cmath>
+#include <ctime>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include "../include/Regression.h"
+#include "../include/Profiler.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace ml
+{
+	namespace
+	{
+		/* How many standard errors apart the accuracies of two cross validations may be before they're considered different. */
+		constexpr double BASELINE_STANDARD_ERRORS = 3.0;
+
+		struct ResultsFile
+		{
+			const char* dataset;
+			const char* file;
+		};
+
+		/* The results file of each dataset, which are named after the data files rather than the datasets. */
+		const ResultsFile RESULTS_FILES[] = {
+			{ "breast-cancer", "breast-cancer-wisconson.result.txt" },
+			{ "glass", "glass.result.txt" },
+			{ "house-votes", "house-votes-84.result.txt" },
+			{ "iris", "iris.result.txt" },
+			{ "soybean", "soybean.result.txt" }
+		};
+
+		/* The accuracy a run is expected to have, and how far from it it may be. */
+		struct Expected
+		{
+			double accuracy = 0;
+			double tolerance = 0;
+		};
+
+		/**
+		 * \brief Reads the expected accuracy of each algorithm from a results file.
+		 * Each algorithm's section starts with its display name, followed by the accuracy of each fold and the average accuracy.
+		 * The tolerance is how much two cross validations would be expected to differ, given how much the accuracy varied between the folds.
+		 * \param path The path of the results file.
+		 * \param minTolerance The smallest tolerance to allow.
+		 * \return The expected accuracy of each algorithm in the file, by display name. Empty if the file couldn't be read.
+		 */
+		std::map<std::string, Expected> read_results_file(const std::string& path, double minTolerance)
+		{
+			std::map<std::string, Expected> result;
+			std::ifstream in{ path };
+			std::string line;
+			std::string algorithm;
+			std::vector<double> foldAccuracies;
+
+			while (std::getline(in, line))
+			{
+				if (!line.empty() && line.back() == '\r')
+				{
+					line.pop_back();
+				}
+
+				if (line.compare(0, 10, "Accuracy: ") == 0)
+				{
+					foldAccuracies.push_back(std::atof(line.c_str() + 10));
+				}
+				else if (line.compare(0, 18, "Average accuracy: ") == 0 && !foldAccuracies.empty())
+				{
+					double mean = 0;
+					for (auto accuracy : foldAccuracies)
+					{
+						mean += accuracy;
+					}
+					mean /= foldAccuracies.size();
+
+					double variance = 0;
+					for (auto accuracy : foldAccuracies)
+					{
+						variance += (accuracy - mean) * (accuracy - mean);
+					}
+					variance /= std::max<std::size_t>(foldAccuracies.size() - 1, 1);
+
+					// Both cross validations have this standard error, so their difference has sqrt(2) times it
+					Expected expected;
+					expected.accuracy = std::atof(line.c_str() + 18);
+					expected.tolerance = std::max(minTolerance, BASELINE_STANDARD_ERRORS * std::sqrt(2 * variance / foldAccuracies.size()));
+					result[algorithm] = expected;
+					foldAccuracies.clear();
+				}
+				else if (!line.empty() && line.back() == ':' && line[0] != ' ' && line.compare(0, 4, "Run ") != 0)
+				{
+					algorithm = line.substr(0, line.size() - 1);
+					foldAccuracies.clear();
+				}
+			}
+
+			return result;
+		}
+
+		/* Reads the number following '"key":' in the line, searching from 'from'. Returns false if there isn't one. */
+		bool read_number(const std::string& line, const std::string& key, std::size_t from, double& out)
+		{
+			const auto pattern = '"' + key + "\":";
+			const auto pos = line.find(pattern, from);
+			if (pos == std::string::npos)
+			{
+				return false;
+			}
+
+			out = std::atof(line.c_str() + pos + pattern.size());
+			return true;
+		}
+
+		/* Returns the position of the given run in a line of the history, or 'npos' if it isn't there. */
+		std::size_t find_run(const std::string& line, const RunSummary& run)
+		{
+			return line.find("{\"dataset\":\"" + run.dataset + "\",\"algorithm\":\"" + run.algorithm + '"');
+		}
+
+		/* Returns the most recent passing checks in the history file that were run the same way, oldest first. */
+		std::vector<std::string> read_history(const RegressionOptions& regression, const ExperimentOptions& options)
+		{
+			std::vector<std::string> result;
+			std::ifstream in{ regression.history_path };
+			std::string line;
+
+			while (std::getline(in, line))
+			{
+				double seed = 0;
+				double folds = 0;
+				double threads = 0;
+				if (line.find("\"passed\":true") == std::string::npos
+					|| !read_number(line, "seed", 0, seed) || seed != regression.seed
+					|| !read_number(line, "folds", 0, folds) || folds != options.num_folds
+					|| !read_number(line, "threads", 0, threads) || threads != options.num_threads)
+				{
+					continue;
+				}
+
+				result.push_back(std::move(line));
+			}
+
+			if (result.size() > regression.history_window)
+			{
+				result.erase(result.begin(), result.end() - regression.history_window);
+			}
+
+			return result;
+		}
+
+		/* Returns the median of the values, or zero if there are none. */
+		double median(std::vector<double> values)
+		{
+			if (values.empty())
+			{
+				return 0;
+			}
+
+			std::sort(values.begin(), values.end());
+			const auto middle = values.size() / 2;
+			return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+		}
+
+		/* Returns the most memory the process has had resident at once, in kilobytes. */
+		double peak_rss_kb()
+		{
+#if defined(_WIN32)
+			PROCESS_MEMORY_COUNTERS counters;
+			if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			{
+				return 0;
+			}
+
+			return counters.PeakWorkingSetSize / 1024.0;
+#else
+			rusage usage;
+			if (getrusage(RUSAGE_SELF, &usage) != 0)
+			{
+				return 0;
+			}
+
+#if defined(__APPLE__)
+			// macOS reports bytes rather than kilobytes
+			return usage.ru_maxrss / 1024.0;
+#else
+			return static_cast<double>(usage.ru_maxrss);
+#endif
+#endif
+		}
+
+		/* Formats a percentage, optionally with a tolerance. */
+		std::string format_percent(double value, double tolerance = -1)
+		{
+			std::ostringstream out;
+			out << std::fixed << std::setprecision(2) << value << '%';
+			if (tolerance >= 0)
+			{
+				out << " +/- " << tolerance;
+			}
+
+			return out.str();
+		}
+	}
+
+	bool run_regression(
+		const std::vector<NamedDataSet>& datasets,
+		const ExperimentOptions& options,
+		const RegressionOptions& regression,
+		std::ostream& out)
+	{
+		// Read what the runs are checked against
+		std::map<std::string, std::map<std::string, Expected>> baselines;
+		for (const auto& dataset : datasets)
+		{
+			for (const auto& file : RESULTS_FILES)
+			{
+				if (dataset.first == file.dataset)
+				{
+					baselines[dataset.first] = read_results_file(regression.results_dir + '/' + file.file, regression.accuracy_tolerance);
+				}
+			}
+		}
+
+		const auto history = read_history(regression, options);
+
+		// Run the experiment with the same seed each time, keeping the fastest time of each run
+		std::vector<RunSummary> runs;
+		std::ostringstream discard;
+		std::ostringstream profile;
+
+		for (std::size_t repetition = 0; repetition < std::max<std::size_t>(regression.repetitions, 1); ++repetition)
+		{
+			std::srand(regression.seed);
+			std::vector<RunSummary> summaries;
+			if (!run_experiment(datasets, options, discard, Verbosity::None, ReportFormat::Text, repetition == 0 ? &profile : nullptr, &summaries))
+			{
+				return false;
+			}
+
+			if (runs.empty())
+			{
+				runs = std::move(summaries);
+				continue;
+			}
+
+			for (std::size_t i = 0; i < runs.size(); ++i)
+			{
+				runs[i].seconds = std::min(runs[i].seconds, summaries[i].seconds);
+			}
+		}
+
+		// Check each run
+		std::size_t datasetWidth = 7;
+		std::size_t algorithmWidth = 9;
+		for (const auto& run : runs)
+		{
+			datasetWidth = std::max(datasetWidth, run.dataset.size());
+			algorithmWidth = std::max(algorithmWidth, run.display_name.size());
+		}
+
+		out << std::left << std::setw(datasetWidth + 2) << "Dataset" << std::setw(algorithmWidth + 2) << "Algorithm";
+		out << std::setw(10) << "Accuracy" << std::setw(20) << "Expected" << std::setw(18) << "Instances/s" << std::setw(18) << "Recent median" << "Status\n";
+
+		bool passed = true;
+		for (const auto& run : runs)
+		{
+			// The expected accuracy comes from the results file, or failing that the last passing check
+			Expected expected;
+			bool hasExpected = false;
+
+			const auto baseline = baselines[run.dataset].find(run.display_name);
+			if (baseline != baselines[run.dataset].end())
+			{
+				expected = baseline->second;
+				hasExpected = true;
+			}
+			else if (!history.empty() && find_run(history.back(), run) != std::string::npos)
+			{
+				hasExpected = read_number(history.back(), "accuracy", find_run(history.back(), run), expected.accuracy);
+				expected.tolerance = regression.accuracy_tolerance;
+			}
+
+			std::vector<double> recentThroughputs;
+			for (const auto& line : history)
+			{
+				double throughput;
+				const auto pos = find_run(line, run);
+				if (pos != std::string::npos && read_number(line, "instances_per_second", pos, throughput))
+				{
+					recentThroughputs.push_back(throughput);
+				}
+			}
+
+			const auto throughput = run.seconds > 0 ? run.num_instances / run.seconds : 0;
+			const auto recentThroughput = median(recentThroughputs);
+
+			std::string status;
+			if (hasExpected && std::abs(run.accuracy - expected.accuracy) > expected.tolerance)
+			{
+				status += "accuracy ";
+			}
+			if (recentThroughput > 0 && throughput < recentThroughput * (1 - regression.threshold))
+			{
+				status += "throughput ";
+			}
+
+			passed = passed && status.empty();
+
+			out << std::setw(datasetWidth + 2) << run.dataset << std::setw(algorithmWidth + 2) << run.display_name;
+			out << std::setw(10) << format_percent(run.accuracy);
+			out << std::setw(20) << (hasExpected ? format_percent(expected.accuracy, expected.tolerance) : "-");
+			out << std::setw(18) << static_cast<std::uint64_t>(throughput);
+			out << std::setw(18) << (recentThroughput > 0 ? std::to_string(static_cast<std::uint64_t>(recentThroughput)) : "-");
+			out << (status.empty() ? "ok" : "REGRESSED: " + status) << '\n';
+		}
+
+		// Check the memory used by the whole process
+		std::vector<double> recentPeaks;
+		for (const auto& line : history)
+		{
+			double peak;
+			if (read_number(line, "peak_rss_kb", 0, peak))
+			{
+				recentPeaks.push_back(peak);
+			}
+		}
+
+		const auto peak = peak_rss_kb();
+		const auto recentPeak = median(recentPeaks);
+		const bool memoryRegressed = recentPeak > 0 && peak > recentPeak * (1 + regression.threshold);
+		passed = passed && !memoryRegressed;
+
+		out << std::right << "Peak resident memory: " << static_cast<std::uint64_t>(peak) << " KB";
+		if (recentPeak > 0)
+		{
+			out << " (recent median " << static_cast<std::uint64_t>(recentPeak) << " KB)";
+		}
+		out << (memoryRegressed ? ", REGRESSED\n" : "\n");
+		out << (passed ? "Regression check passed\n" : "Regression check FAILED\n");
+		out.flush();
+
+		// Record this check, whether or not it passed
+		std::ofstream historyOut{ regression.history_path, std::ios::out | std::ios::app };
+		historyOut << "{\"time\":" << static_cast<std::uint64_t>(std::time(nullptr)) << ",\"seed\":" << regression.seed;
+		historyOut << ",\"folds\":" << options.num_folds << ",\"threads\":" << options.num_threads << ",\"repetitions\":" << regression.repetitions;
+		historyOut << ",\"passed\":" << (passed ? "true" : "false") << ",\"peak_rss_kb\":" << static_cast<std::uint64_t>(peak) << ",\"runs\":[";
+
+		for (std::size_t i = 0; i < runs.size(); ++i)
+		{
+			const auto& run = runs[i];
+			historyOut << (i == 0 ? "" : ",") << "{\"dataset\":\"" << run.dataset << "\",\"algorithm\":\"" << run.algorithm << '"';
+			historyOut << ",\"accuracy\":" << run.accuracy << ",\"seconds\":" << run.seconds;
+			historyOut << ",\"instances_per_second\":" << (run.seconds > 0 ? run.num_instances / run.seconds : 0) << '}';
+		}
+		historyOut << ']';
+
+		// The profiling reports (one JSON object per line, for loading and each run) are only written if profiling was compiled in
+		std::istringstream profileReports{ profile.str() };
+		std::string profileReport;
+		bool firstReport = true;
+		while (std::getline(profileReports, profileReport))
+		{
+			profileReport.erase(profileReport.find_last_not_of(" \r") + 1);
+			if (profileReport.empty())
+			{
+				continue;
+			}
+
+			historyOut << (firstReport ? ",\"profile\":[" : ",") << profileReport;
+			firstReport = false;
+		}
+		historyOut << (firstReport ? "}\n" : "]}\n");
+
+		if (!historyOut)
+		{
+			out << "Could not write to the history file '" << regression.history_path << "'\n";
+		}
+
+		return passed;
+	}
+}
@@ -0,0 +1,398 @@
+// Results.cpp - Will Cassella
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include "../include/Results.h"
+
+namespace ml
+{
+	namespace
+	{
+		/* Writes the given confusion matrix as a JSON array of rows. */
+		void write_json_matrix(std::ostream& out, const ConfusionMatrix& matrix)
+		{
+			out << '[';
+			for (ClassIndex actual = 0; actual < matrix.num_classes(); ++actual)
+			{
+				out << (actual == 0 ? "[" : ",[");
+				for (ClassIndex predicted = 0; predicted < matrix.num_classes(); ++predicted)
+				{
+					out << (predicted == 0 ? "" : ",") << matrix.count(actual, predicted);
+				}
+				out << ']';
+			}
+			out << ']';
+		}
+	}
+
+	void FoldResult::record(Instance instance, ClassIndex predicted)
+	{
+		_confusion.record(instance.get_class(), predicted);
+
+		if (_verbosity < Verbosity::Instances)
+		{
+			return;
+		}
+
+		switch (_format)
+		{
+		case ReportFormat::Text:
+			_instance_log << "    Classified '";
+			instance.print(_instance_log);
+			_instance_log << "' as '" << _dataset->class_name(predicted);
+			_instance_log << "', actual class: '" << _dataset->class_name(instance.get_class()) << "'\n";
+			break;
+
+		case ReportFormat::CSV:
+			// The prefix of the row (kind, dataset, algorithm, fold) is written by the sink
+			_instance_log << ',' << instance.index() << ',';
+			write_csv_field(_instance_log, _dataset->class_name(instance.get_class()));
+			_instance_log << ',';
+			write_csv_field(_instance_log, _dataset->class_name(predicted));
+			_instance_log << ",\n";
+			break;
+
+		case ReportFormat::JSON:
+			_instance_log << (_first_instance ? "" : ",") << "{\"index\":" << instance.index() << ",\"actual\":";
+			write_json_string(_instance_log, _dataset->class_name(instance.get_class()));
+			_instance_log << ",\"predicted\":";
+			write_json_string(_instance_log, _dataset->class_name(predicted));
+			_instance_log << '}';
+			break;
+		}
+
+		_first_instance = false;
+	}
+
+	void FoldResult::serialize(std::string& out) const
+	{
+		// The count of each (actual, predicted) pair, followed by the instance log
+		for (ClassIndex actual = 0; actual < _confusion.num_classes(); ++actual)
+		{
+			for (ClassIndex predicted = 0; predicted < _confusion.num_classes(); ++predicted)
+			{
+				const std::uint64_t count = _confusion.count(actual, predicted);
+				out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+			}
+		}
+
+		out += _instance_log.str();
+	}
+
+	bool FoldResult::deserialize(const char* data, std::size_t size)
+	{
+		const auto numClasses = _dataset->num_classes();
+		const auto countsSize = numClasses * numClasses * sizeof(std::uint64_t);
+		if (size < countsSize)
+		{
+			return false;
+		}
+
+		_confusion = ConfusionMatrix{ numClasses };
+		for (ClassIndex actual = 0; actual < numClasses; ++actual)
+		{
+			for (ClassIndex predicted = 0; predicted < numClasses; ++predicted)
+			{
+				std::uint64_t count;
+				std::memcpy(&count, data + (actual * numClasses + predicted) * sizeof(count), sizeof(count));
+				_confusion.record(actual, predicted, static_cast<std::size_t>(count));
+			}
+		}
+
+		_instance_log.str(std::string{ data + countsSize, size - countsSize });
+		_instance_log.seekp(0, std::ios::end);
+		_first_instance = size == countsSize;
+		return true;
+	}
+
+	ResultSink::ResultSink(std::ostream& out, Verbosity verbosity, ReportFormat format, bool writeCsvHeader)
+		: _out(&out),
+		_verbosity(verbosity),
+		_format(format),
+		_wrote_csv_header(!writeCsvHeader)
+	{
+	}
+
+	void ResultSink::begin(const DataSet& dataset, std::string datasetName, std::string algorithmName, std::size_t numFolds)
+	{
+		_dataset = &dataset;
+		_dataset_name = std::move(datasetName);
+		_algorithm_name = std::move(algorithmName);
+
+		_folds.clear();
+		_folds.resize(numFolds);
+
+		for (auto& fold : _folds)
+		{
+			fold._dataset = &dataset;
+			fold._verbosity = _verbosity;
+			fold._format = _format;
+			fold._confusion = ConfusionMatrix{ dataset.num_classes() };
+		}
+	}
+
+	ConfusionMatrix ResultSink::end()
+	{
+		// Merge the per-fold counters, now that all folds are done
+		ConfusionMatrix total{ _dataset->num_classes() };
+		float averageAccuracy = 0.f;
+
+		for (const auto& fold : _folds)
+		{
+			total.merge(fold._confusion);
+			averageAccuracy += fold._confusion.accuracy() * 100;
+		}
+
+		if (!_folds.empty())
+		{
+			averageAccuracy /= _folds.size();
+		}
+
+		if (_verbosity == Verbosity::None)
+		{
+			return total;
+		}
+
+		switch (_format)
+		{
+		case ReportFormat::Text:
+			write_text(total, averageAccuracy);
+			break;
+
+		case ReportFormat::CSV:
+			write_csv(total, averageAccuracy);
+			break;
+
+		case ReportFormat::JSON:
+			write_json(total, averageAccuracy);
+			break;
+		}
+
+		_out->flush();
+		return total;
+	}
+
+	void ResultSink::write_text(const ConfusionMatrix& total, float averageAccuracy)
+	{
+		auto& out = *_out;
+		out << _algorithm_name << " (" << _dataset_name << "):\n";
+
+		if (_verbosity >= Verbosity::Folds)
+		{
+			for (std::size_t i = 0; i < _folds.size(); ++i)
+			{
+				out << "Run " << i << ":\n";
+				out << _folds[i]._instance_log.str();
+				out << "Accuracy: " << _folds[i]._confusion.accuracy() * 100 << "%\n";
+			}
+		}
+
+		out << "Average accuracy: " << averageAccuracy << "%\n";
+
+		// Print the confusion matrix, with a row for each actual class
+		out << "Confusion matrix (rows are actual, columns are predicted):\n";
+		for (ClassIndex actual = 0; actual < total.num_classes(); ++actual)
+		{
+			out << "    " << _dataset->class_name(actual) << ':';
+			for (ClassIndex predicted = 0; predicted < total.num_classes(); ++predicted)
+			{
+				out << ' ' << total.count(actual, predicted);
+			}
+			out << '\n';
+		}
+		out << '\n';
+	}
+
+	void ResultSink::write_csv(const ConfusionMatrix& total, float averageAccuracy)
+	{
+		auto& out = *_out;
+
+		if (!_wrote_csv_header)
+		{
+			out << "kind,dataset,algorithm,fold,index,actual,predicted,value\n";
+			_wrote_csv_header = true;
+		}
+
+		std::ostringstream prefixStream;
+		write_csv_field(prefixStream, _dataset_name);
+		prefixStream << ',';
+		write_csv_field(prefixStream, _algorithm_name);
+		prefixStream << ',';
+		const auto prefix = prefixStream.str();
+
+		auto writeMatrix = [&](const ConfusionMatrix& matrix, const std::string& fold)
+		{
+			for (ClassIndex actual = 0; actual < matrix.num_classes(); ++actual)
+			{
+				for (ClassIndex predicted = 0; predicted < matrix.num_classes(); ++predicted)
+				{
+					out << "confusion," << prefix << fold << ",,";
+					write_csv_field(out, _dataset->class_name(actual));
+					out << ',';
+					write_csv_field(out, _dataset->class_name(predicted));
+					out << ',' << matrix.count(actual, predicted) << '\n';
+				}
+			}
+		};
+
+		if (_verbosity >= Verbosity::Folds)
+		{
+			for (std::size_t i = 0; i < _folds.size(); ++i)
+			{
+				const auto& fold = _folds[i];
+
+				// Each buffered instance row is missing its prefix
+				if (_verbosity >= Verbosity::Instances)
+				{
+					const auto log = fold._instance_log.str();
+					std::size_t start = 0;
+					while (start < log.size())
+					{
+						const auto end = log.find('\n', start);
+						out << "instance," << prefix << i;
+						out.write(log.data() + start, end - start + 1);
+						start = end + 1;
+					}
+				}
+
+				writeMatrix(fold._confusion, std::to_string(i));
+				out << "accuracy," << prefix << i << ",,,," << fold._confusion.accuracy() * 100 << '\n';
+			}
+		}
+
+		writeMatrix(total, "all");
+		out << "accuracy," << prefix << "all,,,," << averageAccuracy << '\n';
+	}
+
+	void ResultSink::write_json(const ConfusionMatrix& total, float averageAccuracy)
+	{
+		auto& out = *_out;
+
+		// Each run is written as a single line, so reports may be concatenated
+		out << "{\"dataset\":";
+		write_json_string(out, _dataset_name);
+		out << ",\"algorithm\":";
+		write_json_string(out, _algorithm_name);
+		out << ",\"classes\":[";
+		for (ClassIndex i = 0; i < _dataset->num_classes(); ++i)
+		{
+			out << (i == 0 ? "" : ",");
+			write_json_string(out, _dataset->class_name(i));
+		}
+		out << ']';
+
+		if (_verbosity >= Verbosity::Folds)
+		{
+			out << ",\"folds\":[";
+			for (std::size_t i = 0; i < _folds.size(); ++i)
+			{
+				const auto& fold = _folds[i];
+				out << (i == 0 ? "" : ",") << "{\"fold\":" << i;
+				out << ",\"correct\":" << fold._confusion.num_correct();
+				out << ",\"total\":" << fold._confusion.num_total();
+				out << ",\"accuracy\":" << fold._confusion.accuracy() * 100;
+				out << ",\"confusion\":";
+				write_json_matrix(out, fold._confusion);
+
+				if (_verbosity >= Verbosity::Instances)
+				{
+					out << ",\"instances\":[" << fold._instance_log.str() << ']';
+				}
+				out << '}';
+			}
+			out << ']';
+		}
+
+		out << ",\"correct\":" << total.num_correct();
+		out << ",\"total\":" << total.num_total();
+		out << ",\"accuracy\":" << averageAccuracy;
+		out << ",\"confusion\":";
+		write_json_matrix(out, total);
+		out << "}\n";
+	}
+
+	bool parse_verbosity(const std::string& name, Verbosity& out)
+	{
+		if (name == "none")
+		{
+			out = Verbosity::None;
+		}
+		else if (name == "summary")
+		{
+			out = Verbosity::Summary;
+		}
+		else if (name == "folds")
+		{
+			out = Verbosity::Folds;
+		}
+		else if (name == "instances")
+		{
+			out = Verbosity::Instances;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	void write_json_string(std::ostream& out, const std::string& str)
+	{
+		out << '"';
+		for (auto c : str)
+		{
+			if (c == '"' || c == '\\')
+			{
+				out << '\\';
+			}
+
+			out << c;
+		}
+		out << '"';
+	}
+
+	void write_csv_field(std::ostream& out, const std::string& str)
+	{
+		if (str.find_first_of(",\"\r\n") == std::string::npos)
+		{
+			out << str;
+			return;
+		}
+
+		out << '"';
+		for (auto c : str)
+		{
+			if (c == '"')
+			{
+				out << '"';
+			}
+
+			out << c;
+		}
+		out << '"';
+	}
+
+	bool parse_report_format(const std::string& name, ReportFormat& out)
+	{
+		if (name == "text")
+		{
+			out = ReportFormat::Text;
+		}
+		else if (name == "csv")
+		{
+			out = ReportFormat::CSV;
+		}
+		else if (name == "json")
+		{
+			out = ReportFormat::JSON;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,600 @@
+// Server.cpp - Will Cassella
+
+#include <map>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include "../include/Server.h"
+#include "../include/Model.h"
+#include "../include/Inference.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ML_UNIX_SOCKETS 1
+#include <cerrno>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#else
+#define ML_UNIX_SOCKETS 0
+#endif
+
+namespace ml
+{
+	namespace server
+	{
+		namespace
+		{
+			/* The number of request latencies remembered for computing percentiles. */
+			constexpr std::size_t MAX_LATENCY_SAMPLES = 1 << 20;
+
+			/* A response that's waiting to be written, in request order. */
+			struct PendingResponse
+			{
+				enum class Kind
+				{
+					Class,
+					Text,
+					Stats,
+					End
+				};
+
+				Kind kind;
+				std::future<ClassIndex> result;
+				std::string text;
+			};
+
+			/**
+			 * \brief Serves requests read with 'readLine' until it returns false or "quit" (or "shutdown") is read, answering through 'writeLine'.
+			 * Responses are written by a separate thread, so the reader can keep submitting requests while earlier ones are classified.
+			 * \return Whether the connection asked for the whole server to shut down.
+			 */
+			bool serve_lines(
+				const DataSet& schema,
+				MicroBatcher& batcher,
+				const std::function<bool(std::string&)>& readLine,
+				const std::function<void(const std::string&, bool)>& writeLine)
+			{
+				std::mutex mutex;
+				std::condition_variable condition;
+				std::deque<PendingResponse> pending;
+
+				auto push = [&](PendingResponse response)
+				{
+					{
+						std::lock_guard<std::mutex> lock{ mutex };
+						pending.push_back(std::move(response));
+					}
+
+					condition.notify_one();
+				};
+
+				std::thread writer{ [&]()
+				{
+					while (true)
+					{
+						PendingResponse response;
+						bool more;
+						{
+							std::unique_lock<std::mutex> lock{ mutex };
+							condition.wait(lock, [&]() { return !pending.empty(); });
+							response = std::move(pending.front());
+							pending.pop_front();
+							more = !pending.empty();
+						}
+
+						std::string line;
+						switch (response.kind)
+						{
+						case PendingResponse::Kind::Class:
+							line = schema.class_name(response.result.get());
+							break;
+
+						case PendingResponse::Kind::Text:
+							line = std::move(response.text);
+							break;
+
+						case PendingResponse::Kind::Stats:
+						{
+							std::ostringstream stats;
+							stats << batcher.latency();
+							line = stats.str();
+							break;
+						}
+
+						case PendingResponse::Kind::End:
+							writeLine({}, true);
+							return;
+						}
+
+						// Only flush once we've caught up, so responses to pipelined requests are written together
+						writeLine(line, !more);
+					}
+				} };
+
+				bool shutdown = false;
+				std::string line;
+				std::vector<Attribute::ValueIndex> values;
+				std::string error;
+
+				while (readLine(line))
+				{
+					if (!line.empty() && line.back() == '\r')
+					{
+						line.pop_back();
+					}
+
+					if (line.empty())
+					{
+						continue;
+					}
+
+					if (line == "quit" || line == "shutdown")
+					{
+						shutdown = line == "shutdown";
+						break;
+					}
+
+					PendingResponse response;
+					if (line == "stats")
+					{
+						response.kind = PendingResponse::Kind::Stats;
+					}
+					else if (parse_instance(schema, line, values, error))
+					{
+						response.kind = PendingResponse::Kind::Class;
+						response.result = batcher.submit(values);
+					}
+					else
+					{
+						response.kind = PendingResponse::Kind::Text;
+						response.text = "error: " + error;
+					}
+
+					push(std::move(response));
+				}
+
+				PendingResponse end;
+				end.kind = PendingResponse::Kind::End;
+				push(std::move(end));
+				writer.join();
+
+				return shutdown;
+			}
+		}
+
+		std::ostream& operator<<(std::ostream& out, const LatencyStats& stats)
+		{
+			out << "requests: " << stats.num_requests << ", batches: " << stats.num_batches;
+			out << ", latency (us) p50: " << stats.p50 << ", p90: " << stats.p90 << ", p99: " << stats.p99 << ", max: " << stats.max;
+			return out;
+		}
+
+		MicroBatcher::MicroBatcher(const Model& model, ServerOptions options)
+			: _model(&model),
+			_options(options)
+		{
+			_thread = std::thread{ &MicroBatcher::run, this };
+		}
+
+		MicroBatcher::~MicroBatcher()
+		{
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				_stopping = true;
+			}
+
+			_condition.notify_all();
+			_thread.join();
+		}
+
+		std::future<ClassIndex> MicroBatcher::submit(std::vector<Attribute::ValueIndex> values)
+		{
+			Request request;
+			request.values = std::move(values);
+			request.submitted = Clock::now();
+			auto result = request.result.get_future();
+
+			bool batchFull;
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				_queue.push_back(std::move(request));
+				batchFull = _queue.size() == 1 || _queue.size() >= _options.max_batch_size;
+			}
+
+			// Only wake the batching thread when it has something new to do
+			if (batchFull)
+			{
+				_condition.notify_one();
+			}
+
+			return result;
+		}
+
+		LatencyStats MicroBatcher::latency() const
+		{
+			std::vector<double> latencies;
+			LatencyStats result;
+			{
+				std::lock_guard<std::mutex> lock{ _stats_mutex };
+				latencies = _latencies;
+				result.num_batches = _num_batches;
+			}
+
+			result.num_requests = latencies.size();
+			if (latencies.empty())
+			{
+				return result;
+			}
+
+			std::sort(latencies.begin(), latencies.end());
+			auto percentile = [&](double p)
+			{
+				return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+			};
+
+			result.p50 = percentile(0.5);
+			result.p90 = percentile(0.9);
+			result.p99 = percentile(0.99);
+			result.max = latencies.back();
+			return result;
+		}
+
+		void MicroBatcher::run()
+		{
+			std::vector<Request> batch;
+			std::vector<Attribute::ValueIndex> values;
+			std::vector<ClassIndex> classes;
+			std::size_t numLatencies = 0;
+
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock{ _mutex };
+					_condition.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+
+					if (_queue.empty())
+					{
+						return;
+					}
+
+					// Give more requests a chance to join the batch, up until the first request's deadline
+					const auto deadline = _queue.front().submitted + _options.max_batch_delay;
+					_condition.wait_until(lock, deadline, [this]() { return _stopping || _queue.size() >= _options.max_batch_size; });
+
+					const auto batchSize = std::min(_queue.size(), _options.max_batch_size);
+					for (std::size_t i = 0; i < batchSize; ++i)
+					{
+						batch.push_back(std::move(_queue.front()));
+						_queue.pop_front();
+					}
+				}
+
+				// Classify the whole batch at once
+				values.clear();
+				for (const auto& request : batch)
+				{
+					values.insert(values.end(), request.values.begin(), request.values.end());
+				}
+
+				classes.resize(batch.size());
+				_model->classify_batch(values.data(), batch.size(), classes.data());
+
+				const auto now = Clock::now();
+				for (std::size_t i = 0; i < batch.size(); ++i)
+				{
+					batch[i].result.set_value(classes[i]);
+				}
+
+				// Record the latencies, keeping a bounded number of samples
+				{
+					std::lock_guard<std::mutex> lock{ _stats_mutex };
+					_num_batches += 1;
+
+					for (const auto& request : batch)
+					{
+						const auto latency = std::chrono::duration<double, std::micro>(now - request.submitted).count();
+						if (_latencies.size() < MAX_LATENCY_SAMPLES)
+						{
+							_latencies.push_back(latency);
+						}
+						else
+						{
+							_latencies[numLatencies % MAX_LATENCY_SAMPLES] = latency;
+						}
+
+						numLatencies += 1;
+					}
+				}
+
+				batch.clear();
+			}
+		}
+
+		void serve_stream(const DataSet& schema, MicroBatcher& batcher, std::istream& in, std::ostream& out)
+		{
+			serve_lines(
+				schema,
+				batcher,
+				[&in](std::string& line) { return static_cast<bool>(std::getline(in, line)); },
+				[&out](const std::string& line, bool flush)
+				{
+					if (!line.empty())
+					{
+						out << line << '\n';
+					}
+
+					if (flush)
+					{
+						out.flush();
+					}
+				});
+		}
+
+#if ML_UNIX_SOCKETS
+
+		namespace
+		{
+			/* How long to wait before accepting again when out of descriptors, doubling each time it fails again. */
+			constexpr std::chrono::milliseconds MIN_ACCEPT_DELAY{ 10 };
+			constexpr std::chrono::milliseconds MAX_ACCEPT_DELAY{ 1000 };
+
+			/* Makes writing to a client that has disconnected fail with EPIPE, rather than raising SIGPIPE and killing the server. */
+			void disable_sigpipe(int fd)
+			{
+#if defined(SO_NOSIGPIPE)
+				int on = 1;
+				::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+				static_cast<void>(fd);
+#endif
+			}
+
+			/* Writes all of 'data' to the socket, returns false if the client has disconnected (or the write otherwise failed). */
+			bool send_all(int fd, const std::string& data)
+			{
+#if defined(MSG_NOSIGNAL)
+				constexpr int flags = MSG_NOSIGNAL;
+#else
+				constexpr int flags = 0;
+#endif
+
+				std::size_t written = 0;
+				while (written < data.size())
+				{
+					const auto result = ::send(fd, data.data() + written, data.size() - written, flags);
+					if (result == -1 && errno == EINTR)
+					{
+						continue;
+					}
+
+					// EPIPE or ECONNRESET when the client has gone
+					if (result <= 0)
+					{
+						return false;
+					}
+
+					written += static_cast<std::size_t>(result);
+				}
+
+				return true;
+			}
+
+			/* Reads lines from a socket. */
+			class SocketLineReader
+			{
+			public:
+
+				explicit SocketLineReader(int fd)
+					: _fd(fd)
+				{
+				}
+
+				bool read_line(std::string& line)
+				{
+					while (true)
+					{
+						const auto newline = _buffer.find('\n', _start);
+						if (newline != std::string::npos)
+						{
+							line.assign(_buffer, _start, newline - _start);
+							_start = newline + 1;
+							return true;
+						}
+
+						// Drop what's been consumed, and read some more
+						_buffer.erase(0, _start);
+						_start = 0;
+
+						char chunk[4096];
+						const auto numRead = ::read(_fd, chunk, sizeof(chunk));
+						if (numRead <= 0)
+						{
+							// Hand back a final unterminated line, if there is one
+							line = std::move(_buffer);
+							_buffer.clear();
+							return !line.empty();
+						}
+
+						_buffer.append(chunk, static_cast<std::size_t>(numRead));
+					}
+				}
+
+			private:
+
+				int _fd;
+				std::string _buffer;
+				std::size_t _start = 0;
+			};
+		}
+
+		bool serve_unix_socket(const DataSet& schema, MicroBatcher& batcher, const char* path)
+		{
+			sockaddr_un address = {};
+			address.sun_family = AF_UNIX;
+			if (std::char_traits<char>::length(path) >= sizeof(address.sun_path))
+			{
+				return false;
+			}
+			std::copy(path, path + std::char_traits<char>::length(path), address.sun_path);
+
+			const int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (listenFd == -1)
+			{
+				return false;
+			}
+
+			::unlink(path);
+			if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || ::listen(listenFd, 64) == -1)
+			{
+				::close(listenFd);
+				return false;
+			}
+
+			std::atomic<bool> shuttingDown{ false };
+			bool failed = false;
+
+			// Each client's thread is joined (and forgotten) once it's finished, so connections don't pile up over a long running server
+			std::mutex clientsMutex;
+			std::vector<int> clientFds;
+			std::map<std::size_t, std::thread> clients;
+			std::vector<std::size_t> finishedClients;
+			std::size_t nextClientId = 0;
+
+			const auto reapClients = [&]()
+			{
+				std::vector<std::thread> finished;
+				{
+					std::lock_guard<std::mutex> lock{ clientsMutex };
+					for (auto id : finishedClients)
+					{
+						finished.push_back(std::move(clients[id]));
+						clients.erase(id);
+					}
+					finishedClients.clear();
+				}
+
+				for (auto& client : finished)
+				{
+					client.join();
+				}
+			};
+
+			auto acceptDelay = MIN_ACCEPT_DELAY;
+			while (true)
+			{
+				reapClients();
+
+				const int clientFd = ::accept(listenFd, nullptr, nullptr);
+				if (clientFd == -1)
+				{
+					// The listening socket is shut down when a client asks for it
+					if (shuttingDown)
+					{
+						break;
+					}
+
+					if (errno == EINTR || errno == ECONNABORTED)
+					{
+						continue;
+					}
+
+					// Out of descriptors or memory, wait for some clients to finish (rather than spinning) and try again
+					if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+					{
+						std::this_thread::sleep_for(acceptDelay);
+						acceptDelay = std::min(acceptDelay * 2, MAX_ACCEPT_DELAY);
+						continue;
+					}
+
+					// Anything else won't go away by trying again, so stop serving every client
+					failed = true;
+					std::lock_guard<std::mutex> lock{ clientsMutex };
+					for (auto fd : clientFds)
+					{
+						::shutdown(fd, SHUT_RD);
+					}
+					break;
+				}
+
+				acceptDelay = MIN_ACCEPT_DELAY;
+				disable_sigpipe(clientFd);
+
+				std::lock_guard<std::mutex> lock{ clientsMutex };
+				clientFds.push_back(clientFd);
+				const auto clientId = nextClientId++;
+
+				clients.emplace(clientId, std::thread{ [&, clientFd, clientId]()
+				{
+					SocketLineReader reader{ clientFd };
+					std::string outBuffer;
+					std::atomic<bool> disconnected{ false };
+
+					const bool shutdown = serve_lines(
+						schema,
+						batcher,
+						[&reader, &disconnected](std::string& line) { return !disconnected.load() && reader.read_line(line); },
+						[&outBuffer, &disconnected, clientFd](const std::string& line, bool flush)
+						{
+							if (!line.empty())
+							{
+								outBuffer += line;
+								outBuffer += '\n';
+							}
+
+							if (flush && !outBuffer.empty())
+							{
+								if (!disconnected.load() && !send_all(clientFd, outBuffer))
+								{
+									disconnected.store(true);
+								}
+
+								outBuffer.clear();
+							}
+						});
+
+					if (shutdown && !shuttingDown.exchange(true))
+					{
+						// Unblock 'accept' and every other client
+						::shutdown(listenFd, SHUT_RDWR);
+
+						std::lock_guard<std::mutex> lock{ clientsMutex };
+						for (auto fd : clientFds)
+						{
+							if (fd != clientFd)
+							{
+								::shutdown(fd, SHUT_RD);
+							}
+						}
+					}
+
+					std::lock_guard<std::mutex> lock{ clientsMutex };
+					clientFds.erase(std::find(clientFds.begin(), clientFds.end(), clientFd));
+					::close(clientFd);
+					finishedClients.push_back(clientId);
+				} });
+			}
+
+			// Wait for the clients still connected, whose sockets have been shut down so they'll finish on their own
+			for (auto& client : clients)
+			{
+				client.second.join();
+			}
+
+			::close(listenFd);
+			::unlink(path);
+			return !failed;
+		}
+
+#else
+
+		bool serve_unix_socket(const DataSet& /*schema*/, MicroBatcher& /*batcher*/, const char* /*path*/)
+		{
+			return false;
+		}
+
+#endif
+	}
+}
@@ -0,0 +1,138 @@
+// ThreadPool.cpp - Will Cassella
+
+#include <algorithm>
+#include "../include/ThreadPool.h"
+
+namespace ml
+{
+	ThreadPool::ThreadPool(std::size_t numThreads)
+	{
+		if (numThreads == 0)
+		{
+			numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		_threads.reserve(numThreads);
+		for (std::size_t i = 0; i < numThreads; ++i)
+		{
+			_threads.emplace_back(&ThreadPool::run, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_stopping = true;
+		}
+
+		_job_available.notify_all();
+		for (auto& thread : _threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_jobs.push_back(std::move(job));
+		}
+
+		_job_available.notify_one();
+	}
+
+	void ThreadPool::wait()
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+		_jobs_done.wait(lock, [this]() { return _jobs.empty() && _num_running == 0; });
+	}
+
+	void ThreadPool::run_batch(std::size_t count, const std::function<void(std::size_t i)>& job)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		// Shared with the helpers, which may only get to run after the batch has been finished without them
+		struct Batch
+		{
+			std::atomic<std::size_t> next{ 0 };
+			std::size_t count;
+			const std::function<void(std::size_t)>* job;
+
+			std::mutex mutex;
+			std::condition_variable done;
+			std::size_t num_finished = 0;
+
+			/* Runs calls until there are none left, returns once they've all been started. */
+			void help()
+			{
+				std::size_t numRun = 0;
+				for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+				{
+					(*job)(i);
+					numRun += 1;
+				}
+
+				if (numRun != 0)
+				{
+					std::lock_guard<std::mutex> lock{ mutex };
+					num_finished += numRun;
+					if (num_finished == count)
+					{
+						done.notify_all();
+					}
+				}
+			}
+		};
+
+		auto batch = std::make_shared<Batch>();
+		batch->count = count;
+		batch->job = &job;
+
+		// The calling thread takes part too, so there's one less helper to wake
+		const auto numHelpers = std::min(count, _threads.size() + 1) - 1;
+		for (std::size_t i = 0; i < numHelpers; ++i)
+		{
+			submit([batch]() { batch->help(); });
+		}
+
+		batch->help();
+
+		std::unique_lock<std::mutex> lock{ batch->mutex };
+		batch->done.wait(lock, [&]() { return batch->num_finished == count; });
+	}
+
+	void ThreadPool::run()
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+
+		while (true)
+		{
+			_job_available.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+
+			// Finish off the queue before stopping
+			if (_jobs.empty())
+			{
+				return;
+			}
+
+			auto job = std::move(_jobs.front());
+			_jobs.pop_front();
+			_num_running += 1;
+
+			lock.unlock();
+			job();
+			lock.lock();
+
+			_num_running -= 1;
+			if (_jobs.empty() && _num_running == 0)
+			{
+				_jobs_done.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,237 @@
+// WorkerProcesses.cpp - Will Cassella
+
+#include <new>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include "../include/WorkerProcesses.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ML_WORKER_PROCESSES 1
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#else
+#define ML_WORKER_PROCESSES 0
+#endif
+
+namespace ml
+{
+#if ML_WORKER_PROCESSES
+	namespace
+	{
+		/* The size of the reads the coordinator makes from the pipes. */
+		constexpr std::size_t READ_BUFFER_SIZE = 1 << 16;
+
+		/* Each result a worker sends starts with this, followed by 'size' bytes. */
+		struct MessageHeader
+		{
+			std::uint64_t job;
+			std::uint64_t size;
+		};
+
+		struct Worker
+		{
+			pid_t pid;
+			int fd;
+			std::string received;
+		};
+
+		/* Writes all of the given bytes to the file descriptor, returns false if it couldn't. */
+		bool write_all(int fd, const char* data, std::size_t size)
+		{
+			while (size > 0)
+			{
+				const auto written = write(fd, data, size);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					return false;
+				}
+
+				data += written;
+				size -= static_cast<std::size_t>(written);
+			}
+
+			return true;
+		}
+
+		/* Runs jobs from the shared queue until it's empty, sending each result down the pipe. */
+		void worker_main(
+			std::atomic<std::uint64_t>& nextJob,
+			const std::size_t numJobs,
+			const int fd,
+			const std::function<std::string(std::size_t job)>& runJob)
+		{
+			while (true)
+			{
+				const auto job = nextJob.fetch_add(1);
+				if (job >= numJobs)
+				{
+					return;
+				}
+
+				const auto result = runJob(static_cast<std::size_t>(job));
+				const MessageHeader header{ job, result.size() };
+
+				if (!write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header)) || !write_all(fd, result.data(), result.size()))
+				{
+					return;
+				}
+			}
+		}
+	}
+#endif
+
+	bool worker_processes_supported()
+	{
+		return ML_WORKER_PROCESSES != 0;
+	}
+
+	std::vector<bool> run_worker_processes(
+		std::size_t numWorkers,
+		std::size_t numJobs,
+		const std::function<std::string(std::size_t job)>& runJob,
+		const std::function<void(std::size_t job, const std::string& result)>& onResult)
+	{
+		std::vector<bool> finished(numJobs, false);
+
+#if ML_WORKER_PROCESSES
+		// The queue is just the index of the next job to take, in a page shared by every process
+		void* shared = mmap(nullptr, sizeof(std::atomic<std::uint64_t>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (shared == MAP_FAILED)
+		{
+			return finished;
+		}
+
+		auto* nextJob = new (shared) std::atomic<std::uint64_t>{ 0 };
+		if (!nextJob->is_lock_free())
+		{
+			munmap(shared, sizeof(std::atomic<std::uint64_t>));
+			return finished;
+		}
+
+		// Fork the workers, each with its own pipe back to the coordinator
+		std::vector<Worker> workers;
+		for (std::size_t i = 0; i < numWorkers; ++i)
+		{
+			int fds[2];
+			if (pipe(fds) != 0)
+			{
+				break;
+			}
+
+			const auto pid = fork();
+			if (pid == 0)
+			{
+				close(fds[0]);
+				for (const auto& worker : workers)
+				{
+					close(worker.fd);
+				}
+
+				worker_main(*nextJob, numJobs, fds[1], runJob);
+				_exit(0);
+			}
+
+			close(fds[1]);
+			if (pid < 0)
+			{
+				close(fds[0]);
+				break;
+			}
+
+			workers.push_back(Worker{ pid, fds[0], std::string{} });
+		}
+
+		// Gather everything the workers send, until they've all closed their pipes
+		std::vector<pollfd> pollFds;
+		for (const auto& worker : workers)
+		{
+			pollFds.push_back(pollfd{ worker.fd, POLLIN, 0 });
+		}
+
+		std::vector<char> buffer(READ_BUFFER_SIZE);
+		std::size_t numOpen = workers.size();
+
+		while (numOpen > 0)
+		{
+			if (poll(pollFds.data(), pollFds.size(), -1) < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+
+				break;
+			}
+
+			for (std::size_t i = 0; i < pollFds.size(); ++i)
+			{
+				if (pollFds[i].fd < 0 || pollFds[i].revents == 0)
+				{
+					continue;
+				}
+
+				const auto numRead = read(pollFds[i].fd, buffer.data(), buffer.size());
+				if (numRead > 0)
+				{
+					workers[i].received.append(buffer.data(), static_cast<std::size_t>(numRead));
+				}
+				else if (numRead == 0 || errno != EINTR)
+				{
+					// A negative descriptor is ignored by 'poll'
+					close(pollFds[i].fd);
+					pollFds[i].fd = -1;
+					numOpen -= 1;
+				}
+			}
+		}
+
+		for (const auto& pollFd : pollFds)
+		{
+			if (pollFd.fd >= 0)
+			{
+				close(pollFd.fd);
+			}
+		}
+
+		// Hand over every complete result, a worker that died part way through a message doesn't get it counted
+		for (const auto& worker : workers)
+		{
+			int status;
+			while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+			{
+			}
+
+			std::size_t offset = 0;
+			MessageHeader header;
+			while (worker.received.size() - offset >= sizeof(header))
+			{
+				worker.received.copy(reinterpret_cast<char*>(&header), sizeof(header), offset);
+				if (worker.received.size() - offset - sizeof(header) < header.size || header.job >= numJobs)
+				{
+					break;
+				}
+
+				onResult(static_cast<std::size_t>(header.job), worker.received.substr(offset + sizeof(header), static_cast<std::size_t>(header.size)));
+				finished[static_cast<std::size_t>(header.job)] = true;
+				offset += sizeof(header) + static_cast<std::size_t>(header.size);
+			}
+		}
+
+		munmap(shared, sizeof(std::atomic<std::uint64_t>));
+#else
+		static_cast<void>(numWorkers);
+		static_cast<void>(runJob);
+		static_cast<void>(onResult);
+#endif
+
+		return finished;
+	}
+}
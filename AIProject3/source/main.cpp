@@ -2,81 +2,664 @@
 
 #include <algorithm>
 #include <iostream>
-#include <numeric>
+#include <sstream>
+#include <string>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
 #include "../include/DataSets.h"
 #include "../include/KNearestNeighbor.h"
+#include "../include/OnlineKNearestNeighbor.h"
 #include "../include/ID3.h"
+#include "../include/HoeffdingTree.h"
+#include "../include/Results.h"
+#include "../include/Profiler.h"
+#include "../include/Model.h"
+#include "../include/Inference.h"
+#include "../include/PredictionCache.h"
+#include "../include/Server.h"
+#include "../include/Experiment.h"
+#include "../include/Regression.h"
+#include "../include/WorkerProcesses.h"
 
-/* An algorithm is just a function with the following signature: */
-using IAlgorithm = std::size_t(const ml::DataSet& database, const std::vector<ml::Instance>& trainingSet, const std::vector<ml::Instance>& testSet);
+/* Splits a comma-separated list, "all" is replaced with the given list of every option. */
+std::vector<std::string> parse_list(const std::string& list, const std::vector<std::string>& all)
+{
+	if (list == "all")
+	{
+		return all;
+	}
+
+	std::vector<std::string> result;
+	std::stringstream listStream{ list };
+	std::string item;
+
+	while (std::getline(listStream, item, ','))
+	{
+		result.push_back(item);
+	}
+
+	return result;
+}
+
+/* Returns every instance of the given dataset, in order. */
+std::vector<ml::Instance> all_instances(const ml::DataSet& dataset)
+{
+	std::vector<ml::Instance> result;
+	result.reserve(dataset.num_instances());
+
+	for (std::size_t i = 0; i < dataset.num_instances(); ++i)
+	{
+		result.push_back(dataset.get_instance(i));
+	}
+
+	return result;
+}
 
 /**
- * \brief Runs the given algorithm on the given dataset, by generating 10 cross folds.
+ * \brief Runs the online nearest neighbor model over the dataset as a stream in random order, testing on each instance before learning from it.
  * \param dataset The dataset being tested on.
- * \param algorithm The algorithm to run.
+ * \param windowSize The size of the model's sliding window, or zero for unbounded.
+ * \param sink The sink to report the results to, as a single fold.
+ * \param datasetName The name of the dataset, for reporting.
  */
-void run_algorithm(const ml::DataSet& dataset, IAlgorithm* algorithm)
+void run_online(
+	const ml::DataSet& dataset,
+	std::size_t windowSize,
+	ml::ResultSink& sink,
+	const char* datasetName)
 {
-	constexpr std::size_t NUM_FOLDS = 10;
-	const std::size_t foldSize = dataset.num_instances() / NUM_FOLDS;
-	std::vector<std::size_t> results;
-	results.assign(NUM_FOLDS, 0);
+	auto stream = all_instances(dataset);
+	std::random_shuffle(stream.begin(), stream.end());
+
+	sink.begin(dataset, datasetName, "Online Nearest Neighbor", 1);
+	ml::k_nearest_neighbor::online_algorithm(dataset, stream, windowSize, sink.fold(0));
+	sink.end();
+}
 
-	// Create a vector to index into the dataset
-	std::vector<std::size_t> indexVec;
-	indexVec.assign(NUM_FOLDS * foldSize, 0);
-	std::iota(indexVec.begin(), indexVec.end(), 0);
-	std::random_shuffle(indexVec.begin(), indexVec.end());
+/**
+ * \brief Runs leave-one-out cross validation of the nearest neighbor algorithm over the dataset.
+ * \param dataset The dataset being tested on.
+ * \param k The number of neighbors that vote on the class of each instance.
+ * \param sink The sink to report the results to, as a single fold.
+ * \param datasetName The name of the dataset, for reporting.
+ */
+void run_leave_one_out(
+	const ml::DataSet& dataset,
+	unsigned int k,
+	ml::ResultSink& sink,
+	const char* datasetName)
+{
+	sink.begin(dataset, datasetName, "Nearest Neighbor (leave-one-out)", 1);
+	ml::k_nearest_neighbor::leave_one_out(dataset, k, sink.fold(0));
+	sink.end();
+}
 
-	// Run the benchmark
-	for (std::size_t i = 0; i < NUM_FOLDS; ++i)
+/**
+ * \brief Trains a model on the whole dataset, and serves it over stdin/stdout or a Unix domain socket until told to stop.
+ * \param dataset The dataset to train on.
+ * \param trainOptions The model to serve.
+ * \param options The batching settings.
+ * \param socketPath The path of the socket to serve on, or null to serve over stdin/stdout.
+ * \return The process exit code.
+ */
+int run_server(
+	const ml::DataSet& dataset,
+	const ml::TrainOptions& trainOptions,
+	ml::server::ServerOptions options,
+	const char* socketPath)
+{
+	std::vector<std::size_t> indices;
+	auto model = ml::train_model(dataset, ml::view_all(dataset, indices), trainOptions);
+
+	// Put a prediction cache in front of the model if requested
+	std::shared_ptr<ml::CachedModel> cached;
+	if (options.cache_capacity != 0)
 	{
-		std::vector<ml::Instance> trainingSet;
-		trainingSet.reserve(foldSize * (NUM_FOLDS - 1));
+		cached = std::make_shared<ml::CachedModel>(model, dataset, options.cache_capacity);
+		model = cached;
+	}
 
-		std::vector<ml::Instance> testSet;
-		testSet.reserve(foldSize);
+	ml::server::MicroBatcher batcher{ *model, options };
 
-		for (std::size_t index = 0; index < indexVec.size(); ++index)
+	if (socketPath)
+	{
+		if (!ml::server::serve_unix_socket(dataset, batcher, socketPath))
 		{
-			if (index / foldSize == i)
+			std::cerr << "Could not serve on socket '" << socketPath << "'" << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		ml::server::serve_stream(dataset, batcher, std::cin, std::cout);
+	}
+
+	std::cerr << batcher.latency() << std::endl;
+	if (cached)
+	{
+		std::cerr << cached->stats() << std::endl;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Trains an ID3 tree on the whole dataset, and writes it out as a standalone C++ header.
+ * \param dataset The dataset to train on.
+ * \param path The path of the header to write, the namespace of the generated code is named after the file.
+ * \return The process exit code.
+ */
+int export_id3(const ml::DataSet& dataset, const std::string& path)
+{
+	std::vector<std::size_t> indices;
+	const auto model = ml::id3_rep::train(dataset, ml::view_all(dataset, indices));
+
+	// Name the namespace after the file name, without its directory or extension
+	auto name = path.substr(path.find_last_of("/\\") + 1);
+	name = name.substr(0, name.find('.'));
+	std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+
+	std::ofstream out{ path };
+	if (!ml::id3_rep::export_cpp(*model, dataset, name, out))
+	{
+		std::cerr << "Could not write '" << path << "'" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Checks that the C++ exported from the ID3 tree trained on each dataset classifies every instance the same as the tree itself.
+ * Each tree is exported to the given directory along with a small program that classifies instances read from its input, which is
+ * compiled with the compiler named by the 'CXX' environment variable (or the platform's default compiler) and run over the whole dataset.
+ * \param datasets The datasets to check.
+ * \param directory The directory to write the generated code, programs and their input and output to.
+ * \return The process exit code, nonzero if any instance was classified differently or a program couldn't be built.
+ */
+int check_export_id3(const std::vector<ml::NamedDataSet>& datasets, const std::string& directory)
+{
+#ifdef _WIN32
+	const char* const defaultCompiler = "cl /nologo /EHsc /O1";
+	const char* const outputFlag = " /Fe";
+	const char* const executableExtension = ".exe";
+#else
+	const char* const defaultCompiler = "c++ -std=c++11 -O1";
+	const char* const outputFlag = " -o ";
+	const char* const executableExtension = "";
+#endif
+	const char* compiler = std::getenv("CXX");
+	compiler = compiler && *compiler ? compiler : defaultCompiler;
+
+	bool agreed = true;
+	for (const auto& named : datasets)
+	{
+		const auto& dataset = named.second;
+		std::vector<std::size_t> indices;
+		const auto trainingSet = ml::view_all(dataset, indices);
+		const auto model = ml::id3_rep::train(dataset, trainingSet);
+
+		auto name = "exported_" + named.first;
+		std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+		const auto base = directory + "/" + name;
+
+		// The generated tree, and a program that classifies each line of attribute values it reads with it
+		std::ofstream header{ base + ".h" };
+		std::ofstream program{ base + "_check.cpp" };
+		std::ofstream input{ base + "_input.txt" };
+		if (!ml::id3_rep::export_cpp(*model, dataset, name, header))
+		{
+			std::cerr << "Could not write '" << base << ".h'" << std::endl;
+			return 1;
+		}
+
+		program << "#include <cstdio>\n#include \"" << name << ".h\"\n\n";
+		program << "int main()\n{\n\tstd::size_t values[" << name << "::NUM_ATTRIBUTES];\n\twhile (true)\n\t{\n";
+		program << "\t\tfor (auto& value : values)\n\t\t{\n\t\t\tif (std::scanf(\"%zu\", &value) != 1)\n\t\t\t{\n\t\t\t\treturn 0;\n\t\t\t}\n\t\t}\n\n";
+		program << "\t\tstd::printf(\"%zu\\n\", " << name << "::classify(values));\n\t}\n}\n";
+
+		for (auto instance : trainingSet)
+		{
+			for (ml::Attribute::Index attribIndex = 0; attribIndex < dataset.num_attributes(); ++attribIndex)
+			{
+				input << instance.get_attrib(attribIndex) << ' ';
+			}
+			input << '\n';
+		}
+
+		header.close();
+		program.close();
+		input.close();
+
+		const auto executable = base + "_check" + executableExtension;
+		const auto build = std::string{ compiler } + " \"" + base + "_check.cpp\"" + outputFlag + "\"" + executable + "\"";
+		const auto run = "\"" + executable + "\" < \"" + base + "_input.txt\" > \"" + base + "_output.txt\"";
+		if (std::system(build.c_str()) != 0 || std::system(run.c_str()) != 0)
+		{
+			std::cerr << "Could not build and run the exported tree for '" << named.first << "'" << std::endl;
+			return 1;
+		}
+
+		// Compare what the exported tree said about each instance with the tree itself
+		std::ifstream output{ base + "_output.txt" };
+		std::size_t numAgreed = 0;
+		for (auto instance : trainingSet)
+		{
+			ml::ClassIndex exported;
+			if (output >> exported && exported == model->classify(instance))
+			{
+				numAgreed += 1;
+			}
+		}
+
+		std::cout << named.first << ": " << numAgreed << '/' << trainingSet.size() << " instances agree" << std::endl;
+		agreed = agreed && numAgreed == trainingSet.size();
+	}
+
+	return agreed ? 0 : 1;
+}
+
+/* Writes the command line options to stderr. */
+void print_usage(const char* program)
+{
+	std::cerr << "Usage: " << program << " [--verbosity none|summary|folds|instances] [--format text|csv|json] [--profile <path>] [--perf-events] [--online <window size, 0 for unbounded>] [--loo] [--serve knn|cnn|sfs|sbs|sharded|id3|forest [--socket <path>] [--max-batch <n>] [--max-delay-us <n>] [--cache <entries>]] [--export-id3 <header path>] [--check-export <dir>] [--regress <history path> [--results <dir>] [--regress-threshold <percent>] [--regress-repeat <n>]] [--datasets <names>|all] [--algorithms knn,hvdm,cnn,sfs,sbs,id3,hoeffding,forest|all] [--k <n>] [--folds <n>] [--stratified] [--threads <n, 0 for all>] [--processes <n>] [--pipeline [--pipeline-depth <n>]] [--sweep-k <k,...> [--sweep-q <q,...>]] [--condense] [--select forward|backward] [--cache-replay <entries>] [--shard-scaling <rows>] [--discretize width|quantile|entropy] [--no-bitmap-index] [--no-wait]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	// Output is written in large buffered chunks, so don't bother synchronizing with C stdio
+	std::ios::sync_with_stdio(false);
+
+	auto verbosity = ml::Verbosity::Folds;
+	auto format = ml::ReportFormat::Text;
+	bool wait = true;
+	std::ofstream profileFile;
+	std::ostream* profileOut = nullptr;
+	bool online = false;
+	bool leaveOneOut = false;
+	std::size_t onlineWindow = 0;
+	bool serve = false;
+	ml::TrainOptions serveOptions;
+	const char* socketPath = nullptr;
+	ml::server::ServerOptions serverOptions;
+	std::string exportPath;
+	std::string exportCheckDirectory;
+	bool bitmapIndex = true;
+	auto discretization = ml::Discretization::EqualWidth;
+	std::vector<std::string> datasetNames{ "breast-cancer" };
+	bool datasetsGiven = false;
+	bool algorithmsGiven = false;
+	ml::ExperimentOptions experiment;
+	bool pipeline = false;
+	bool regress = false;
+	ml::RegressionOptions regression;
+	ml::k_nearest_neighbor::SweepGrid sweepGrid;
+	bool condense = false;
+	bool select = false;
+	std::size_t replayCacheCapacity = 0;
+	std::size_t shardRows = 0;
+	auto selectDirection = ml::k_nearest_neighbor::SelectionOptions::Direction::Forward;
+
+	try
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+
+			if (arg == "--verbosity" && i + 1 < argc && ml::parse_verbosity(argv[i + 1], verbosity))
+			{
+				++i;
+			}
+			else if (arg == "--format" && i + 1 < argc && ml::parse_report_format(argv[i + 1], format))
+			{
+				++i;
+			}
+			else if (arg == "--profile" && i + 1 < argc)
+			{
+				profileFile.open(argv[++i], std::ios::out | std::ios::app);
+				profileOut = &profileFile;
+			}
+			else if (arg == "--perf-events")
+			{
+	#if ML_ENABLE_PROFILING
+				if (!ml::profiler::enable_hardware_counters())
+				{
+					std::cerr << "Hardware performance counters are not available" << std::endl;
+				}
+	#endif
+			}
+			else if (arg == "--online" && i + 1 < argc)
+			{
+				online = true;
+				onlineWindow = std::stoul(argv[++i]);
+			}
+			else if (arg == "--loo")
+			{
+				leaveOneOut = true;
+			}
+			else if (arg == "--serve" && i + 1 < argc && ml::parse_model_kind(argv[i + 1], serveOptions.kind))
+			{
+				serve = true;
+				++i;
+			}
+			else if (arg == "--socket" && i + 1 < argc)
+			{
+				socketPath = argv[++i];
+			}
+			else if (arg == "--cache" && i + 1 < argc)
+			{
+				serverOptions.cache_capacity = std::stoul(argv[++i]);
+			}
+			else if (arg == "--max-batch" && i + 1 < argc)
+			{
+				serverOptions.max_batch_size = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+			}
+			else if (arg == "--max-delay-us" && i + 1 < argc)
+			{
+				serverOptions.max_batch_delay = std::chrono::microseconds{ std::stoul(argv[++i]) };
+			}
+			else if (arg == "--export-id3" && i + 1 < argc)
+			{
+				exportPath = argv[++i];
+			}
+			else if (arg == "--check-export" && i + 1 < argc)
+			{
+				exportCheckDirectory = argv[++i];
+			}
+			else if (arg == "--regress" && i + 1 < argc)
+			{
+				regress = true;
+				regression.history_path = argv[++i];
+			}
+			else if (arg == "--results" && i + 1 < argc)
+			{
+				regression.results_dir = argv[++i];
+			}
+			else if (arg == "--regress-threshold" && i + 1 < argc)
 			{
-				testSet.push_back(dataset.get_instance(indexVec[index]));
+				regression.threshold = std::stod(argv[++i]) / 100;
+			}
+			else if (arg == "--regress-repeat" && i + 1 < argc)
+			{
+				regression.repetitions = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+			}
+			else if (arg == "--datasets" && i + 1 < argc)
+			{
+				datasetNames = parse_list(argv[++i], ml::data_set_names());
+				datasetsGiven = true;
+			}
+			else if (arg == "--algorithms" && i + 1 < argc)
+			{
+				experiment.algorithms = parse_list(argv[++i], ml::algorithm_names());
+				algorithmsGiven = true;
+			}
+			else if (arg == "--k" && i + 1 < argc)
+			{
+				experiment.k = std::max(std::stoul(argv[++i]), 1ul);
+			}
+			else if (arg == "--folds" && i + 1 < argc)
+			{
+				experiment.num_folds = std::max<std::size_t>(std::stoul(argv[++i]), 2);
+			}
+			else if (arg == "--processes" && i + 1 < argc)
+			{
+				experiment.num_processes = std::stoul(argv[++i]);
+			}
+			else if (arg == "--pipeline")
+			{
+				pipeline = true;
+			}
+			else if (arg == "--pipeline-depth" && i + 1 < argc)
+			{
+				pipeline = true;
+				experiment.pipeline_depth = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+			}
+			else if (arg == "--stratified")
+			{
+				experiment.stratified = true;
+			}
+			else if (arg == "--threads" && i + 1 < argc)
+			{
+				experiment.num_threads = std::stoul(argv[++i]);
+			}
+			else if (arg == "--sweep-k" && i + 1 < argc)
+			{
+				for (const auto& k : parse_list(argv[++i], {}))
+				{
+					sweepGrid.ks.push_back(std::max(std::stoul(k), 1ul));
+				}
+			}
+			else if (arg == "--sweep-q" && i + 1 < argc)
+			{
+				for (const auto& q : parse_list(argv[++i], {}))
+				{
+					sweepGrid.qs.push_back(std::max(std::stoi(q), 1));
+				}
+			}
+			else if (arg == "--select" && i + 1 < argc && ml::k_nearest_neighbor::parse_selection_direction(argv[i + 1], selectDirection))
+			{
+				select = true;
+				++i;
+			}
+			else if (arg == "--cache-replay" && i + 1 < argc)
+			{
+				replayCacheCapacity = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+			}
+			else if (arg == "--shard-scaling" && i + 1 < argc)
+			{
+				shardRows = std::max<std::size_t>(std::stoul(argv[++i]), 1);
+			}
+			else if (arg == "--condense")
+			{
+				condense = true;
+			}
+			else if (arg == "--discretize" && i + 1 < argc && ml::parse_discretization(argv[i + 1], discretization))
+			{
+				++i;
+			}
+			else if (arg == "--no-bitmap-index")
+			{
+				bitmapIndex = false;
+			}
+			else if (arg == "--no-wait")
+			{
+				wait = false;
 			}
 			else
 			{
-				trainingSet.push_back(dataset.get_instance(indexVec[index]));
+				print_usage(argv[0]);
+				return 1;
 			}
 		}
+	}
+	catch (const std::invalid_argument&)
+	{
+		// Thrown by 'std::stoul' and the like for an argument that isn't a number
+		std::cerr << "Expected a number" << std::endl;
+		print_usage(argv[0]);
+		return 1;
+	}
+	catch (const std::out_of_range&)
+	{
+		std::cerr << "Number out of range" << std::endl;
+		print_usage(argv[0]);
+		return 1;
+	}
 
-		// Run the algorithm
-		std::cout << "Run " << i << ":" << std::endl;
-		results[i] = algorithm(dataset, trainingSet, testSet);
+	if (experiment.num_processes != 0 && !ml::worker_processes_supported())
+	{
+		std::cerr << "Worker processes aren't supported on this platform, running on threads instead" << std::endl;
 	}
 
-	// Determine the average accuracy
-	float averageAccuracy = 0;
-	for (std::size_t i = 0; i < results.size(); ++i)
+#if !ML_ENABLE_PROFILING
+	if (profileOut)
 	{
-		const auto accuracy = static_cast<float>(results[i] * 100) / foldSize;
-		averageAccuracy += accuracy;
+		std::cerr << "Profiling was not compiled in, rebuild with ML_ENABLE_PROFILING=1" << std::endl;
 	}
+#endif
 
-	std::cout << "Average accuracy: " << averageAccuracy / results.size() << "%" << std::endl;
-}
+	// A regression check runs everything, unless told otherwise
+	if (regress)
+	{
+		if (!datasetsGiven)
+		{
+			datasetNames = ml::data_set_names();
+		}
+		if (!algorithmsGiven)
+		{
+			experiment.algorithms = ml::algorithm_names();
+		}
+	}
 
-int main()
-{
-	// load the dataset
-	auto dataset = ml::load_breast_cancer_data();
+	// Entropy bins are learned from the classes of every instance before the folds are split, so evaluating with them would leak the test classes
+	if (discretization == ml::Discretization::Entropy && exportPath.empty() && exportCheckDirectory.empty() && !serve)
+	{
+		std::cerr << "Entropy discretization learns its bins from the classes of the whole dataset, so it may only be used to train a model on all of it (--serve, --export-id3 or --check-export)" << std::endl;
+		return 1;
+	}
 
-	// Run the nearest neighbor algorithm
-	std::cout << "Nearest Neighbor:" << std::endl;
-	run_algorithm(dataset, &ml::k_nearest_neighbor::algorithm);
+	for (const auto& name : datasetNames)
+	{
+		if (!ml::find_data_set_loader(name))
+		{
+			std::cerr << "Unknown dataset '" << name << "'" << std::endl;
+			return 1;
+		}
+	}
 
-	// Run the ID3 algorithm
-	std::cout << std::endl << "ID3:" << std::endl;
-	run_algorithm(dataset, &ml::id3_rep::algorithm);
+	if (datasetNames.empty())
+	{
+		std::cerr << "No datasets selected" << std::endl;
+		return 1;
+	}
+
+	const auto load = [discretization, bitmapIndex](const std::string& name)
+	{
+		auto dataset = ml::find_data_set_loader(name)(discretization);
+		if (bitmapIndex)
+		{
+			dataset.build_bitmap_index();
+		}
+
+		return dataset;
+	};
+
+	// Only the experiment itself can be pipelined, the other modes need every dataset loaded first
+	pipeline = pipeline && exportPath.empty() && exportCheckDirectory.empty() && !serve && sweepGrid.ks.empty() && sweepGrid.qs.empty() && !condense && !select && replayCacheCapacity == 0 && shardRows == 0 && !regress;
+
+	// Load the datasets, unless they're loaded while the experiment runs
+	std::vector<ml::NamedDataSet> datasets;
+	for (std::size_t i = 0; !pipeline && i < datasetNames.size(); ++i)
+	{
+		datasets.emplace_back(datasetNames[i], load(datasetNames[i]));
+	}
+
+	// Export a tree trained on the first dataset instead of running the benchmarks, if requested
+	if (!exportPath.empty())
+	{
+		return export_id3(datasets.front().second, exportPath);
+	}
+
+	// Check the exported tree of every dataset against the tree itself instead of running the benchmarks, if requested
+	if (!exportCheckDirectory.empty())
+	{
+		return check_export_id3(datasets, exportCheckDirectory);
+	}
+
+	// Serve a model trained on the first dataset instead of running the benchmarks, if requested
+	if (serve)
+	{
+		serveOptions.k = experiment.k;
+		serveOptions.num_threads = experiment.num_threads;
+		return run_server(datasets.front().second, serveOptions, serverOptions, socketPath);
+	}
+
+	// Sweep the nearest neighbor hyperparameters instead of running the benchmarks, if requested
+	if (!sweepGrid.ks.empty() || !sweepGrid.qs.empty())
+	{
+		if (sweepGrid.ks.empty())
+		{
+			sweepGrid.ks.push_back(experiment.k);
+		}
+		if (sweepGrid.qs.empty())
+		{
+			sweepGrid.qs.push_back(1);
+		}
+
+		ml::run_sweep(datasets, experiment, sweepGrid, std::cout, format);
+		return 0;
+	}
+
+	// Compare nearest neighbor over the condensed training sets with the full ones instead of running the benchmarks, if requested
+	if (condense)
+	{
+		ml::run_condensation(datasets, experiment, std::cout, format);
+		return 0;
+	}
+
+	// Compare nearest neighbor over the chosen attributes with all of them instead of running the benchmarks, if requested
+	if (select)
+	{
+		ml::run_selection(datasets, experiment, selectDirection, std::cout, format);
+		return 0;
+	}
 
-	std::cin.get();
+	// Replay each dataset through cached and uncached models instead of running the benchmarks, if requested
+	if (replayCacheCapacity != 0)
+	{
+		ml::run_cache_replay(datasets, replayCacheCapacity, std::cout, format);
+		return 0;
+	}
+
+	// Time nearest neighbor split between more and more threads instead of running the benchmarks, if requested
+	if (shardRows != 0)
+	{
+		ml::run_shard_scaling(datasets, experiment, shardRows, std::cout, format);
+		return 0;
+	}
+
+	// Check for regressions instead of running the benchmarks, if requested
+	if (regress)
+	{
+		return ml::run_regression(datasets, experiment, regression, std::cout) ? 0 : 1;
+	}
+
+	// Run every algorithm on every dataset, keeping the datasets around if they're needed afterwards
+	const bool ran = pipeline
+		? ml::run_pipelined_experiment(datasetNames, load, experiment, std::cout, verbosity, format, profileOut, leaveOneOut || online ? &datasets : nullptr)
+		: ml::run_experiment(datasets, experiment, std::cout, verbosity, format, profileOut);
+
+	if (!ran)
+	{
+		std::cerr << "Unknown algorithm, expected some of knn, hvdm, cnn, sfs, sbs, id3, hoeffding or forest" << std::endl;
+		return 1;
+	}
+
+	// Run leave-one-out nearest neighbor, if requested
+	if (leaveOneOut)
+	{
+		ml::ResultSink sink{ std::cout, verbosity, format, false };
+		for (const auto& dataset : datasets)
+		{
+			run_leave_one_out(dataset.second, experiment.k, sink, dataset.first.c_str());
+		}
+	}
+
+	// Run the online nearest neighbor model, if requested
+	if (online)
+	{
+		ml::ResultSink sink{ std::cout, verbosity, format, false };
+		for (const auto& dataset : datasets)
+		{
+			run_online(dataset.second, onlineWindow, sink, dataset.first.c_str());
+		}
+	}
+
+	if (wait)
+	{
+		std::cin.get();
+	}
 }